@@ -0,0 +1,162 @@
+#ifndef H_ALLOC_TRACKER
+#define H_ALLOC_TRACKER
+
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstddef>
+
+// Allocations counted by category.
+// Expression nodes are counted with the size of their concrete class,
+// without the shared_ptr control block.
+enum AllocCategory
+{
+    AllocMatrix,
+    AllocDynarray,
+    AllocExpression,
+    AllocToken,
+    AllocString,
+    AllocCategoryCount
+};
+
+inline const char* AllocCategoryName(AllocCategory category)
+{
+    static const char* names[AllocCategoryCount] = {
+        "matrix", "dynarray", "expression", "token", "string"
+    };
+    return names[category];
+}
+
+struct AllocationCounters
+{
+    size_t count[AllocCategoryCount];
+    size_t bytes[AllocCategoryCount];
+
+    size_t TotalCount() const {
+        size_t total = 0;
+        for(size_t i = 0; i < AllocCategoryCount; ++i) total += count[i];
+        return total;
+    }
+
+    size_t TotalBytes() const {
+        size_t total = 0;
+        for(size_t i = 0; i < AllocCategoryCount; ++i) total += bytes[i];
+        return total;
+    }
+};
+
+// Process wide allocation counters fed by Matrix, dynarray, expression
+// nodes, the token list and the lexer.
+// A hook can be installed to observe each allocation (logging, budgets
+// in tests...), it may throw to refuse the allocation.
+class AllocationTracker
+{
+public:
+    typedef void (*Hook)(AllocCategory category, size_t bytes);
+
+    static void Record(AllocCategory category, size_t bytes) {
+        Hook hook = Instance().hook_.load(std::memory_order_relaxed);
+        if(hook) {
+            hook(category, bytes);
+        }
+        Instance().count_[category].fetch_add(1, std::memory_order_relaxed);
+        Instance().bytes_[category].fetch_add(bytes, std::memory_order_relaxed);
+        ThreadBytes() += bytes;
+    }
+
+    // Returns the previous hook, nullptr removes the hook
+    static Hook SetHook(Hook hook) {
+        return Instance().hook_.exchange(hook);
+    }
+
+    static AllocationCounters Counters() {
+        AllocationCounters counters;
+        for(size_t i = 0; i < AllocCategoryCount; ++i) {
+            counters.count[i] = Instance().count_[i].load(std::memory_order_relaxed);
+            counters.bytes[i] = Instance().bytes_[i].load(std::memory_order_relaxed);
+        }
+        return counters;
+    }
+
+    static void Reset() {
+        for(size_t i = 0; i < AllocCategoryCount; ++i) {
+            Instance().count_[i].store(0, std::memory_order_relaxed);
+            Instance().bytes_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Bytes allocated by the calling thread, never reset.
+    // Used to meter the memory of an evaluation.
+    static size_t& ThreadBytes() {
+        static thread_local size_t bytes = 0;
+        return bytes;
+    }
+
+    static void Print(std::ostream& os) {
+        AllocationCounters counters = Counters();
+        os << std::left << std::setw(12) << "category" << std::right
+           << std::setw(12) << "count" << std::setw(14) << "bytes" << "\n";
+        for(size_t i = 0; i < AllocCategoryCount; ++i) {
+            os << std::left << std::setw(12) << AllocCategoryName(AllocCategory(i)) << std::right
+               << std::setw(12) << counters.count[i] << std::setw(14) << counters.bytes[i] << "\n";
+        }
+        os << std::left << std::setw(12) << "total" << std::right
+           << std::setw(12) << counters.TotalCount() << std::setw(14) << counters.TotalBytes() << "\n";
+    }
+
+private:
+    AllocationTracker() : hook_(nullptr) {
+        for(size_t i = 0; i < AllocCategoryCount; ++i) {
+            count_[i].store(0, std::memory_order_relaxed);
+            bytes_[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    static AllocationTracker& Instance() {
+        static AllocationTracker tracker;
+        return tracker;
+    }
+
+    std::atomic<Hook> hook_;
+    std::atomic<size_t> count_[AllocCategoryCount];
+    std::atomic<size_t> bytes_[AllocCategoryCount];
+};
+
+// Standard allocator recording its allocations under a category
+template <typename T, AllocCategory Category>
+struct TrackingAllocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef TrackingAllocator<U, Category> other;
+    };
+
+    TrackingAllocator() {}
+    template <typename U>
+    TrackingAllocator(const TrackingAllocator<U, Category>&) {}
+
+    T* allocate(size_t n) {
+        AllocationTracker::Record(Category, n*sizeof(T));
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        std::allocator<T>().deallocate(p, n);
+    }
+};
+
+template <typename T, typename U, AllocCategory Category>
+bool operator==(const TrackingAllocator<T, Category>&, const TrackingAllocator<U, Category>&) {
+    return true;
+}
+
+template <typename T, typename U, AllocCategory Category>
+bool operator!=(const TrackingAllocator<T, Category>&, const TrackingAllocator<U, Category>&) {
+    return false;
+}
+
+#endif // H_ALLOC_TRACKER
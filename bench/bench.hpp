@@ -0,0 +1,185 @@
+#ifndef H_BENCH
+#define H_BENCH
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <cstdlib> // malloc, free
+#include <new> // bad_alloc
+
+/**
+ ***************************************
+ * Minimal microbenchmark harness.
+ *
+ * Each case runs once to warm up, then `samples` times `iterations`
+ * calls. The median sample is reported so that a single preempted
+ * sample doesn't skew the result. Iteration counts are fixed by the
+ * cases : two runs of the same binary do the same work.
+ *
+ * Allocations are counted by the global operator new replaced
+ * in the driver (see BENCH_COUNT_ALLOCATIONS).
+ ***************************************
+ */
+
+namespace bench {
+
+inline std::atomic<size_t>& allocations()
+{
+    static std::atomic<size_t> count(0);
+    return count;
+}
+
+struct Result
+{
+    std::string name;
+    size_t iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double items_per_op; // work items per call (tokens, nodes, elements...)
+};
+
+class Suite
+{
+public:
+    Suite(size_t samples = 5) : m_samples(samples) {}
+
+    // Only cases whose name contains the filter are run
+    void SetFilter(const std::string& filter)
+    {
+        m_filter = filter;
+    }
+
+    template <typename Func>
+    void Run(const std::string& name, size_t iterations, double items_per_op, Func f)
+    {
+        if (!m_filter.empty() && name.find(m_filter) == std::string::npos) return;
+
+        f(); // warm up
+
+        std::vector<double> ns(m_samples);
+        std::vector<size_t> allocs(m_samples);
+        for (size_t s = 0; s < m_samples; ++s)
+        {
+            size_t a = allocations().load();
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; ++i) f();
+            auto stop = std::chrono::steady_clock::now();
+            allocs[s] = allocations().load() - a;
+            ns[s] = std::chrono::duration<double, std::nano>(stop-start).count()/iterations;
+        }
+        std::sort(ns.begin(), ns.end());
+        std::sort(allocs.begin(), allocs.end());
+
+        Result r;
+        r.name = name;
+        r.iterations = iterations;
+        r.ns_per_op = ns[m_samples/2];
+        r.allocs_per_op = double(allocs[m_samples/2])/iterations;
+        r.items_per_op = items_per_op;
+        m_results.push_back(r);
+    }
+
+    // name,iterations,ns_per_op,allocs_per_op,items_per_s
+    void PrintCSV(std::ostream& os) const
+    {
+        os << "name,iterations,ns_per_op,allocs_per_op,items_per_s\n";
+        for (const Result& r : m_results)
+        {
+            os << r.name << "," << r.iterations << ","
+               << std::fixed << std::setprecision(1) << r.ns_per_op << ","
+               << std::setprecision(2) << r.allocs_per_op << ","
+               << std::setprecision(0) << Throughput(r) << "\n";
+        }
+        os << std::defaultfloat;
+    }
+
+    void PrintJSON(std::ostream& os) const
+    {
+        os << "[\n";
+        for (size_t i = 0; i < m_results.size(); ++i)
+        {
+            const Result& r = m_results[i];
+            os << "  {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations
+               << std::fixed << std::setprecision(1) << ", \"ns_per_op\": " << r.ns_per_op
+               << std::setprecision(2) << ", \"allocs_per_op\": " << r.allocs_per_op
+               << std::setprecision(0) << ", \"items_per_s\": " << Throughput(r) << "}"
+               << (i+1 < m_results.size() ? ",\n" : "\n");
+        }
+        os << "]\n" << std::defaultfloat;
+    }
+
+private:
+    static double Throughput(const Result& r)
+    {
+        return r.ns_per_op > 0 ? r.items_per_op*1e9/r.ns_per_op : 0;
+    }
+
+    size_t m_samples;
+    std::string m_filter;
+    std::vector<Result> m_results;
+};
+
+} // namespace bench
+
+// To be expanded once in the driver translation unit. Every allocation
+// function takes its memory from std::malloc and every deallocation
+// function gives it back with std::free. They are kept out of line :
+// once inlined, GCC pairs the std::free of a delete with the new
+// expression of its caller and reports a mismatch.
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+#define BENCH_COUNT_ALLOCATIONS \
+    BENCH_NOINLINE void* operator new(std::size_t size, const std::nothrow_t&) noexcept \
+    { \
+        bench::allocations().fetch_add(1, std::memory_order_relaxed); \
+        return std::malloc(size ? size : 1); \
+    } \
+    BENCH_NOINLINE void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept \
+    { \
+        return operator new(size, tag); \
+    } \
+    BENCH_NOINLINE void* operator new(std::size_t size) \
+    { \
+        if (void* p = operator new(size, std::nothrow)) return p; \
+        throw std::bad_alloc(); \
+    } \
+    BENCH_NOINLINE void* operator new[](std::size_t size) \
+    { \
+        if (void* p = operator new(size, std::nothrow)) return p; \
+        throw std::bad_alloc(); \
+    } \
+    BENCH_NOINLINE void operator delete(void* p) noexcept \
+    { \
+        std::free(p); \
+    } \
+    BENCH_NOINLINE void operator delete[](void* p) noexcept \
+    { \
+        std::free(p); \
+    } \
+    BENCH_NOINLINE void operator delete(void* p, std::size_t) noexcept \
+    { \
+        std::free(p); \
+    } \
+    BENCH_NOINLINE void operator delete[](void* p, std::size_t) noexcept \
+    { \
+        std::free(p); \
+    } \
+    BENCH_NOINLINE void operator delete(void* p, const std::nothrow_t&) noexcept \
+    { \
+        std::free(p); \
+    } \
+    BENCH_NOINLINE void operator delete[](void* p, const std::nothrow_t&) noexcept \
+    { \
+        std::free(p); \
+    }
+
+#endif // H_BENCH
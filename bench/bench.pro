@@ -0,0 +1,6 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    linalg_bench.pro \
+    inkamath_bench.pro \
+    numeric_bench.pro
@@ -0,0 +1,247 @@
+#include "bench.hpp"
+#include "interpreter.hpp"
+#include "mapstack.hpp"
+#include "matrix.hpp"
+
+#include <iostream>
+#include <complex>
+#include <string>
+#include <random>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+
+/**
+ ***************************************
+ * Microbenchmarks of the interpreter hot paths.
+ *
+ * usage : inkamath_bench [--json] [filter]
+ * Prints one CSV (or JSON) record per case on the standard output.
+ ***************************************
+ */
+
+BENCH_COUNT_ALLOCATIONS
+
+typedef std::complex<double> scalar;
+
+static const std::string expression =
+    "f(x,y)=(x+2*y)^2/(1+x*y)-[1 2;3 4]*[x;y]+!5+atan(z)_(n-1)*(a+b-c)";
+
+Matrix<scalar> random_matrix(size_t n, std::mt19937& gen)
+{
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Matrix<scalar> a(n, n);
+    for (size_t i = 1; i <= n; ++i)
+        for (size_t j = 1; j <= n; ++j)
+            a(i,j) = scalar(dist(gen), dist(gen));
+    return a;
+}
+
+int main(int argc, char* argv[])
+{
+    bool json = false;
+    bench::Suite suite;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--json") json = true;
+        else suite.SetFilter(arg);
+    }
+
+    Interpreter<scalar> p;
+    const size_t tokens = p.Tokenize(expression);
+
+    suite.Run("lex", 20000, double(tokens), [&]() {
+        p.Tokenize(expression);
+    });
+
+    suite.Run("parse", 20000, double(tokens), [&]() {
+        p.Compile(expression);
+    });
+
+    // data literal of 100k decimals
+    std::string literal = "[";
+    {
+        std::mt19937 literal_gen(1);
+        std::uniform_int_distribution<int> digits(0, 999999);
+        for (size_t k = 0; k < 100000; ++k)
+        {
+            literal += std::to_string(digits(literal_gen)/1000) + "." + std::to_string(digits(literal_gen)) + " ";
+        }
+        literal += "]";
+    }
+    suite.Run("lex_literal_100k", 5, 100000, [&]() {
+        p.Tokenize(literal);
+    });
+
+    p.Eval("f(x)=x^2+2*x+1");
+    suite.Run("eval_scalar", 20000, 1, [&]() {
+        p.Eval("f(3)*2-1/f(2)");
+    });
+
+#ifdef INKAMATH_JIT
+    {
+        // the same calls interpreted and compiled
+        Interpreter<scalar> q;
+        q.Eval("h(x,y)=(x+2*y)^2/(1+x*y)-atan(x)*sqrt(y)+exp(-x*y)/!3");
+        const std::string calls = "h(0.5,2)+h(1,3)+h(2,0.25)+h(i,1)";
+        q.SetJitThreshold(0);
+        suite.Run("call_interpreted", 20000, 4, [&]() {
+            q.Eval(calls);
+        });
+        q.SetJitThreshold(1);
+        q.Eval(calls);
+        suite.Run("call_jit", 20000, 4, [&]() {
+            q.Eval(calls);
+        });
+    }
+#endif
+
+    p.Eval("exp(x)_n=exp(x)_(n-1)+x^n/!n");
+    suite.Run("series_exp", 200, 1, [&]() {
+        p.Eval("exp(1)");
+    });
+
+    p.Eval("atan(z)_n=atan(z)_(n-1)+2^(2*n)*(!n)^2*z^(2*n+1)/(!(2*n+1)*(1+z^2)^(n+1))");
+    suite.Run("series_atan", 200, 1, [&]() {
+        p.Eval("atan(1)*4");
+    });
+
+    p.Eval("am(x,y)_0=(x+y)/2");
+    p.Eval("gm(x,y)_0=(x*y)^0.5");
+    p.Eval("am(x,y)_n=(am(x,y)_(n-1)+gm(x,y)_(n-1))/2");
+    p.Eval("gm(x,y)_n=(am(x,y)_(n-1)*gm(x,y)_(n-1))^0.5");
+    // the terms are kept across calls until a definition changes : each
+    // iteration redefines the first term to evaluate them again
+    suite.Run("series_agm", 20, 1, [&]() {
+        p.Eval("am(x,y)_0=(x+y)/2");
+        p.Eval("gm(1,2)_10");
+    });
+
+    // cells of a matrix literal evaluated on the thread pool
+    p.Eval("w_0=0");
+    p.Eval("w_n=w_(n-1)+1/n^2");
+    p.Eval("wx(x)=w_x*x");
+    // redefining w_0 drops the terms kept by the previous iteration
+    suite.Run("parallel_cells", 20, 8, [&]() {
+        p.Eval("w_0=0");
+        p.Eval("[wx(4000) wx(4001) wx(4002) wx(4003) wx(4004) wx(4005) wx(4006) wx(4007)]");
+    });
+
+    // scalar function mapped over a 1x1000 matrix
+    {
+        std::string values = "v=[";
+        for (int k = 1; k <= 1000; ++k)
+        {
+            values += std::to_string(k) + " ";
+        }
+        p.Eval(values + "]");
+        p.Eval("q(x)=x^2+2*x+1");
+        suite.Run("map_scalar_1000", 200, 1000, [&]() {
+            p.Eval("map(q,v)");
+        });
+    }
+
+    std::mt19937 gen(42);
+    for (size_t n : {8, 64, 256})
+    {
+        Matrix<scalar> a = random_matrix(n, gen);
+        Matrix<scalar> b = random_matrix(n, gen);
+        size_t iterations = std::max<size_t>(1, 2000000/(n*n*n));
+        suite.Run("matrix_mul_" + std::to_string(n), iterations, double(n*n), [&]() {
+            Matrix<scalar> c = a*b;
+        });
+    }
+
+    // elementwise kernels, on the thread pool from Elementwise::Threshold()
+    // elements (INKAMATH_THREADS threads) and on the calling thread
+    {
+        Matrix<scalar> a = random_matrix(512, gen);
+        Matrix<scalar> b = random_matrix(512, gen);
+        for (bool parallel : {true, false})
+        {
+            const std::string suffix = parallel ? "" : "_serial";
+            Elementwise::SetThreshold(parallel ? Elementwise::default_threshold : size_t(-1));
+            suite.Run("elementwise_add_512" + suffix, 200, 512*512, [&]() {
+                Matrix<scalar> c = a+b;
+            });
+            suite.Run("elementwise_scale_512" + suffix, 200, 512*512, [&]() {
+                Matrix<scalar> c = a*scalar(0.5, 2.0);
+            });
+        }
+        Elementwise::SetThreshold(Elementwise::default_threshold);
+    }
+
+    {
+        Matrix<scalar> m = random_matrix(100, gen);
+        suite.Run("format_matrix_100", 20, 100*100, [&]() {
+            Matrix<scalar>::toString(m);
+        });
+    }
+
+    p.Eval("a=[1 2;3 4]");
+    p.Eval("b=[a a;a a]");
+    p.Eval("c=[b b;b b]");
+    suite.Run("block_assembly", 2000, 16*16, [&]() {
+        p.Eval("[c c;c c]");
+    });
+
+    // mostly zero block matrix of 256x256, stored sparse (see sparse.hpp)
+    p.Eval("s_0=[1 2;3 4]");
+    p.Eval("s_n=[s_(n-1) 0;0 s_(n-1)]");
+    suite.Run("sparse_block_assembly_256", 20, 256*256, [&]() {
+        p.Eval("[s_6 0;0 s_6]");
+    });
+    {
+        Matrix<scalar> s = p.Eval("s_7");
+        Matrix<scalar> d = s.ToDense();
+        suite.Run("sparse_mul_256", 20, 256*256, [&]() {
+            Matrix<scalar> c = s*s;
+        });
+        suite.Run("dense_mul_256", 2, 256*256, [&]() {
+            Matrix<scalar> c = d*d;
+        });
+    }
+
+    // warm start : replaying 300 definitions vs restoring their snapshot
+    {
+        std::vector<std::string> script;
+        for (int k = 0; k < 100; ++k)
+        {
+            const std::string n = std::to_string(k);
+            script.push_back("s" + n + "(x)_n=s" + n + "(x)_(n-1)+x^n/!n");
+            script.push_back("f" + n + "(x,y=" + n + ")=(x+2*y)^2/(1+x*y)-atan(x)*s" + n + "(y)");
+            script.push_back("m" + n + "=[1 2 3;4 5 6;7 8 " + n + "]");
+        }
+        std::ostringstream errors;
+        suite.Run("session_replay", 10, double(script.size()), [&]() {
+            Interpreter<scalar> q;
+            q.SetErrorStream(errors);
+            for (const std::string& line : script) q.Eval(line);
+        });
+
+        Interpreter<scalar> q;
+        for (const std::string& line : script) q.Eval(line);
+        const std::string path = "inkamath_bench_session.bin";
+        q.SaveSession(path);
+        suite.Run("session_restore", 10, double(script.size()), [&]() {
+            Interpreter<scalar> r;
+            r.RestoreSession(path);
+        });
+        std::remove(path.c_str());
+    }
+
+    Mapstack<std::string, int> stack;
+    const std::string keys[] = {"x", "y", "z", "n"};
+    suite.Run("mapstack_push_pop", 200000, 4, [&]() {
+        stack.Push();
+        for (const std::string& key : keys) stack.Set(key, 1);
+        int value = 0;
+        for (const std::string& key : keys) stack.Get(key, value);
+        stack.Pop();
+    });
+
+    if (json) suite.PrintJSON(std::cout);
+    else suite.PrintCSV(std::cout);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "matrix.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <complex>
+#include <chrono>
+#include <random>
+
+/**
+ ***************************************
+ * LU solve against a naive Gauss-Jordan elimination
+ * on the same dense random systems.
+ ***************************************
+ */
+
+typedef std::complex<double> scalar;
+
+// Textbook Gauss-Jordan elimination on the augmented matrix [A b]
+// through the checked 1-based accessors, without pivoting.
+Matrix<scalar> naive_gauss(Matrix<scalar> a, Matrix<scalar> b)
+{
+    const size_t n = a.Size().first;
+    const size_t r = b.Size().second;
+    for (size_t k = 1; k <= n; ++k)
+    {
+        scalar pivot = a(k,k);
+        for (size_t j = 1; j <= n; ++j) a(k,j) /= pivot;
+        for (size_t j = 1; j <= r; ++j) b(k,j) /= pivot;
+        for (size_t i = 1; i <= n; ++i)
+        {
+            if (i == k) continue;
+            scalar l = a(i,k);
+            for (size_t j = 1; j <= n; ++j) a(i,j) -= l*a(k,j);
+            for (size_t j = 1; j <= r; ++j) b(i,j) -= l*b(k,j);
+        }
+    }
+    return b;
+}
+
+Matrix<scalar> random_matrix(size_t n, size_t m, std::mt19937& gen)
+{
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Matrix<scalar> a(n, m);
+    for (size_t i = 1; i <= n; ++i)
+        for (size_t j = 1; j <= m; ++j)
+            a(i,j) = scalar(dist(gen), 0.0);
+    return a;
+}
+
+template <typename Func>
+double time_ns(Func f, size_t iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) f();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(stop-start).count()/iterations;
+}
+
+int main()
+{
+    std::mt19937 gen(42);
+    std::cout << "size,lu_solve_ns,naive_gauss_ns,speedup,residual" << std::endl;
+    for (size_t n : {4, 16, 64, 128, 256})
+    {
+        // diagonally dominant so that the naive elimination stays stable
+        Matrix<scalar> a = random_matrix(n, n, gen) + Matrix<scalar>::identity(n).mul(Matrix<scalar>(scalar(n)));
+        Matrix<scalar> b = random_matrix(n, 1, gen);
+        size_t iterations = std::max<size_t>(1, 2000000/(n*n*n));
+
+        Matrix<scalar> x;
+        double lu = time_ns([&]() {x = Matrix<scalar>::solve(a, b);}, iterations);
+        double naive = time_ns([&]() {naive_gauss(a, b);}, iterations);
+
+        Matrix<scalar> res = a*x - b;
+        double residual = 0;
+        for (size_t i = 1; i <= n; ++i) residual = std::max(residual, std::abs(res(i,1)));
+
+        std::cout << n << "," << std::fixed << std::setprecision(0) << lu << "," << naive << ","
+                  << std::setprecision(2) << naive/lu << "," << std::scientific << residual
+                  << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "bench.hpp"
+#include "bigfloat.hpp"
+#include "interval.hpp"
+#include "interpreter.hpp"
+#include "getlines.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <complex>
+#include <string>
+#include <vector>
+
+/**
+ ***************************************
+ * Throughput of the scalar types the interpreter can be instantiated
+ * with, at the numeric_interface level, through the interpreter and on
+ * the test/data scripts.
+ *
+ * usage : numeric_bench [--json] [filter]
+ * Prints one CSV (or JSON) record per case on the standard output.
+ ***************************************
+ */
+
+BENCH_COUNT_ALLOCATIONS
+
+// Case names are suffixed with the scalar name (double, bigfloat50...)
+template <typename T>
+void run_scalar(bench::Suite& suite, const std::string& suffix, size_t iterations)
+{
+    typedef numeric_interface<T> ni;
+    const T x = ni::sqrt(T(2));
+    const T y = ni::sqrt(T(3));
+    T acc = ni::zero();
+
+    suite.Run("add_" + suffix, iterations*10, 1, [&]() {
+        acc = acc + x;
+    });
+    suite.Run("mul_" + suffix, iterations*10, 1, [&]() {
+        acc = x*y;
+    });
+    suite.Run("div_" + suffix, iterations, 1, [&]() {
+        acc = x/y;
+    });
+    suite.Run("sqrt_" + suffix, iterations/10+1, 1, [&]() {
+        acc = ni::sqrt(y);
+    });
+    suite.Run("exp_" + suffix, iterations/10+1, 1, [&]() {
+        acc = ni::exp(x);
+    });
+    suite.Run("format_" + suffix, iterations/10+1, 1, [&]() {
+        ni::toString(x);
+    });
+
+    // 40 terms of the exponential series through the interpreter,
+    // redefining s_0 drops the terms kept by the previous iteration
+    Interpreter<std::complex<T>> p;
+    p.Eval("s_n=s_(n-1)+1/!n");
+    suite.Run("series_exp_" + suffix, iterations/100+1, 40, [&]() {
+        p.Eval("s_0=1");
+        p.Eval("s_40");
+    });
+}
+
+// The lines of the test/data scripts, each run by a new interpreter
+template <typename T>
+void run_scripts(bench::Suite& suite, const std::string& suffix, const std::vector<std::string>& script)
+{
+    std::ostringstream errors;
+    suite.Run("data_scripts_" + suffix, 5, double(script.size()), [&]() {
+        Interpreter<std::complex<T>> p;
+        p.SetErrorStream(errors);
+        for (const std::string& line : script) p.Eval(line);
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bool json = false;
+    bench::Suite suite;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--json") json = true;
+        else suite.SetFilter(arg);
+    }
+
+    run_scalar<double>(suite, "double", 200000);
+    run_scalar<Interval>(suite, "interval", 200000);
+    run_scalar<BigFloat<50>>(suite, "bigfloat50", 20000);
+    run_scalar<BigFloat<100>>(suite, "bigfloat100", 10000);
+    run_scalar<BigFloat<1000>>(suite, "bigfloat1000", 1000);
+
+    std::vector<std::string> script;
+    const std::string source = __FILE__;
+    const std::string data = source.substr(0, source.find_last_of("/\\")+1) + "../test/data/";
+    for (int k = 1; k <= 5; ++k)
+    {
+        std::ifstream input(data + "input" + std::to_string(k) + ".txt");
+        for (auto& line : getlines(input))
+        {
+            if (!line.empty() && line[0] != '#') script.push_back(line);
+        }
+    }
+    run_scripts<double>(suite, "double", script);
+    run_scripts<Interval>(suite, "interval", script);
+
+    if (json) suite.PrintJSON(std::cout);
+    else suite.PrintCSV(std::cout);
+    return 0;
+}
@@ -0,0 +1,15 @@
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG -= qt
+CONFIG += thread
+
+QMAKE_CXXFLAGS += -std=c++11
+QMAKE_CXXFLAGS_RELEASE *= -O3
+INCLUDEPATH += ..\
+
+SOURCES += \
+    numeric_bench.cpp
+
+HEADERS += \
+    bench.hpp
@@ -0,0 +1,1169 @@
+#ifndef H_BIGFLOAT
+#define H_BIGFLOAT
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "number_format.hpp"
+
+/**
+ ***************************************
+ * Multiprecision floating point number of Digits significant decimal
+ * digits, the scalar of Interpreter<std::complex<BigFloat<Digits>>>.
+ *
+ * The mantissa is a fixed array of 32 bits limbs, the digits and two
+ * guard limbs, with an exponent counted in limbs : a BigFloat is a plain
+ * value, without allocation, copied as is by the sessions. The products
+ * and the quotients skip the zero low limbs of their operands, so the small
+ * integers of the scripts (indices, the n of a series term) cost a single
+ * limb and a quotient by one of them is a short division. The results are
+ * rounded to the nearest on the first dropped limb.
+ * The elementary functions reduce their argument and sum a Taylor series,
+ * gamma sums the series of the lower incomplete gamma function, all at the
+ * precision of the type. The gamma function of a complex non real argument
+ * keeps the 15 digits of its Lanczos approximation (numeric_interface.hpp).
+ * There is no negative zero : -0 is 0.
+ *
+ * BigFloat provides the static functions numeric_interface forwards to and
+ * the free functions (abs, exp, atan2...) std::complex uses.
+ ***************************************
+ */
+
+template <unsigned Digits>
+class BigFloat
+{
+public:
+    static const int precision = Digits;
+    // sign, digits, decimal point and exponent
+    static const size_t buffer_size = Digits + 16;
+    // 32 bits limbs of the mantissa : the digits and two guard limbs
+    static const size_t limbs = (Digits*3322/1000 + 31)/32 + 2;
+
+    BigFloat() : exp_(0), neg_(false), kind_(Finite)
+    {
+        std::fill_n(m_, limbs, 0u);
+    }
+
+    BigFloat(double a) : BigFloat()
+    {
+        if (std::isnan(a))
+        {
+            *this = Special(NotANumber, std::signbit(a));
+        }
+        else if (std::isinf(a))
+        {
+            *this = Special(Infinite, a < 0);
+        }
+        else if (a != 0)
+        {
+            int e;
+            const double f = std::frexp(std::fabs(a), &e);
+            const uint64_t mantissa = uint64_t(std::ldexp(f, 64));
+            uint32_t w[2] = {uint32_t(mantissa), uint32_t(mantissa >> 32)};
+            *this = Ldexp(Round(a < 0, 0, w, 2), e);
+        }
+    }
+
+    bool IsNaN() const {return kind_ == NotANumber;}
+    bool IsInf() const {return kind_ == Infinite;}
+    bool IsZero() const {return kind_ == Finite && m_[limbs-1] == 0;}
+    bool IsNegative() const {return neg_;}
+
+    bool IsInteger() const
+    {
+        if (kind_ != Finite || IsZero())
+        {
+            return kind_ == Finite;
+        }
+        if (exp_ <= 0)
+        {
+            return false;
+        }
+        for (int64_t i = 0; i < int64_t(limbs) - exp_; ++i)
+        {
+            if (m_[i] != 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Nearest double
+    double ToDouble() const
+    {
+        if (kind_ != Finite)
+        {
+            return IsNaN() ? std::nan("") : (neg_ ? -HUGE_VAL : HUGE_VAL);
+        }
+        double f = 0;
+        for (size_t k = 0; k < 3 && k < limbs; ++k)
+        {
+            f += std::ldexp(double(m_[limbs-1-k]), -32*int(k+1));
+        }
+        const int32_t e = std::max<int32_t>(-64, std::min<int32_t>(64, exp_));
+        f = std::ldexp(f, 32*e);
+        return neg_ ? -f : f;
+    }
+
+    BigFloat operator-() const
+    {
+        BigFloat r = *this;
+        r.neg_ = !neg_ && !IsZero();
+        return r;
+    }
+
+    BigFloat& operator+=(const BigFloat& b) {return *this = *this + b;}
+    BigFloat& operator-=(const BigFloat& b) {return *this = *this - b;}
+    BigFloat& operator*=(const BigFloat& b) {return *this = *this * b;}
+    BigFloat& operator/=(const BigFloat& b) {return *this = *this / b;}
+
+    friend BigFloat operator+(const BigFloat& a, const BigFloat& b)
+    {
+        if (a.kind_ != Finite || b.kind_ != Finite)
+        {
+            if (a.IsNaN() || b.IsNaN() || (a.IsInf() && b.IsInf() && a.neg_ != b.neg_))
+            {
+                return Special(NotANumber, false);
+            }
+            return a.IsInf() ? a : b;
+        }
+        if (a.IsZero())
+        {
+            return b;
+        }
+        if (b.IsZero())
+        {
+            return a;
+        }
+        if (a.neg_ == b.neg_)
+        {
+            return a.exp_ >= b.exp_ ? AddMagnitudes(a, b, a.neg_) : AddMagnitudes(b, a, a.neg_);
+        }
+        const int c = CompareMagnitudes(a, b);
+        if (c == 0)
+        {
+            return BigFloat();
+        }
+        return c > 0 ? SubtractMagnitudes(a, b, a.neg_) : SubtractMagnitudes(b, a, b.neg_);
+    }
+
+    friend BigFloat operator-(const BigFloat& a, const BigFloat& b)
+    {
+        return a + (-b);
+    }
+
+    friend BigFloat operator*(const BigFloat& a, const BigFloat& b)
+    {
+        const bool neg = a.neg_ != b.neg_;
+        if (a.kind_ != Finite || b.kind_ != Finite)
+        {
+            if (a.IsNaN() || b.IsNaN() || a.IsZero() || b.IsZero())
+            {
+                return Special(NotANumber, false);
+            }
+            return Special(Infinite, neg);
+        }
+        if (a.IsZero() || b.IsZero())
+        {
+            return BigFloat();
+        }
+        // schoolbook product from the lowest nonzero limbs
+        uint32_t w[2*limbs] = {};
+        const size_t la = a.Low(), lb = b.Low();
+        for (size_t i = la; i < limbs; ++i)
+        {
+            uint64_t carry = 0;
+            for (size_t j = lb; j < limbs; ++j)
+            {
+                const uint64_t t = uint64_t(a.m_[i])*b.m_[j] + w[i+j] + carry;
+                w[i+j] = uint32_t(t);
+                carry = t >> 32;
+            }
+            w[i+limbs] = uint32_t(carry);
+        }
+        return Round(neg, int64_t(a.exp_) + b.exp_, w, 2*limbs);
+    }
+
+    friend BigFloat operator/(const BigFloat& a, const BigFloat& b)
+    {
+        const bool neg = a.neg_ != b.neg_;
+        if (a.kind_ != Finite || b.kind_ != Finite)
+        {
+            if (a.IsNaN() || b.IsNaN() || (a.IsInf() && b.IsInf()))
+            {
+                return Special(NotANumber, false);
+            }
+            return a.IsInf() ? Special(Infinite, neg) : BigFloat();
+        }
+        if (b.IsZero())
+        {
+            return a.IsZero() ? Special(NotANumber, false) : Special(Infinite, neg);
+        }
+        if (a.IsZero())
+        {
+            return BigFloat();
+        }
+        // u : the mantissa of a above limbs+1 zero limbs, divided by the
+        // nonzero limbs v of the mantissa of b
+        const size_t m = 2*limbs+1;
+        uint32_t u[m] = {};
+        std::copy(a.m_, a.m_+limbs, u+limbs+1);
+        const size_t lb = b.Low();
+        const uint32_t* v = b.m_+lb;
+        const size_t n = limbs-lb;
+        uint32_t q[m] = {};
+        size_t qn = m;
+        if (n == 1)
+        {
+            uint64_t r = 0;
+            for (size_t i = m; i-- > 0; )
+            {
+                const uint64_t current = (r << 32) | u[i];
+                q[i] = uint32_t(current / v[0]);
+                r = current % v[0];
+            }
+        }
+        else
+        {
+            Divide(q, u, m, v, n);
+            qn = m-n+1;
+        }
+        return Round(neg, int64_t(qn) - int64_t(limbs+1) - int64_t(lb) + a.exp_ - b.exp_, q, qn);
+    }
+
+    friend bool operator==(const BigFloat& a, const BigFloat& b) {return Compare(a, b) == 0;}
+    friend bool operator!=(const BigFloat& a, const BigFloat& b) {return Compare(a, b) != 0;}
+    friend bool operator<(const BigFloat& a, const BigFloat& b) {return Compare(a, b) == -1;}
+    friend bool operator>(const BigFloat& a, const BigFloat& b) {return Compare(a, b) == 1;}
+    friend bool operator<=(const BigFloat& a, const BigFloat& b) {int c = Compare(a, b); return c == -1 || c == 0;}
+    friend bool operator>=(const BigFloat& a, const BigFloat& b) {int c = Compare(a, b); return c == 1 || c == 0;}
+
+    // a*2^k
+    static BigFloat Ldexp(const BigFloat& a, int64_t k)
+    {
+        if (a.kind_ != Finite || a.IsZero())
+        {
+            return a;
+        }
+        int64_t q = k/32, r = k%32;
+        if (r < 0)
+        {
+            r += 32;
+            --q;
+        }
+        uint32_t w[limbs+1];
+        w[0] = a.m_[0] << r;
+        for (size_t i = 1; i < limbs; ++i)
+        {
+            w[i] = (a.m_[i] << r) | (r ? a.m_[i-1] >> (32-r) : 0);
+        }
+        w[limbs] = r ? a.m_[limbs-1] >> (32-r) : 0;
+        return Round(a.neg_, a.exp_ + q + 1, w, limbs+1);
+    }
+
+    static BigFloat Floor(const BigFloat& a)
+    {
+        if (a.kind_ != Finite || a.IsZero() || a.exp_ >= int32_t(limbs))
+        {
+            return a;
+        }
+        if (a.exp_ <= 0)
+        {
+            return a.neg_ ? BigFloat(-1) : BigFloat();
+        }
+        BigFloat r = a;
+        bool dropped = false;
+        for (size_t i = 0; i < limbs - size_t(a.exp_); ++i)
+        {
+            dropped = dropped || r.m_[i] != 0;
+            r.m_[i] = 0;
+        }
+        return (a.neg_ && dropped) ? r - BigFloat(1) : r;
+    }
+
+    static BigFloat Pi()
+    {
+        // Machin : pi = 16 atan(1/5) - 4 atan(1/239)
+        static const BigFloat pi = BigFloat(16)*AtanInverse(5) - BigFloat(4)*AtanInverse(239);
+        return pi;
+    }
+
+    static BigFloat Ln2()
+    {
+        // ln 2 = 2 atanh(1/3)
+        static const BigFloat ln2 = [](){
+            const BigFloat nine(9);
+            BigFloat power = BigFloat(1)/BigFloat(3), sum = power;
+            for (uint32_t k = 3; ; k += 2)
+            {
+                power = power/nine;
+                const BigFloat term = power/BigFloat(k);
+                if (Negligible(term, sum))
+                {
+                    break;
+                }
+                sum += term;
+            }
+            return Ldexp(sum, 1);
+        }();
+        return ln2;
+    }
+
+    /* numeric_interface */
+    static BigFloat zero() {return BigFloat();}
+    static BigFloat one() {return BigFloat(1);}
+    static int toInt(const BigFloat& a) {return static_cast<int>(a.ToDouble());}
+    static BigFloat abs(const BigFloat& a) {return a.neg_ ? -a : a;}
+    static BigFloat conj(const BigFloat& a) {return a;}
+
+    static BigFloat sqrt(const BigFloat& a)
+    {
+        if (a.IsNaN() || a.IsZero() || (a.IsInf() && !a.neg_))
+        {
+            return a;
+        }
+        if (a.neg_)
+        {
+            return Special(NotANumber, false);
+        }
+        // Newton on a*4^-h, in the range of the doubles
+        const int64_t h = 16*int64_t(a.exp_);
+        const BigFloat x = Ldexp(a, -2*h);
+        BigFloat r = BigFloat(std::sqrt(x.ToDouble()));
+        for (int64_t bits = 48; bits < 2*Bits(); bits *= 2)
+        {
+            r = Ldexp(r + x/r, -1);
+        }
+        return Ldexp(r, h);
+    }
+
+    static BigFloat exp(const BigFloat& a)
+    {
+        if (a.kind_ != Finite)
+        {
+            return a.IsNaN() ? a : (a.neg_ ? BigFloat() : a);
+        }
+        const double x = a.ToDouble();
+        if (std::fabs(x) > 1e9)
+        {
+            return x < 0 ? BigFloat() : Special(Infinite, false);
+        }
+        // a = k*ln(2) + r, exp(r) = exp(r/2^16)^(2^16)
+        const double k = std::floor(x/0.69314718055994530942 + 0.5);
+        const int squarings = 16;
+        const BigFloat r = Ldexp(a - BigFloat(k)*Ln2(), -squarings);
+        BigFloat sum = BigFloat(1), term = sum;
+        for (uint32_t n = 1; ; ++n)
+        {
+            term = term*r/BigFloat(n);
+            if (Negligible(term, sum))
+            {
+                break;
+            }
+            sum += term;
+        }
+        for (int i = 0; i < squarings; ++i)
+        {
+            sum = sum*sum;
+        }
+        return Ldexp(sum, int64_t(k));
+    }
+
+    static BigFloat log(const BigFloat& a)
+    {
+        if (a.IsNaN() || (a.neg_ && !a.IsZero()))
+        {
+            return Special(NotANumber, false);
+        }
+        if (a.IsZero())
+        {
+            return Special(Infinite, true);
+        }
+        if (a.IsInf())
+        {
+            return a;
+        }
+        // a = x*2^k with sqrt(1/2) <= x < sqrt(2), Halley's iterations on
+        // exp from log(x) in double
+        int64_t k = 32*int64_t(a.exp_);
+        for (uint32_t top = a.m_[limbs-1]; !(top & 0x80000000u); top <<= 1)
+        {
+            --k;
+        }
+        BigFloat x = Ldexp(a, -k);
+        if (x.ToDouble() < 0.70710678118654752440)
+        {
+            x = Ldexp(x, 1);
+            --k;
+        }
+        BigFloat r = BigFloat(std::log(x.ToDouble()));
+        for (int64_t bits = 48; bits < Bits(); bits *= 3)
+        {
+            const BigFloat e = exp(r);
+            r += Ldexp((x - e)/(x + e), 1);
+        }
+        return r + BigFloat(double(k))*Ln2();
+    }
+
+    static BigFloat pow(const BigFloat& a, const BigFloat& b)
+    {
+        if (b.IsInteger() && std::fabs(b.ToDouble()) < 2147483648.0)
+        {
+            // exponentiation by squaring
+            int64_t n = int64_t(std::fabs(b.ToDouble()));
+            BigFloat r = BigFloat(1), x = a;
+            for (; n != 0; n >>= 1)
+            {
+                if (n & 1)
+                {
+                    r *= x;
+                }
+                x *= x;
+            }
+            return b.neg_ ? BigFloat(1)/r : r;
+        }
+        if (a.IsZero())
+        {
+            return b.neg_ ? Special(Infinite, false) : BigFloat();
+        }
+        return exp(b*log(a));
+    }
+
+    static BigFloat sin(const BigFloat& a)
+    {
+        BigFloat s, c;
+        SinCos(a, s, c);
+        return s;
+    }
+
+    static BigFloat cos(const BigFloat& a)
+    {
+        BigFloat s, c;
+        SinCos(a, s, c);
+        return c;
+    }
+
+    static BigFloat tan(const BigFloat& a)
+    {
+        BigFloat s, c;
+        SinCos(a, s, c);
+        return s/c;
+    }
+
+    static BigFloat atan(const BigFloat& a)
+    {
+        if (a.kind_ != Finite || a.IsZero())
+        {
+            return a.IsInf() ? Ldexp(a.neg_ ? -Pi() : Pi(), -1) : a;
+        }
+        // atan(x) = pi/2 - atan(1/x), atan(x) = 2 atan(x/(1+sqrt(1+x^2)))
+        BigFloat x = abs(a);
+        const bool inverse = x > BigFloat(1);
+        if (inverse)
+        {
+            x = BigFloat(1)/x;
+        }
+        const int halvings = 6;
+        for (int i = 0; i < halvings; ++i)
+        {
+            x = x/(BigFloat(1) + sqrt(BigFloat(1) + x*x));
+        }
+        const BigFloat x2 = x*x;
+        BigFloat power = x, sum = x;
+        for (uint32_t k = 3; ; k += 2)
+        {
+            power = -(power*x2);
+            const BigFloat term = power/BigFloat(k);
+            if (Negligible(term, sum))
+            {
+                break;
+            }
+            sum += term;
+        }
+        sum = Ldexp(sum, halvings);
+        if (inverse)
+        {
+            sum = Ldexp(Pi(), -1) - sum;
+        }
+        return a.neg_ ? -sum : sum;
+    }
+
+    static BigFloat atan2(const BigFloat& y, const BigFloat& x)
+    {
+        if (x.IsZero())
+        {
+            return y.IsZero() ? BigFloat() : Ldexp(y.neg_ ? -Pi() : Pi(), -1);
+        }
+        const BigFloat t = atan(y/x);
+        if (!x.neg_)
+        {
+            return t;
+        }
+        return y.neg_ ? t - Pi() : t + Pi();
+    }
+
+    static BigFloat asin(const BigFloat& a)
+    {
+        const BigFloat one(1);
+        if (abs(a) > one)
+        {
+            return Special(NotANumber, false);
+        }
+        if (abs(a) == one)
+        {
+            return Ldexp(a.neg_ ? -Pi() : Pi(), -1);
+        }
+        return atan(a/sqrt((one - a)*(one + a)));
+    }
+
+    static BigFloat acos(const BigFloat& a)
+    {
+        const BigFloat one(1);
+        if (abs(a) > one)
+        {
+            return Special(NotANumber, false);
+        }
+        return Ldexp(atan(sqrt((one - a)/(one + a))), 1);
+    }
+
+    static BigFloat sinh(const BigFloat& a)
+    {
+        if (a.kind_ == Finite && abs(a) < BigFloat(1))
+        {
+            // Taylor series, without the cancellation of (e^a-e^-a)/2
+            const BigFloat a2 = a*a;
+            BigFloat term = a, sum = a;
+            for (uint32_t n = 3; ; n += 2)
+            {
+                term = term*a2/BigFloat(double(n)*(n-1));
+                if (Negligible(term, sum))
+                {
+                    break;
+                }
+                sum += term;
+            }
+            return sum;
+        }
+        const BigFloat e = exp(a);
+        return Ldexp(e - BigFloat(1)/e, -1);
+    }
+
+    static BigFloat cosh(const BigFloat& a)
+    {
+        const BigFloat e = exp(a);
+        return Ldexp(e + BigFloat(1)/e, -1);
+    }
+
+    static BigFloat tanh(const BigFloat& a)
+    {
+        if (a.IsNaN())
+        {
+            return a;
+        }
+        if (abs(a) > BigFloat(double(Bits())))
+        {
+            return BigFloat(a.neg_ ? -1 : 1);
+        }
+        return sinh(a)/cosh(a);
+    }
+
+    static BigFloat gamma(const BigFloat& a)
+    {
+        if (a.IsNaN() || (a.IsInf() && a.neg_))
+        {
+            return Special(NotANumber, false);
+        }
+        if (a.IsInf())
+        {
+            return a;
+        }
+        if (a.IsInteger())
+        {
+            if (a.IsZero() || a.neg_)
+            {
+                return a.IsZero() ? Special(Infinite, false) : Special(NotANumber, false);
+            }
+            if (a.ToDouble() <= 100000)
+            {
+                return fact(a - BigFloat(1));
+            }
+        }
+        if (a < BigFloat(0.5))
+        {
+            // reflection formula
+            const BigFloat one(1);
+            return Pi()/(sin(Pi()*a)*gamma(one - a));
+        }
+        // Gamma(a) ~ t^a e^-t sum(t^k/(a(a+1)...(a+k))) : the lower
+        // incomplete gamma function, with a t past the precision
+        const double x = a.ToDouble();
+        const double precision_bits = 0.69314718055994530942*Bits();
+        const BigFloat t(std::ceil(precision_bits + x + x*std::log(precision_bits)));
+        BigFloat term = BigFloat(1)/a, sum = term;
+        for (uint32_t k = 1; ; ++k)
+        {
+            term = term*t/(a + BigFloat(k));
+            if (Negligible(term, sum) && BigFloat(k) > t)
+            {
+                break;
+            }
+            sum += term;
+        }
+        return exp(a*log(t) - t)*sum;
+    }
+
+    // n! for the integers up to 100000, Gamma(n+1) otherwise
+    static BigFloat fact(const BigFloat& n)
+    {
+        if (n.IsInteger() && !n.neg_ && n.ToDouble() <= 100000)
+        {
+            BigFloat r(1);
+            for (uint32_t k = 2, last = uint32_t(n.ToDouble()); k <= last; ++k)
+            {
+                r *= BigFloat(k);
+            }
+            return r;
+        }
+        return gamma(n + BigFloat(1));
+    }
+
+    // [+-]digits[.digits][(e|E)[+-]digits], false with end == begin when no
+    // number starts at begin
+    static bool parse(BigFloat& num, const char* begin, char* &end)
+    {
+        const char* p = begin;
+        bool negative = false;
+        if (*p == '+' || *p == '-')
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+        // digits in chunks of 9, the ones past the precision only count in
+        // the exponent
+        const BigFloat billion(1e9);
+        BigFloat mantissa;
+        uint32_t chunk = 0, chunk_scale = 1;
+        int64_t exponent = 0, digits = 0;
+        bool any_digit = false;
+        auto digit = [&](char c, bool fraction) {
+            any_digit = true;
+            if (digits > int64_t(Digits) + 20)
+            {
+                exponent += fraction ? 0 : 1;
+                return;
+            }
+            exponent -= fraction ? 1 : 0;
+            digits += (digits != 0 || c != '0') ? 1 : 0;
+            chunk = chunk*10 + uint32_t(c-'0');
+            chunk_scale *= 10;
+            if (chunk_scale == 1000000000u)
+            {
+                mantissa = mantissa*billion + BigFloat(chunk);
+                chunk = 0;
+                chunk_scale = 1;
+            }
+        };
+        for (; *p >= '0' && *p <= '9'; ++p)
+        {
+            digit(*p, false);
+        }
+        if (*p == '.')
+        {
+            for (++p; *p >= '0' && *p <= '9'; ++p)
+            {
+                digit(*p, true);
+            }
+        }
+        if (!any_digit)
+        {
+            end = const_cast<char*>(begin);
+            return false;
+        }
+        mantissa = mantissa*BigFloat(chunk_scale) + BigFloat(chunk);
+        if (*p == 'e' || *p == 'E')
+        {
+            const char* e = p+1;
+            bool negative_exponent = false;
+            if (*e == '+' || *e == '-')
+            {
+                negative_exponent = (*e == '-');
+                ++e;
+            }
+            if (*e >= '0' && *e <= '9')
+            {
+                int64_t value = 0;
+                for (; *e >= '0' && *e <= '9'; ++e)
+                {
+                    value = std::min<int64_t>(value*10 + (*e-'0'), int64_t(1) << 40);
+                }
+                exponent += negative_exponent ? -value : value;
+                p = e;
+            }
+        }
+        num = mantissa*PowerOfTen(exponent);
+        if (negative)
+        {
+            num = -num;
+        }
+        end = const_cast<char*>(p);
+        return true;
+    }
+
+    // As printf "%.<prec>g" would, first if [first, last) is too small
+    static char* format(char* first, char* last, const BigFloat& a, int prec = precision)
+    {
+        std::string s;
+        if (a.IsNaN())
+        {
+            s = a.neg_ ? "-nan" : "nan";
+        }
+        else if (a.IsInf())
+        {
+            s = a.neg_ ? "-inf" : "inf";
+        }
+        else if (a.IsZero())
+        {
+            s = "0";
+        }
+        else
+        {
+            s = FormatFinite(a, std::max(prec, 1));
+        }
+        if (size_t(last-first) < s.size())
+        {
+            return first;
+        }
+        return std::copy(s.begin(), s.end(), first);
+    }
+
+    static std::string toString(const BigFloat& a)
+    {
+        char buffer[buffer_size];
+        return std::string(buffer, format(buffer, buffer+sizeof(buffer), a));
+    }
+
+private:
+    enum Kind : uint8_t {Finite, Infinite, NotANumber};
+
+    static int64_t Bits() {return 32*int64_t(limbs);}
+
+    static BigFloat Special(Kind kind, bool neg)
+    {
+        BigFloat r;
+        r.kind_ = kind;
+        r.neg_ = neg;
+        return r;
+    }
+
+    // Lowest nonzero limb of a nonzero mantissa
+    size_t Low() const
+    {
+        size_t i = 0;
+        while (m_[i] == 0)
+        {
+            ++i;
+        }
+        return i;
+    }
+
+    // 0.w[n-1]...w[0] * 2^(32*e) rounded to the nearest on the first
+    // dropped limb
+    static BigFloat Round(bool neg, int64_t e, const uint32_t* w, size_t n)
+    {
+        while (n > 0 && w[n-1] == 0)
+        {
+            --n;
+            --e;
+        }
+        BigFloat r;
+        if (n == 0)
+        {
+            return r;
+        }
+        r.neg_ = neg;
+        if (n <= limbs)
+        {
+            std::copy(w, w+n, r.m_+limbs-n);
+        }
+        else
+        {
+            std::copy(w+n-limbs, w+n, r.m_);
+            if (w[n-limbs-1] >= 0x80000000u)
+            {
+                size_t i = 0;
+                while (i < limbs && ++r.m_[i] == 0)
+                {
+                    ++i;
+                }
+                if (i == limbs)
+                {
+                    r.m_[limbs-1] = 1;
+                    ++e;
+                }
+            }
+        }
+        r.exp_ = int32_t(e);
+        return r;
+    }
+
+    static int CompareMagnitudes(const BigFloat& a, const BigFloat& b)
+    {
+        if (a.IsZero() || b.IsZero())
+        {
+            return int(b.IsZero()) - int(a.IsZero());
+        }
+        if (a.exp_ != b.exp_)
+        {
+            return a.exp_ < b.exp_ ? -1 : 1;
+        }
+        for (size_t i = limbs; i-- > 0; )
+        {
+            if (a.m_[i] != b.m_[i])
+            {
+                return a.m_[i] < b.m_[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    // -1, 0, 1, or 2 when unordered (NaN)
+    static int Compare(const BigFloat& a, const BigFloat& b)
+    {
+        if (a.IsNaN() || b.IsNaN())
+        {
+            return 2;
+        }
+        const int sa = a.IsZero() ? 0 : (a.neg_ ? -1 : 1);
+        const int sb = b.IsZero() ? 0 : (b.neg_ ? -1 : 1);
+        if (sa != sb)
+        {
+            return sa < sb ? -1 : 1;
+        }
+        int c;
+        if (a.IsInf() || b.IsInf())
+        {
+            c = int(a.IsInf()) - int(b.IsInf());
+        }
+        else
+        {
+            c = CompareMagnitudes(a, b);
+        }
+        return sa < 0 ? -c : c;
+    }
+
+    // |a|+|b| with a.exp_ >= b.exp_
+    static BigFloat AddMagnitudes(const BigFloat& a, const BigFloat& b, bool neg)
+    {
+        const size_t d = size_t(a.exp_ - b.exp_);
+        if (d > limbs)
+        {
+            BigFloat r = a;
+            r.neg_ = neg;
+            return r;
+        }
+        uint32_t w[2*limbs+2];
+        const size_t n = limbs+d+1;
+        uint64_t carry = 0;
+        for (size_t i = 0; i+1 < n; ++i)
+        {
+            uint64_t s = carry;
+            s += i >= d ? a.m_[i-d] : 0;
+            s += i < limbs ? b.m_[i] : 0;
+            w[i] = uint32_t(s);
+            carry = s >> 32;
+        }
+        w[n-1] = uint32_t(carry);
+        return Round(neg, int64_t(a.exp_) + 1, w, n);
+    }
+
+    // |a|-|b| with |a| > |b|
+    static BigFloat SubtractMagnitudes(const BigFloat& a, const BigFloat& b, bool neg)
+    {
+        const size_t d = size_t(a.exp_ - b.exp_);
+        if (d > limbs)
+        {
+            BigFloat r = a;
+            r.neg_ = neg;
+            return r;
+        }
+        uint32_t w[2*limbs+2];
+        const size_t n = limbs+d;
+        int64_t borrow = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            int64_t s = int64_t(i >= d ? a.m_[i-d] : 0) - int64_t(i < limbs ? b.m_[i] : 0) - borrow;
+            borrow = s < 0 ? 1 : 0;
+            w[i] = uint32_t(s + (borrow << 32));
+        }
+        return Round(neg, a.exp_, w, n);
+    }
+
+    // q = u/v, u of m limbs, v of n >= 2 limbs (Knuth's algorithm D)
+    static void Divide(uint32_t* q, const uint32_t* u, size_t m, const uint32_t* v, size_t n)
+    {
+        const uint64_t base = uint64_t(1) << 32;
+        int s = 0;
+        while (!(v[n-1] & (0x80000000u >> s)))
+        {
+            ++s;
+        }
+        uint32_t vn[limbs], un[2*limbs+2];
+        for (size_t i = n-1; i > 0; --i)
+        {
+            vn[i] = (v[i] << s) | (s ? v[i-1] >> (32-s) : 0);
+        }
+        vn[0] = v[0] << s;
+        un[m] = s ? u[m-1] >> (32-s) : 0;
+        for (size_t i = m-1; i > 0; --i)
+        {
+            un[i] = (u[i] << s) | (s ? u[i-1] >> (32-s) : 0);
+        }
+        un[0] = u[0] << s;
+        for (size_t j = m-n+1; j-- > 0; )
+        {
+            const uint64_t numerator = (uint64_t(un[j+n]) << 32) | un[j+n-1];
+            uint64_t qhat = numerator/vn[n-1];
+            uint64_t rhat = numerator - qhat*vn[n-1];
+            while (qhat >= base || qhat*vn[n-2] > ((rhat << 32) | un[j+n-2]))
+            {
+                --qhat;
+                rhat += vn[n-1];
+                if (rhat >= base)
+                {
+                    break;
+                }
+            }
+            int64_t borrow = 0, t;
+            for (size_t i = 0; i < n; ++i)
+            {
+                const uint64_t p = qhat*vn[i];
+                t = int64_t(un[i+j]) - borrow - int64_t(p & 0xFFFFFFFFu);
+                un[i+j] = uint32_t(t);
+                borrow = int64_t(p >> 32) - (t >> 32);
+            }
+            t = int64_t(un[j+n]) - borrow;
+            un[j+n] = uint32_t(t);
+            q[j] = uint32_t(qhat);
+            if (t < 0)
+            {
+                // qhat was one too large : add v back
+                --q[j];
+                uint64_t carry = 0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    const uint64_t sum = uint64_t(un[i+j]) + vn[i] + carry;
+                    un[i+j] = uint32_t(sum);
+                    carry = sum >> 32;
+                }
+                un[j+n] += uint32_t(carry);
+            }
+        }
+    }
+
+    // term below the precision of sum
+    static bool Negligible(const BigFloat& term, const BigFloat& sum)
+    {
+        return term.IsZero() || (!sum.IsZero() && int64_t(term.exp_) < int64_t(sum.exp_) - int64_t(limbs));
+    }
+
+    // atan(1/n) = sum((-1)^k/((2k+1) n^(2k+1)))
+    static BigFloat AtanInverse(uint32_t n)
+    {
+        const BigFloat n2(double(n)*n);
+        BigFloat power = BigFloat(1)/BigFloat(n), sum = power;
+        for (uint32_t k = 3; ; k += 2)
+        {
+            power = -(power/n2);
+            const BigFloat term = power/BigFloat(k);
+            if (Negligible(term, sum))
+            {
+                break;
+            }
+            sum += term;
+        }
+        return sum;
+    }
+
+    static void SinCos(const BigFloat& a, BigFloat& s, BigFloat& c)
+    {
+        if (a.kind_ != Finite)
+        {
+            s = c = Special(NotANumber, false);
+            return;
+        }
+        // a = k*pi/2 + r, |r| <= pi/4, then r/2^8 and the double angles
+        const BigFloat half_pi = Ldexp(Pi(), -1);
+        const double k = std::floor(a.ToDouble()/1.57079632679489661923 + 0.5);
+        const int doublings = 8;
+        const BigFloat r = Ldexp(a - BigFloat(k)*half_pi, -doublings);
+        BigFloat term = r;
+        s = r;
+        c = BigFloat(1);
+        for (uint32_t n = 2; ; ++n)
+        {
+            term = term*r/BigFloat(n);
+            if (n % 4 == 0 || n % 4 == 1)
+            {
+                (n % 2 ? s : c) += term;
+            }
+            else
+            {
+                (n % 2 ? s : c) -= term;
+            }
+            if (Negligible(term, s))
+            {
+                break;
+            }
+        }
+        for (int i = 0; i < doublings; ++i)
+        {
+            const BigFloat s2 = Ldexp(s*c, 1);
+            c = BigFloat(1) - Ldexp(s*s, 1);
+            s = s2;
+        }
+        switch (int64_t(k - 4*std::floor(k/4)))
+        {
+        case 1: std::swap(s, c); c = -c; break;
+        case 2: s = -s; c = -c; break;
+        case 3: std::swap(s, c); s = -s; break;
+        default: break;
+        }
+    }
+
+    static BigFloat PowerOfTen(int64_t e)
+    {
+        const BigFloat power = pow(BigFloat(10), BigFloat(double(e < 0 ? -e : e)));
+        return e < 0 ? BigFloat(1)/power : power;
+    }
+
+    static std::string FormatFinite(const BigFloat& a, int prec)
+    {
+        // a = y*10^e10 with 1 <= y < 10
+        BigFloat y = abs(a);
+        BigFloat x = y;
+        x.exp_ = 0;
+        int64_t e10 = int64_t(std::floor(std::log10(x.ToDouble()) + 32.0*y.exp_*0.30102999566398119521));
+        y = e10 > 0 ? y/PowerOfTen(e10) : y*PowerOfTen(-e10);
+        // the estimate is off by one at most, but a scaled value just below
+        // 1 may round to 10 : scale until 1 <= y < 10
+        const BigFloat ten(10), one(1);
+        while (y >= ten || y < one)
+        {
+            if (y >= ten)
+            {
+                y = y/ten;
+                ++e10;
+            }
+            else
+            {
+                y = y*ten;
+                --e10;
+            }
+        }
+        // prec digits and the rounding one
+        std::string digits(size_t(prec)+1, '0');
+        for (char& d : digits)
+        {
+            const BigFloat f = Floor(y);
+            const int digit = int(f.ToDouble());
+            if (digit < 0 || digit > 9)
+            {
+                throw std::logic_error("BigFloat::format : digit out of range");
+            }
+            d = char('0' + digit);
+            y = (y - f)*ten;
+        }
+        const bool up = digits.back() >= '5';
+        digits.pop_back();
+        if (up)
+        {
+            size_t i = digits.size();
+            while (i > 0 && digits[i-1] == '9')
+            {
+                digits[--i] = '0';
+            }
+            if (i == 0)
+            {
+                digits.insert(digits.begin(), '1');
+                digits.pop_back();
+                ++e10;
+            }
+            else
+            {
+                ++digits[i-1];
+            }
+        }
+        std::string s = a.neg_ ? "-" : "";
+        if (e10 < -4 || e10 >= prec)
+        {
+            // d.ddde+XX
+            s += digits[0];
+            std::string fraction = digits.substr(1);
+            fraction.erase(fraction.find_last_not_of('0')+1);
+            if (!fraction.empty())
+            {
+                s += '.' + fraction;
+            }
+            std::string exponent = std::to_string(e10 < 0 ? -e10 : e10);
+            if (exponent.size() < 2)
+            {
+                exponent = '0' + exponent;
+            }
+            s += (e10 < 0 ? "e-" : "e+") + exponent;
+        }
+        else
+        {
+            std::string fixed;
+            if (e10 >= 0)
+            {
+                fixed = digits.substr(0, size_t(e10)+1) + '.' + digits.substr(size_t(e10)+1);
+            }
+            else
+            {
+                fixed = "0." + std::string(size_t(-e10-1), '0') + digits;
+            }
+            fixed.erase(fixed.find_last_not_of('0')+1);
+            if (fixed.back() == '.')
+            {
+                fixed.pop_back();
+            }
+            s += fixed;
+        }
+        return s;
+    }
+
+    // value : 0.m_[limbs-1]...m_[0] * 2^(32*exp_), m_[limbs-1] != 0 unless 0
+    uint32_t m_[limbs];
+    int32_t exp_;
+    bool neg_;
+    Kind kind_;
+};
+
+/* Free functions, found by argument dependent lookup from std::complex */
+template <unsigned D> BigFloat<D> abs(const BigFloat<D>& a) {return BigFloat<D>::abs(a);}
+template <unsigned D> BigFloat<D> sqrt(const BigFloat<D>& a) {return BigFloat<D>::sqrt(a);}
+template <unsigned D> BigFloat<D> exp(const BigFloat<D>& a) {return BigFloat<D>::exp(a);}
+template <unsigned D> BigFloat<D> log(const BigFloat<D>& a) {return BigFloat<D>::log(a);}
+template <unsigned D> BigFloat<D> pow(const BigFloat<D>& a, const BigFloat<D>& b) {return BigFloat<D>::pow(a, b);}
+template <unsigned D> BigFloat<D> sin(const BigFloat<D>& a) {return BigFloat<D>::sin(a);}
+template <unsigned D> BigFloat<D> cos(const BigFloat<D>& a) {return BigFloat<D>::cos(a);}
+template <unsigned D> BigFloat<D> tan(const BigFloat<D>& a) {return BigFloat<D>::tan(a);}
+template <unsigned D> BigFloat<D> atan(const BigFloat<D>& a) {return BigFloat<D>::atan(a);}
+template <unsigned D> BigFloat<D> atan2(const BigFloat<D>& y, const BigFloat<D>& x) {return BigFloat<D>::atan2(y, x);}
+template <unsigned D> BigFloat<D> sinh(const BigFloat<D>& a) {return BigFloat<D>::sinh(a);}
+template <unsigned D> BigFloat<D> cosh(const BigFloat<D>& a) {return BigFloat<D>::cosh(a);}
+template <unsigned D> BigFloat<D> tanh(const BigFloat<D>& a) {return BigFloat<D>::tanh(a);}
+
+template <unsigned D>
+std::ostream& operator<<(std::ostream& os, const BigFloat<D>& a)
+{
+    return os << BigFloat<D>::toString(a);
+}
+
+#endif // H_BIGFLOAT
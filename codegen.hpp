@@ -0,0 +1,232 @@
+#ifndef H_CODEGEN
+#define H_CODEGEN
+
+#include <cmath>
+#include <complex>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "expression.hpp"
+#include "expression_visitor.hpp"
+#include "number_format.hpp"
+
+/**
+ ***************************************
+ * C++ code generation for scalar expressions.
+ *
+ * CodeGenVisitor folds an expression into a C++ expression on a scalar
+ * type S (the name given to the constructor). Every node is translated
+ * as the interpreter evaluates it on 1x1 matrices, operand order
+ * included, so the generated code computes the same bits :
+ *   a*b  -> b*a                       (Matrix::mul scales b by a)
+ *   a/b  -> a/b                       (right_divide)
+ *   a\b  -> b/a                       (left_divide)
+ *   a^b  -> numeric_interface<S>::pow(a, b)
+ *   !a   -> S(numeric_interface<S>::fact(a))
+ * The references and the function calls are resolved by the caller
+ * (parameters, other generated functions, native functions...), the index
+ * of f(...)_(k) is given to the call resolver as an int expression.
+ * Matrices, definitions and sequences throw CodeGenUnsupported.
+ ***************************************
+ */
+
+struct CodeGenUnsupported : public std::runtime_error
+{
+    explicit CodeGenUnsupported(const std::string& what) : std::runtime_error(what) {}
+};
+
+// C++ expression of a literal of type S
+inline std::string codegen_literal(const std::string& scalar, double re, double im)
+{
+    if(!std::isfinite(re) || !std::isfinite(im)) {
+        throw CodeGenUnsupported("non finite literal");
+    }
+    char buffer[number_buffer_size];
+    // 17 significant digits : the compiler reads back the same double
+    std::string r(buffer, format_number(buffer, buffer+sizeof(buffer), re, 17));
+    if(im == 0) {
+        return scalar + "(" + r + ")";
+    }
+    std::string i(buffer, format_number(buffer, buffer+sizeof(buffer), im, 17));
+    return "inkamath_complex<" + scalar + ">(" + r + ", " + i + ")";
+}
+
+inline std::string codegen_literal(const std::string& scalar, double a)
+{
+    return codegen_literal(scalar, a, 0);
+}
+
+inline std::string codegen_literal(const std::string& scalar, const std::complex<double>& a)
+{
+    return codegen_literal(scalar, a.real(), a.imag());
+}
+
+template <typename V>
+std::string codegen_literal(const std::string&, const V&)
+{
+    throw CodeGenUnsupported("literal type");
+}
+
+// Helpers used by the generated code, to emit once before it
+inline std::string codegen_prelude()
+{
+    return
+        "#include <complex>\n"
+        "#include <type_traits>\n"
+        "#include \"numeric_interface.hpp\"\n"
+        "\n"
+        "#ifndef INKAMATH_COMPLEX_LITERAL\n"
+        "#define INKAMATH_COMPLEX_LITERAL\n"
+        "template <typename S>\n"
+        "struct inkamath_complex_imp {\n"
+        "    static S make(double re, double) {return S(re);}\n"
+        "};\n"
+        "template <typename R>\n"
+        "struct inkamath_complex_imp<std::complex<R>> {\n"
+        "    static std::complex<R> make(double re, double im) {return std::complex<R>(R(re), R(im));}\n"
+        "};\n"
+        "template <typename S>\n"
+        "inline S inkamath_complex(double re, double im) {return inkamath_complex_imp<S>::make(re, im);}\n"
+        "#endif\n";
+}
+
+// Natives functions of native_functions.hpp as C++ on S, empty if unknown
+inline std::string codegen_native(const std::string& scalar, const std::string& name, const std::string& arg)
+{
+    static const char* same[] = {"exp", "log", "sin", "cos", "tan", "asin", "acos", "atan",
+                                 "sinh", "cosh", "tanh", "conj", "gamma"};
+    const std::string ni = "numeric_interface<" + scalar + ">::";
+    for(const char* f : same) {
+        if(name == f) return ni + name + "(" + arg + ")";
+    }
+    if(name == "ln") return ni + "log(" + arg + ")";
+    if(name == "sqrt" || name == "abs") return scalar + "(" + ni + name + "(" + arg + "))";
+    return std::string();
+}
+
+template <typename T>
+class CodeGenVisitor : public FoldingVisitor<T> {
+public:
+    // C++ expression of a reference
+    typedef std::function<std::string(const std::string& name)> ref_resolver;
+    // C++ expression of a call with the C++ expressions of its arguments
+    // and of its index (empty when the call is not indexed)
+    typedef std::function<std::string(const std::string& name, const std::vector<std::string>& args,
+                                      const std::string& index)> call_resolver;
+
+    CodeGenVisitor(const std::string& scalar, ref_resolver refs, call_resolver calls)
+        : scalar_(scalar), refs_(refs), calls_(calls)
+    {}
+
+    std::string Generate(const PExpression<T>& expr) {
+        code_.clear();
+        expr->accept(*this);
+        return Pop();
+    }
+
+    virtual T visit(EqualExpression<T>*) {
+        throw CodeGenUnsupported("definition");
+    }
+
+    virtual T visit(AddExpression<T>* expr) {
+        std::string a = Code(expr->m_e1()), b = Code(expr->m_e2());
+        return Push("(" + a + " + " + b + ")");
+    }
+
+    virtual T visit(NegExpression<T>* expr) {
+        return Push("(-" + Code(expr->m_e()) + ")");
+    }
+
+    virtual T visit(MultExpression<T>* expr) {
+        std::string a = Code(expr->m_e1()), b = Code(expr->m_e2());
+        return Push("(" + b + " * " + a + ")");
+    }
+
+    virtual T visit(DivExpression<T>* expr) {
+        std::string a = Code(expr->m_e1()), b = Code(expr->m_e2());
+        return Push("(" + a + " / " + b + ")");
+    }
+
+    virtual T visit(LeftDivExpression<T>* expr) {
+        std::string a = Code(expr->m_e1()), b = Code(expr->m_e2());
+        return Push("(" + b + " / " + a + ")");
+    }
+
+    virtual T visit(PowExpression<T>* expr) {
+        std::string a = Code(expr->m_e1()), b = Code(expr->m_e2());
+        return Push("numeric_interface<" + scalar_ + ">::pow(" + a + ", " + b + ")");
+    }
+
+    virtual T visit(FactExpression<T>* expr) {
+        return Push(scalar_ + "(numeric_interface<" + scalar_ + ">::fact(" + Code(expr->m_e()) + "))");
+    }
+
+    virtual T visit(ValExpression<T>* expr) {
+        if(expr->value.Size() != std::make_pair(size_t(1), size_t(1))) {
+            throw CodeGenUnsupported("matrix literal");
+        }
+        return Push(codegen_literal(scalar_, expr->value(1,1)));
+    }
+
+    virtual T visit(MatExpression<T>* expr) {
+        // parenthesis
+        if(expr->Size() != std::make_pair(size_t(1), size_t(1))) {
+            throw CodeGenUnsupported("matrix");
+        }
+        return Push(Code(expr->children[0]));
+    }
+
+    virtual T visit(RefExpression<T>* expr) {
+        return Push(refs_(expr->Name()));
+    }
+
+    virtual T visit(FuncExpression<T>* expr) {
+        ParametersCall<T> params(expr->m_e1(), PExpression<T>());
+        if(!params.parameters_dict().empty()) {
+            throw CodeGenUnsupported("keyword argument");
+        }
+        std::vector<std::string> args;
+        for(const auto& arg : params.parameters_expression()) {
+            args.push_back(Code(arg));
+        }
+        std::string index;
+        if(expr->m_e2()) {
+            index = "numeric_interface<" + scalar_ + ">::toInt(" + Code(expr->m_e2()) + ")";
+        }
+        return Push(calls_(expr->Name(), args, index));
+    }
+
+    virtual T visit(RecursivePlaceholderExpression<T>*) {
+        throw CodeGenUnsupported("sequence");
+    }
+
+    virtual T visit(RecursiveExpression<T>*) {
+        throw CodeGenUnsupported("sequence");
+    }
+
+protected:
+    std::string Code(const PExpression<T>& expr) {
+        expr->accept(*this);
+        return Pop();
+    }
+
+    T Push(const std::string& code) {
+        code_.push_back(code);
+        return T();
+    }
+
+    std::string Pop() {
+        std::string code = code_.back();
+        code_.pop_back();
+        return code;
+    }
+
+    std::string scalar_;
+    ref_resolver refs_;
+    call_resolver calls_;
+    std::vector<std::string> code_;
+};
+
+#endif // H_CODEGEN
@@ -0,0 +1,488 @@
+#ifndef H_CPP_EXPORT
+#define H_CPP_EXPORT
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "codegen.hpp"
+#include "reference_stack.hpp"
+#include "summation.hpp"
+
+/**
+ ***************************************
+ * Export of the definitions as a C++ header.
+ *
+ * Every definition of a ReferenceStack is translated by CodeGenVisitor to
+ * inline function templates on the scalar type S, in a namespace :
+ *   f(x,y=2)=...        S f(S x, S y) and S f(S x) giving y its default
+ *   u_0=..., u_n=...    S u_at(int n, ...) : term n, computed as
+ *                       Reference does, the terms in increasing order, the
+ *                       last ones kept for u_(n-1)... u_(n-k)
+ *                       S u(...) : limit of the terms, same stopping rule
+ *                       as the interpreter (|u_k - u_(k-1)| <= 1e-10 or
+ *                       30 terms after the last indexed one)
+ *   u_n=u_(n-1)+g       the same, as compensated sums of g (summation.hpp)
+ *   a=...               S a()
+ * The generated code computes the interpreter results on 1x1 matrices (an
+ * optimizing compiler may fold pow(x, 2) into x*x, one bit away), but the
+ * names are resolved lexically : a name which is not a parameter
+ * is the global definition, never a parameter of a calling function.
+ * Matrices, sequences u_(2n+1)=..., definitions using an undefined name,
+ * a native function without C++ translation or a definition which is not
+ * exported are listed as comments at the top of the header and skipped.
+ *
+ * The header includes numeric_interface.hpp : the directory of inkamath
+ * is to be in the include path of the program using it.
+ ***************************************
+ */
+
+template <typename T>
+class CppExport
+{
+public:
+    // Header text of the definitions of the stack, in namespace space
+    static std::string Generate(ReferenceStack<T>& stack, const std::string& space) {
+        CppExport<T> exporter;
+        exporter.Collect(stack);
+        exporter.Resolve();
+        return exporter.Text(space);
+    }
+
+    static void Save(ReferenceStack<T>& stack, const std::string& path, const std::string& space) {
+        std::string text = Generate(stack, space);
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if(!file) throw std::runtime_error("Failed to open " + path + ".\n");
+        file.write(text.data(), text.size());
+        if(!file) throw std::runtime_error("Failed to write " + path + ".\n");
+    }
+
+private:
+    struct Definition {
+        Definition() : value(false), at(false), required(0) {}
+
+        std::string id;
+        Reference<T> reference;
+        bool value; // id(...) : simple expression or limit of the sequence
+        bool at;    // id_at(n, ...) : term n
+        std::vector<std::string> value_params, at_params;
+        std::vector<PExpression<T>> defaults; // of the trailing value parameters
+        size_t required;
+        std::string declarations, definitions;
+    };
+
+    // Names visible in a generated function
+    struct Scope {
+        std::vector<std::string> names; // parameters of the definition
+        std::vector<std::string> ids;   // matching parameters of the function
+        std::string index;              // index of a general term
+
+        int Find(const std::string& name) const {
+            for(size_t i = 0; i < names.size(); ++i) {
+                if(names[i] == name) return int(i);
+            }
+            return -1;
+        }
+    };
+
+    // Code of a term : the recursive references read the kept terms t_
+    class TermGenerator : public CodeGenVisitor<T> {
+    public:
+        TermGenerator(CppExport<T>& exporter, const Scope& scope, bool term)
+            : CodeGenVisitor<T>("S",
+                  [&exporter, &scope](const std::string& name) {return exporter.ResolveReference(scope, name);},
+                  [&exporter, &scope](const std::string& name, const std::vector<std::string>& args, const std::string& index) {
+                      return exporter.ResolveCall(scope, name, args, index);
+                  }),
+              scope_(scope), term_(term), lag_(0)
+        {}
+
+        int Lag() const {
+            return lag_;
+        }
+
+        virtual T visit(RecursivePlaceholderExpression<T>* expr) {
+            const ParametersCall<T>& call = expr->params();
+            if(!term_ || call.subexpr() || call.a() != 1 || call.index_name() != scope_.index || call.b() >= 0
+                    || call.parameters_names() != scope_.names || !call.parameters_dict().empty()) {
+                throw CodeGenUnsupported("recursive reference");
+            }
+            const int lag = -call.b();
+            lag_ = std::max(lag_, lag);
+            const std::string k = std::to_string(lag);
+            return this->Push("(k_ >= " + k + " ? t_[(k_ - " + k + ") % w_] : S(0))");
+        }
+
+        virtual T visit(RecursiveExpression<T>* expr) {
+            return this->Push(this->Code(expr->recursive_expr()));
+        }
+
+    private:
+        const Scope& scope_;
+        bool term_;
+        int lag_;
+    };
+
+    void Collect(ReferenceStack<T>& stack) {
+        std::vector<std::string> names;
+        for(auto it = stack.stack_.begin(); it != stack.stack_.end(); ++it) {
+            names.push_back(std::get<0>(*it));
+        }
+        std::sort(names.begin(), names.end());
+        names.erase(std::unique(names.begin(), names.end()), names.end());
+
+        for(const auto& name : names) {
+            names_.insert(name);
+            Definition definition;
+            stack.stack_.Get(name, definition.reference);
+            definition.id = Identifier(name);
+            try {
+                Shape(definition);
+                definitions_[name] = definition;
+            }
+            catch(const CodeGenUnsupported& e) {
+                skipped_[name] = e.what();
+            }
+        }
+    }
+
+    // Signatures of the generated functions
+    static void Shape(Definition& d) {
+        const Reference<T>& reference = d.reference;
+        if(std::get<1>(reference.general_expr_)) {
+            const ParametersDefinition<T>& params = std::get<0>(reference.general_expr_);
+            if(params.a() != 1 || params.b() != 0) {
+                throw CodeGenUnsupported("sequence not defined from its term n");
+            }
+            if(!params.parameters_dict().empty()) {
+                throw CodeGenUnsupported("default value of a sequence parameter");
+            }
+            d.value = d.at = true;
+            d.value_params = d.at_params = params.parameters_names();
+            d.required = d.value_params.size();
+        }
+        else {
+            if(std::get<1>(reference.single_expr_)) {
+                const ParametersDefinition<T>& params = std::get<0>(reference.single_expr_);
+                d.value = true;
+                d.value_params = params.parameters_names();
+                d.required = d.value_params.size();
+                while(d.required > 0 && params.parameters_dict().count(d.value_params[d.required-1])) {
+                    --d.required;
+                }
+                if(d.value_params.size() - d.required != params.parameters_dict().size()) {
+                    throw CodeGenUnsupported("default value before a positional parameter");
+                }
+                for(size_t i = d.required; i < d.value_params.size(); ++i) {
+                    d.defaults.push_back(params.parameters_dict().at(d.value_params[i]));
+                }
+            }
+            if(!reference.indexed_expr_.empty()) {
+                d.at = true;
+                d.at_params = std::get<0>(reference.indexed_expr_.begin()->second).parameters_names();
+                if(d.value && d.at_params.size() != d.value_params.size()) {
+                    throw CodeGenUnsupported("indexed and simple expressions of different arities");
+                }
+            }
+        }
+        for(const auto& indexed : reference.indexed_expr_) {
+            const ParametersDefinition<T>& params = std::get<0>(indexed.second);
+            if(!params.parameters_dict().empty()) {
+                throw CodeGenUnsupported("default value of a sequence parameter");
+            }
+            if(params.parameters_names().size() > d.at_params.size()) {
+                throw CodeGenUnsupported("indexed expressions of different arities");
+            }
+        }
+    }
+
+    // Generates the definitions until none refers to a skipped one
+    void Resolve() {
+        bool changed = true;
+        while(changed) {
+            changed = false;
+            for(auto it = definitions_.begin(); it != definitions_.end(); ) {
+                try {
+                    Emit(it->second);
+                    ++it;
+                }
+                catch(const CodeGenUnsupported& e) {
+                    skipped_[it->first] = e.what();
+                    it = definitions_.erase(it);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::string ResolveReference(const Scope& scope, const std::string& name) {
+        int i = scope.Find(name);
+        if(i >= 0) {
+            return scope.ids[i];
+        }
+        if(!scope.index.empty() && name == scope.index) {
+            return "S(k_)";
+        }
+        auto it = definitions_.find(name);
+        if(it != definitions_.end() && it->second.value && it->second.required == 0) {
+            return it->second.id + "<S>()";
+        }
+        throw CodeGenUnsupported((names_.count(name) ? "reference " : "undefined reference ") + name);
+    }
+
+    std::string ResolveCall(const Scope& scope, const std::string& name, const std::vector<std::string>& args,
+                            const std::string& index) {
+        if(scope.Find(name) >= 0 || (!scope.index.empty() && name == scope.index)) {
+            throw CodeGenUnsupported("call of parameter " + name);
+        }
+        auto it = definitions_.find(name);
+        if(it != definitions_.end()) {
+            const Definition& d = it->second;
+            if(!index.empty() && d.at && args.size() == d.at_params.size()) {
+                std::vector<std::string> at_args(1, index);
+                at_args.insert(at_args.end(), args.begin(), args.end());
+                return AtName(d.id) + "<S>(" + Join(at_args) + ")";
+            }
+            // the index of a simple expression is ignored
+            if((index.empty() || !d.at) && d.value && args.size() >= d.required && args.size() <= d.value_params.size()) {
+                return d.id + "<S>(" + Join(args) + ")";
+            }
+        }
+        else if(!names_.count(name) && index.empty() && args.size() == 1) {
+            std::string native = codegen_native("S", name, args[0]);
+            if(!native.empty()) {
+                return native;
+            }
+        }
+        throw CodeGenUnsupported("call of " + name);
+    }
+
+    std::string Generate(const PExpression<T>& expr, const Scope& scope) {
+        TermGenerator generator(*this, scope, false);
+        return generator.Generate(expr);
+    }
+
+    void Emit(Definition& d) {
+        const Reference<T>& reference = d.reference;
+        d.declarations.clear();
+        d.definitions.clear();
+
+        std::vector<std::string> value_ids, at_ids;
+        for(const auto& name : d.value_params) value_ids.push_back(Identifier(name));
+        for(const auto& name : d.at_params) at_ids.push_back(Identifier(name));
+        std::vector<std::string> at_signature(1, "int n_");
+        for(const auto& id : at_ids) at_signature.push_back("S " + id);
+
+        if(std::get<1>(reference.general_expr_)) {
+            const ParametersDefinition<T>& params = std::get<0>(reference.general_expr_);
+            Scope scope;
+            scope.names = params.parameters_names();
+            scope.ids = at_ids;
+            scope.index = params.index_name();
+            if(reference.summand_) {
+                EmitSummation(d, scope, at_signature, value_ids);
+                return;
+            }
+
+            TermGenerator generator(*this, scope, true);
+            std::string general = generator.Generate(std::get<1>(reference.general_expr_));
+            const int w = generator.Lag() + 1;
+
+            std::string term = "    auto term_ = [&](int k_) -> S {\n";
+            for(const auto& indexed : reference.indexed_expr_) {
+                term += "        if(k_ == " + std::to_string(indexed.first) + ") return "
+                        + Generate(std::get<1>(indexed.second), IndexedScope(indexed.second, at_ids)) + ";\n";
+            }
+            term += "        return " + general + ";\n    };\n";
+            const std::string kept = w > 1 ? "    const int w_ = " + std::to_string(w) + ";\n    S t_[w_] = {};\n" : "";
+
+            AddFunction(d, AtName(d.id), at_signature,
+                        "    if(n_ < 0) return S(0);\n" + kept + term
+                        + (w > 1 ? "    for(int k_ = 0; k_ < n_; ++k_) t_[k_ % w_] = term_(k_);\n" : "")
+                        + "    return term_(n_);\n");
+
+            // limit : terms after the last indexed one
+            const bool start_indexed = !reference.indexed_expr_.empty();
+            const std::string start = std::to_string(start_indexed ? reference.indexed_expr_.rbegin()->first : 0);
+            std::string limit = kept + term;
+            if(w > 1) {
+                limit += "    for(int k_ = 0; k_ <= " + start + "; ++k_) t_[k_ % w_] = term_(k_);\n";
+            }
+            limit += "    int k_ = " + start + ";\n";
+            limit += "    S previous_ = " + (start_indexed ? (w > 1 ? "t_[k_ % w_]" : std::string("term_(k_)")) : std::string("S(0)")) + ";\n";
+            limit += "    S value_ = previous_;\n"
+                     "    auto diff_ = numeric_interface<S>::abs(S(1));\n"
+                     "    for(int iteration_ = 0; diff_ > 1e-10 && iteration_ < 30; ++iteration_) {\n"
+                     "        ++k_;\n"
+                     "        value_ = term_(k_);\n";
+            if(w > 1) {
+                limit += "        t_[k_ % w_] = value_;\n";
+            }
+            limit += "        diff_ = numeric_interface<S>::abs(value_ - previous_);\n"
+                     "        previous_ = value_;\n"
+                     "    }\n"
+                     "    return value_;\n";
+            AddFunction(d, d.id, Parameters(value_ids, value_ids.size()), limit);
+            return;
+        }
+
+        if(d.value) {
+            const ParametersDefinition<T>& params = std::get<0>(reference.single_expr_);
+            Scope scope;
+            scope.names = params.parameters_names();
+            scope.ids = value_ids;
+            AddFunction(d, d.id, Parameters(value_ids, value_ids.size()),
+                        "    return " + Generate(std::get<1>(reference.single_expr_), scope) + ";\n");
+            // the defaults are evaluated before binding the parameters
+            std::vector<std::string> defaults;
+            for(const auto& expr : d.defaults) {
+                defaults.push_back(Generate(expr, Scope()));
+            }
+            for(size_t arity = d.required; arity < value_ids.size(); ++arity) {
+                std::vector<std::string> args(value_ids.begin(), value_ids.begin() + arity);
+                args.insert(args.end(), defaults.begin() + (arity - d.required), defaults.end());
+                AddFunction(d, d.id, Parameters(value_ids, arity), "    return " + d.id + "<S>(" + Join(args) + ");\n");
+            }
+        }
+        if(d.at) {
+            std::string body;
+            for(const auto& indexed : reference.indexed_expr_) {
+                body += "    if(n_ == " + std::to_string(indexed.first) + ") return "
+                        + Generate(std::get<1>(indexed.second), IndexedScope(indexed.second, at_ids)) + ";\n";
+            }
+            body += "    return " + (d.value ? d.id + "<S>(" + Join(at_ids) + ")" : std::string("S(0)")) + ";\n";
+            AddFunction(d, AtName(d.id), at_signature, body);
+        }
+    }
+
+    // f_n=f_(n-1)+g : compensated sums of g, as Reference evaluates them
+    void EmitSummation(Definition& d, const Scope& scope, const std::vector<std::string>& at_signature,
+                       const std::vector<std::string>& value_ids) {
+        const Reference<T>& reference = d.reference;
+        const std::string summand = Generate(reference.summand_, scope);
+        const std::string add =
+                "        S x_ = " + summand + ";\n"
+                "        S t_ = sum_ + x_;\n"
+                "        summation_error<S>::Add(error_, sum_, x_, t_);\n"
+                "        sum_ = t_;\n";
+
+        // term n : the sum from the last indexed term before it
+        std::string at = "    if(n_ < 0) return S(0);\n";
+        for(const auto& indexed : reference.indexed_expr_) {
+            at += "    if(n_ == " + std::to_string(indexed.first) + ") return "
+                  + Generate(std::get<1>(indexed.second), IndexedScope(indexed.second, scope.ids)) + ";\n";
+        }
+        at += "    int k_ = -1;\n    S sum_ = S(0), error_ = S(0);\n";
+        std::string branch = "    ";
+        for(auto it = reference.indexed_expr_.rbegin(); it != reference.indexed_expr_.rend(); ++it) {
+            const std::string k = std::to_string(it->first);
+            at += branch + "if(n_ > " + k + ") {\n        k_ = " + k + ";\n        sum_ = "
+                  + Generate(std::get<1>(it->second), IndexedScope(it->second, scope.ids)) + ";\n    }\n";
+            branch = "    else ";
+        }
+        at += "    while(k_ < n_) {\n        ++k_;\n" + add + "    }\n    return sum_ + error_;\n";
+        AddFunction(d, AtName(d.id), at_signature, at);
+
+        // limit : the terms after the last indexed one
+        const bool start_indexed = !reference.indexed_expr_.empty();
+        const std::string start = std::to_string(start_indexed ? reference.indexed_expr_.rbegin()->first : 0);
+        std::vector<std::string> args(1, start);
+        args.insert(args.end(), value_ids.begin(), value_ids.end());
+        std::string limit = "    int k_ = " + start + ";\n"
+                "    S sum_ = " + AtName(d.id) + "<S>(" + Join(args) + "), error_ = S(0);\n"
+                "    S previous_ = " + (start_indexed ? "sum_" : "S(0)") + ";\n"
+                "    S value_ = previous_;\n"
+                "    auto diff_ = numeric_interface<S>::abs(S(1));\n"
+                "    for(int iteration_ = 0; diff_ > 1e-10 && iteration_ < 30; ++iteration_) {\n"
+                "        ++k_;\n" + add +
+                "        value_ = sum_ + error_;\n"
+                "        diff_ = numeric_interface<S>::abs(value_ - previous_);\n"
+                "        previous_ = value_;\n"
+                "    }\n"
+                "    return value_;\n";
+        AddFunction(d, d.id, Parameters(value_ids, value_ids.size()), limit);
+    }
+
+    static Scope IndexedScope(const ExpressionDefinition<T>& definition, const std::vector<std::string>& ids) {
+        Scope scope;
+        scope.names = std::get<0>(definition).parameters_names();
+        scope.ids.assign(ids.begin(), ids.begin() + scope.names.size());
+        return scope;
+    }
+
+    static void AddFunction(Definition& d, const std::string& id, const std::vector<std::string>& params, const std::string& body) {
+        d.declarations += "template <typename S> S " + id + "(" + Join(params) + ");\n";
+        d.definitions += "template <typename S>\ninline S " + id + "(" + Join(params) + ")\n{\n" + body + "}\n\n";
+    }
+
+    static std::vector<std::string> Parameters(const std::vector<std::string>& ids, size_t count) {
+        std::vector<std::string> params;
+        for(size_t i = 0; i < count; ++i) params.push_back("S " + ids[i]);
+        return params;
+    }
+
+    static std::string Join(const std::vector<std::string>& items) {
+        std::string s;
+        for(const auto& item : items) {
+            s += (s.empty() ? "" : ", ") + item;
+        }
+        return s;
+    }
+
+    // Names of the language which are C++ keywords get a trailing _
+    static std::string Identifier(const std::string& name) {
+        static const std::set<std::string> reserved = {
+            "S", "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool",
+            "break", "case", "catch", "char", "char16_t", "char32_t", "class", "compl", "const",
+            "constexpr", "const_cast", "continue", "decltype", "default", "delete", "do", "double",
+            "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float", "for",
+            "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+            "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public",
+            "register", "reinterpret_cast", "return", "short", "signed", "sizeof", "static",
+            "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local",
+            "throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+            "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq"
+        };
+        return reserved.count(name) ? name + "_" : name;
+    }
+
+    static std::string AtName(const std::string& id) {
+        return id + (id.back() == '_' ? "at" : "_at");
+    }
+
+    std::string Text(const std::string& space) const {
+        std::string guard = "H_";
+        for(char c : space) {
+            guard += std::isalnum(static_cast<unsigned char>(c)) ? char(std::toupper(static_cast<unsigned char>(c))) : '_';
+        }
+
+        std::string text = "// Definitions exported by inkamath : " + std::to_string(definitions_.size()) + " exported";
+        text += skipped_.empty() ? "\n" : ", " + std::to_string(skipped_.size()) + " skipped\n";
+        for(const auto& skipped : skipped_) {
+            text += "//   " + skipped.first + " : " + skipped.second + "\n";
+        }
+        text += "\n#ifndef " + guard + "\n#define " + guard + "\n\n" + codegen_prelude()
+                + "#include \"summation.hpp\"\n\n";
+        text += "namespace " + space + " {\n\n";
+        for(const auto& definition : definitions_) {
+            text += definition.second.declarations;
+        }
+        text += "\n";
+        for(const auto& definition : definitions_) {
+            text += definition.second.definitions;
+        }
+        text += "} // namespace " + space + "\n\n#endif // " + guard + "\n";
+        return text;
+    }
+
+    std::set<std::string> names_;
+    std::map<std::string, Definition> definitions_;
+    std::map<std::string, std::string> skipped_;
+};
+
+#endif // H_CPP_EXPORT
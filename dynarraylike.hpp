@@ -8,15 +8,40 @@
 #include <iterator>
 #include <limits>
 #include <stdexcept>
+#include <type_traits> // aligned_storage
+#include <new>
+
+#include "alloc_tracker.hpp"
 
 // waiting for C++14 or C++1y dynarrays
-// no magic here, just a fix runtime sized array on the heap
-// missing allocator support
+// no magic here, just a fix runtime sized array
+//
+// Allocator : the storage is obtained from an allocator assumed stateless
+// (allocators compare equal, they are not propagated on assignment).
+// InlineCapacity : arrays of at most InlineCapacity elements are stored
+// inside the object itself without allocation.
+// Elements are constructed in place from their source (copy, list, range)
+// and default-initialized otherwise, as new T[n] does.
+
+template <typename T, size_t N>
+struct dynarray_inline_storage {
+    // the buffer is left uninitialized
+    dynarray_inline_storage() {}
+    T* inline_data() {return reinterpret_cast<T*>(&storage_);}
+private:
+    typename std::aligned_storage<sizeof(T)*N, alignof(T)>::type storage_;
+};
 
 template <typename T>
-class dynarray {
+struct dynarray_inline_storage<T, 0> {
+    T* inline_data() {return nullptr;}
+};
+
+template <typename T, typename Allocator = std::allocator<T>, size_t InlineCapacity = 0>
+class dynarray : private Allocator, private dynarray_inline_storage<T, InlineCapacity> {
 public:
   using value_type = T;
+  using allocator_type = Allocator;
   using reference = T&;
   using const_reference = const T&;
 
@@ -29,61 +54,90 @@ public:
   using difference_type =  typename std::iterator_traits<iterator>::difference_type;
   using size_type = size_t;
 
-  dynarray() : size_(0), p() {}
+  static const size_type inline_capacity = InlineCapacity;
+
+  dynarray() : size_(0), p(nullptr) {}
 
-  explicit dynarray(size_type size) : size_(size), p(new value_type[size]) {}
+  explicit dynarray(size_type size) : size_(0), p(nullptr)
+  {
+      this->allocate(size);
+      this->construct_default();
+  }
 
-  dynarray(std::initializer_list<T> x)
-      : size_(x.size()), p(new value_type[x.size()])
+  dynarray(size_type size, const T& value) : size_(0), p(nullptr)
   {
-      std::move(x.begin(), x.end(), this->begin());
+      this->allocate(size);
+      this->construct_copy(size, [&value](size_type) -> const T& {return value;});
   }
 
+  template <typename InputIterator,
+            typename = typename std::iterator_traits<InputIterator>::iterator_category>
+  dynarray(InputIterator first, InputIterator last) : size_(0), p(nullptr)
+  {
+      this->allocate(std::distance(first, last));
+      this->construct_copy(size_, [&first](size_type) -> decltype(*first) {return *first++;});
+  }
+
+  dynarray(std::initializer_list<T> x) : dynarray(x.begin(), x.end())
+  {}
+
   dynarray& operator=(std::initializer_list<T> x)
   {
-      if(this->size_ != x.size()) {
-          this->p.reset(new value_type[x.size()]);
+      if(this->size_ == x.size()) {
+          std::copy(x.begin(), x.end(), this->begin());
+      }
+      else {
+          dynarray(x).swap(*this);
       }
-      this->size_ = x.size();
-      std::move(x.begin(), x.end(), this->begin());
       return *this;
   }
 
-  dynarray(dynarray&& x)
-      : size_(x.size_), p(std::move(x.p))
-  {}
+  dynarray(dynarray&& x) : size_(0), p(nullptr)
+  {
+      this->steal(x);
+  }
 
   dynarray& operator=(dynarray&& x)
   {
-      this->p = std::move(x.p);
-      this->size_ = x.size_;
+      if(this != &x) {
+          this->release();
+          this->steal(x);
+      }
       return *this;
   }
 
   dynarray(const dynarray& x)
-      : size_(x.size_), p(new value_type[x.size_])
+      : Allocator(x), dynarray_inline_storage<T, InlineCapacity>(), size_(0), p(nullptr)
   {
-      std::copy(x.cbegin(), x.cend(), this->begin());
+      this->allocate(x.size_);
+      const T* source = x.p;
+      this->construct_copy(x.size_, [source](size_type i) -> const T& {return source[i];});
   }
 
   dynarray& operator=(const dynarray& x)
   {
-      if(this->size_ != x.size_) {
-        this->p.reset(new value_type[x.size_]);
+      if(this->size_ == x.size_) {
+          std::copy(x.cbegin(), x.cend(), this->begin());
+      }
+      else {
+          dynarray(x).swap(*this);
       }
-      this->size_ = x.size_;
-      std::copy(x.cbegin(), x.cend(), this->begin());
       return *this;
   }
 
-  inline iterator begin() {return this->p.get();}
-  inline iterator end() {return this->p.get()+this->size_;}
+  ~dynarray()
+  {
+      this->release();
+  }
 
-  inline const_iterator begin() const {return this->p.get();}
-  inline const_iterator end() const {return this->p.get()+this->size_;}
+  inline iterator begin() {return this->p;}
+  inline iterator end() {return this->p+this->size_;}
 
-  inline const_iterator cbegin() const {return this->p.get();}
-  inline const_iterator cend() const {return this->p.get()+this->size_;}
+  inline const_iterator begin() const {return this->p;}
+  inline const_iterator end() const {return this->p+this->size_;}
+
+  inline const_iterator cbegin() const {return this->p;}
+  inline const_iterator cend() const {return this->p+this->size_;}
 
   inline reverse_iterator rbegin() {return reverse_iterator(end());}
   inline reverse_iterator rend() {return reverse_iterator(begin());}
@@ -94,15 +148,15 @@ public:
   inline const_reverse_iterator crbegin() const {return const_reverse_iterator(cend());}
   inline const_reverse_iterator crend() const {return const_reverse_iterator(cbegin());}
 
-  inline T& operator[](size_type pos) {return *(this->p.get()+pos);}
-  inline const T& operator[](size_type pos) const {return *(this->p.get()+pos);}
+  inline T& operator[](size_type pos) {return *(this->p+pos);}
+  inline const T& operator[](size_type pos) const {return *(this->p+pos);}
 
   T& at(size_type pos)
   {
        if (!(pos < size()))
            throw std::out_of_range("dynarray out of range.");
        else
-           return *(this->p.get()+pos);
+           return *(this->p+pos);
   }
 
   const T& at(size_type pos) const
@@ -110,21 +164,28 @@ public:
        if (!(pos < size()))
            throw std::out_of_range("dynarray out of range.");
        else
-          return *(this->p.get()+pos);
+          return *(this->p+pos);
   }
 
-  T& front() {return *(this->p.get());}
-  const T& front() const {return *(this->p.get());}
+  T& front() {return *(this->p);}
+  const T& front() const {return *(this->p);}
 
-  T& back() {return *(this->p.get()+this->size_-1);}
-  const T& back() const {return *(this->p.get()+this->size_-1);}
+  T& back() {return *(this->p+this->size_-1);}
+  const T& back() const {return *(this->p+this->size_-1);}
 
-  T* data() {return this->p.get();}
-  const T* data() const {return this->p.get();}
+  T* data() {return this->p;}
+  const T* data() const {return this->p;}
 
   void swap(dynarray& x) {
-      this->p.swap(x.p);
-      std::swap(this->size_, x.size_);
+      if(this->is_inline() || x.is_inline()) {
+          dynarray tmp(std::move(x));
+          x = std::move(*this);
+          *this = std::move(tmp);
+      }
+      else {
+          std::swap(this->p, x.p);
+          std::swap(this->size_, x.size_);
+      }
   }
 
   void fill( const T& value )
@@ -135,45 +196,131 @@ public:
   size_type size() const {return size_;}
   bool empty() const {return size_ == 0;}
 
+  // true when the elements are stored inside the object
+  bool is_inline() const {return this->p != nullptr && this->size_ <= InlineCapacity;}
+
+  allocator_type get_allocator() const {return *this;}
+
   constexpr static size_type max_size() {return std::numeric_limits<size_type>::max();}
 
 private:
+  typedef std::allocator_traits<Allocator> traits;
+
+  // storage for size elements, not constructed yet
+  void allocate(size_type size) {
+      if(size == 0) {
+          this->p = nullptr;
+      }
+      else if(size <= InlineCapacity) {
+          this->p = this->inline_data();
+      }
+      else {
+          AllocationTracker::Record(AllocDynarray, size*sizeof(value_type));
+          this->p = traits::allocate(*this, size);
+      }
+      this->size_ = size;
+  }
+
+  void deallocate() {
+      if(this->p && this->size_ > InlineCapacity) {
+          traits::deallocate(*this, this->p, this->size_);
+      }
+      this->p = nullptr;
+      this->size_ = 0;
+  }
+
+  void destroy(size_type count) {
+      while(count > 0) {
+          (this->p+(--count))->~T();
+      }
+  }
+
+  void release() {
+      this->destroy(this->size_);
+      this->deallocate();
+  }
+
+  void construct_default() {
+      size_type i = 0;
+      try {
+          for(; i < this->size_; ++i) {
+              ::new (static_cast<void*>(this->p+i)) T;
+          }
+      }
+      catch(...) {
+          this->destroy(i);
+          this->deallocate();
+          throw;
+      }
+  }
+
+  template <typename Source>
+  void construct_copy(size_type size, Source source) {
+      size_type i = 0;
+      try {
+          for(; i < size; ++i) {
+              ::new (static_cast<void*>(this->p+i)) T(source(i));
+          }
+      }
+      catch(...) {
+          this->destroy(i);
+          this->deallocate();
+          throw;
+      }
+  }
+
+  // takes the elements of x and leaves it empty, this is empty
+  void steal(dynarray& x) {
+      if(x.is_inline()) {
+          this->allocate(x.size_);
+          T* source = x.p;
+          this->construct_copy(x.size_, [source](size_type i) -> T&& {return std::move(source[i]);});
+          x.release();
+      }
+      else {
+          this->p = x.p;
+          this->size_ = x.size_;
+          x.p = nullptr;
+          x.size_ = 0;
+      }
+  }
+
   size_type size_;
-  std::unique_ptr<value_type[]> p;
+  T* p;
 };
 
-template <typename T>
-bool operator==(const dynarray<T>& a, const dynarray<T>& b) {
+template <typename T, typename A, size_t N>
+bool operator==(const dynarray<T, A, N>& a, const dynarray<T, A, N>& b) {
     return (a.size() == b.size()) && std::equal(a.cbegin(), a.cend(), b.cbegin());
 }
 
-template <typename T>
-bool operator!=(const dynarray<T>& a, const dynarray<T>& b) {
+template <typename T, typename A, size_t N>
+bool operator!=(const dynarray<T, A, N>& a, const dynarray<T, A, N>& b) {
     return !(a == b);
 }
 
-template <typename T>
-bool operator<(const dynarray<T>& a, const dynarray<T>& b) {
+template <typename T, typename A, size_t N>
+bool operator<(const dynarray<T, A, N>& a, const dynarray<T, A, N>& b) {
     return std::lexicographical_compare(a.cbegin(), a.cend(), b.cbegin(), b.cend());
 }
 
-template <typename T>
-bool operator>(const dynarray<T>& a, const dynarray<T>& b) {
+template <typename T, typename A, size_t N>
+bool operator>(const dynarray<T, A, N>& a, const dynarray<T, A, N>& b) {
     return b < a;
 }
 
-template <typename T>
-bool operator<=(const dynarray<T>& a, const dynarray<T>& b) {
+template <typename T, typename A, size_t N>
+bool operator<=(const dynarray<T, A, N>& a, const dynarray<T, A, N>& b) {
     return !(a > b);
 }
 
-template <typename T>
-bool operator>=(const dynarray<T>& a, const dynarray<T>& b) {
+template <typename T, typename A, size_t N>
+bool operator>=(const dynarray<T, A, N>& a, const dynarray<T, A, N>& b) {
     return !(a < b);
 }
 
-template <typename T>
-void swap(dynarray<T>& a, dynarray<T>& b) {
+template <typename T, typename A, size_t N>
+void swap(dynarray<T, A, N>& a, dynarray<T, A, N>& b) {
     a.swap(b);
 }
 
@@ -0,0 +1,99 @@
+#ifndef H_ELEMENTWISE
+#define H_ELEMENTWISE
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+#include "thread_pool.hpp"
+
+/**
+ ***************************************
+ * Loops of the elementwise matrix operations.
+ *
+ * Elementwise::For(size, f) calls f(begin, end) on consecutive ranges of
+ * [0, size) : the kernels loop on raw contiguous buffers, which the
+ * compiler vectorizes. From Threshold() elements the ranges are blocks
+ * taken in turn by at most Threads() tasks of the shared thread pool (see
+ * thread_pool.hpp), 0 meaning all of its threads. Smaller operations, and
+ * the ones of a pool task, are a single call on the calling thread.
+ * The kernels must not depend on the order of the ranges.
+ ***************************************
+ */
+
+class Elementwise
+{
+public:
+    static const size_t default_threshold = 1 << 16;
+
+    // blocks of a thread, for the load balancing
+    static const size_t blocks_per_thread = 4;
+    // smallest block, in elements, a multiple of a cache line
+    static const size_t min_block = 4096;
+
+    static size_t Threshold()
+    {
+        return threshold().load(std::memory_order_relaxed);
+    }
+
+    static void SetThreshold(size_t elements)
+    {
+        threshold().store(elements, std::memory_order_relaxed);
+    }
+
+    static size_t Threads()
+    {
+        return threads().load(std::memory_order_relaxed);
+    }
+
+    static void SetThreads(size_t count)
+    {
+        threads().store(count, std::memory_order_relaxed);
+    }
+
+    template <typename F>
+    static void For(size_t size, F f)
+    {
+        size_t count = 1;
+        if(size >= Threshold() && size > min_block && !ThreadPool::InTask())
+        {
+            count = ThreadPool::Shared().Concurrency();
+            if(Threads() != 0)
+            {
+                count = std::min(count, Threads());
+            }
+        }
+        if(count <= 1)
+        {
+            f(size_t(0), size);
+            return;
+        }
+        size_t blocks = std::min(count*blocks_per_thread, (size+min_block-1)/min_block);
+        size_t block = (size+blocks-1)/blocks;
+        block = (block+63)/64*64;
+        blocks = (size+block-1)/block;
+        // count tasks taking the next block in turn
+        std::atomic<size_t> next(0);
+        ThreadPool::Shared().ParallelFor(count, [&](size_t) {
+            for(size_t k; (k = next.fetch_add(1)) < blocks; )
+            {
+                f(k*block, std::min(size, (k+1)*block));
+            }
+        });
+    }
+
+private:
+    static std::atomic<size_t>& threshold()
+    {
+        static std::atomic<size_t> value(default_threshold);
+        return value;
+    }
+
+    static std::atomic<size_t>& threads()
+    {
+        static std::atomic<size_t> value(0);
+        return value;
+    }
+};
+
+#endif // H_ELEMENTWISE
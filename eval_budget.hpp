@@ -0,0 +1,187 @@
+#ifndef H_EVAL_BUDGET
+#define H_EVAL_BUDGET
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "alloc_tracker.hpp"
+
+// Limits of a single Interpreter::Eval call, 0 means unlimited.
+struct EvaluationLimits
+{
+    size_t max_nodes = 0;                    // evaluated expression nodes
+    std::chrono::milliseconds max_time{0};   // wall time
+    size_t max_depth = 0;                    // nested reference evaluations
+    size_t max_memory = 0;                   // tracked bytes allocated (all threads)
+};
+
+// Thrown when an evaluation is cancelled or exceeds its budget.
+class EvaluationInterrupted : public std::runtime_error
+{
+public:
+    explicit EvaluationInterrupted(const std::string& what)
+        : std::runtime_error(what)
+    {}
+};
+
+// Shared flag used to stop an evaluation running on another thread.
+// Copies of a token refer to the same flag.
+class CancelToken
+{
+public:
+    CancelToken() : flag_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void Cancel() {
+        flag_->store(true, std::memory_order_relaxed);
+    }
+
+    void Reset() {
+        flag_->store(false, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const {
+        return flag_->load(std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+// Counters of the evaluation in progress checked against the limits.
+// Tick() is called for each evaluated node : the cancel flag and the node
+// count are checked every time, the clock and the memory only every
+// check_period nodes.
+// The memory is the bytes allocated by the calling thread plus the ones
+// committed by the forks evaluated on other threads (see Task).
+class EvaluationBudget
+{
+public:
+    EvaluationBudget() : committed_bytes_(std::make_shared<std::atomic<size_t>>(0)) {}
+
+    static const size_t check_period = 256;
+
+    void SetLimits(const EvaluationLimits& limits) {
+        limits_ = limits;
+    }
+
+    const EvaluationLimits& Limits() const {
+        return limits_;
+    }
+
+    CancelToken Token() const {
+        return token_;
+    }
+
+    void Start() {
+        token_.Reset();
+        nodes_ = 0;
+        depth_ = 0;
+        start_ = std::chrono::steady_clock::now();
+        start_bytes_ = AllocationTracker::ThreadBytes();
+        committed_bytes_->store(0, std::memory_order_relaxed);
+    }
+
+    void Tick() {
+        if(token_.IsCancelled()) {
+            throw EvaluationInterrupted("Evaluation cancelled.\n");
+        }
+        ++nodes_;
+        if(limits_.max_nodes && nodes_ > limits_.max_nodes) {
+            throw EvaluationInterrupted("Evaluation budget exceeded : too many nodes.\n");
+        }
+        if(nodes_ % check_period == 0) {
+            Check();
+        }
+    }
+
+    void Check() const {
+        if(limits_.max_time.count() &&
+           std::chrono::steady_clock::now() - start_ > limits_.max_time) {
+            throw EvaluationInterrupted("Evaluation budget exceeded : time limit.\n");
+        }
+        if(limits_.max_memory && UsedBytes() > limits_.max_memory) {
+            throw EvaluationInterrupted("Evaluation budget exceeded : memory limit.\n");
+        }
+    }
+
+    size_t Nodes() const {
+        return nodes_;
+    }
+
+    // Tracked bytes allocated since Start() by the calling thread and the
+    // committed ones
+    size_t UsedBytes() const {
+        return committed_bytes_->load(std::memory_order_relaxed)
+                + AllocationTracker::ThreadBytes() - start_bytes_;
+    }
+
+    // Adds the bytes allocated by the calling thread to the ones seen by
+    // the forks, before they start
+    void Commit() {
+        const size_t bytes = AllocationTracker::ThreadBytes();
+        committed_bytes_->fetch_add(bytes - start_bytes_, std::memory_order_relaxed);
+        start_bytes_ = bytes;
+    }
+
+    // Budget of an evaluation continued on another thread : it shares the
+    // limits, the clock, the depth, the cancel flag and the committed bytes,
+    // and counts from the nodes of this one. It is used within a Task.
+    EvaluationBudget Fork() const {
+        EvaluationBudget fork(*this);
+        fork.forked_nodes_ = nodes_;
+        return fork;
+    }
+
+    // RAII evaluation of a fork on the calling thread : the bytes it
+    // allocates are committed at the end
+    struct Task {
+    public:
+        Task(EvaluationBudget& budget) : budget_(budget) {
+            budget_.start_bytes_ = AllocationTracker::ThreadBytes();
+        }
+        ~Task() {
+            budget_.Commit();
+        }
+    private:
+        EvaluationBudget& budget_;
+    };
+
+    // Adds the nodes evaluated by a fork
+    void Join(const EvaluationBudget& fork) {
+        nodes_ += fork.nodes_ - fork.forked_nodes_;
+        if(limits_.max_nodes && nodes_ > limits_.max_nodes) {
+            throw EvaluationInterrupted("Evaluation budget exceeded : too many nodes.\n");
+        }
+    }
+
+    // RAII nesting level of reference evaluations
+    struct DepthGuard {
+    public:
+        DepthGuard(EvaluationBudget& budget) : budget_(budget) {
+            if(budget_.limits_.max_depth && budget_.depth_ >= budget_.limits_.max_depth) {
+                throw EvaluationInterrupted("Evaluation budget exceeded : recursion too deep.\n");
+            }
+            ++budget_.depth_;
+        }
+        ~DepthGuard() {
+            --budget_.depth_;
+        }
+    private:
+        EvaluationBudget& budget_;
+    };
+
+private:
+    EvaluationLimits limits_;
+    CancelToken token_;
+    size_t nodes_ = 0;
+    size_t depth_ = 0;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+    size_t start_bytes_ = 0;
+    size_t forked_nodes_ = 0;
+    std::shared_ptr<std::atomic<size_t>> committed_bytes_;
+};
+
+#endif // H_EVAL_BUDGET
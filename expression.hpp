@@ -17,6 +17,9 @@
 #include "numeric_interface.hpp"
 #include "expression_dict.hpp"
 #include "dynarraylike.hpp"
+#include "pool_allocator.hpp"
+#include "alloc_tracker.hpp"
+#include "expression_nodes.hpp"
 
 
 #define _EXPRESION_EPSILON 1E-10
@@ -28,6 +31,11 @@ class Expression;
 template <typename T>
 using PExpression = std::shared_ptr<Expression<T>>;
 
+// Children of a node : unary and binary nodes keep them inline,
+// larger arrays (matrices, parameters) come from the small block pool.
+template <typename T>
+using expression_array = dynarray<PExpression<T>, PoolAllocator<PExpression<T>>, 2>;
+
 template <typename T>
 class FoldingVisitor;
 
@@ -44,11 +52,11 @@ template <typename T>
 class Expression : public std::enable_shared_from_this<Expression<T>>
 {
 public:
-    Expression() {}
+    explicit Expression(ExpressionKind kind) : kind_(kind) {}
 
-    explicit Expression(std::initializer_list<PExpression<T>> expressions) : children(std::move(expressions)) {}
-    explicit Expression(dynarray<PExpression<T>>&& exprs) : children(std::move(exprs)) {}
-    explicit Expression(const dynarray<PExpression<T>>& exprs) : children(exprs) {}
+    Expression(ExpressionKind kind, std::initializer_list<PExpression<T>> expressions) : children(std::move(expressions)), kind_(kind) {}
+    Expression(ExpressionKind kind, expression_array<T>&& exprs) : children(std::move(exprs)), kind_(kind) {}
+    Expression(ExpressionKind kind, const expression_array<T>& exprs) : children(exprs), kind_(kind) {}
 
     virtual ~Expression() {}
     virtual PExpression<T> Clone() const = 0;
@@ -69,9 +77,23 @@ public:
         return std::make_pair(1,1);
     }
 
-    dynarray<PExpression<T>> children;
+    // Concrete type of the node, see expression_nodes.hpp
+    ExpressionKind Kind() const
+    {
+        return kind_;
+    }
+
+    expression_array<T> children;
 protected:
+    // Called by the constructors of the concrete nodes with their size,
+    // the shared_ptr control block is not counted
+    static void Track(size_t bytes) {
+        AllocationTracker::Record(AllocExpression, bytes);
+    }
+
 private:
+    const ExpressionKind kind_;
+
     // interdiction de la copie
     Expression(const Expression<T>& e) = delete;
     Expression& operator=(const Expression<T>& e) = delete;
@@ -82,7 +104,7 @@ template <typename T>
 class UnaryExpression : public Expression<T>
 {
 public:
-    explicit UnaryExpression(PExpression<T> e) : Expression<T>{e}
+    UnaryExpression(ExpressionKind kind, PExpression<T> e) : Expression<T>(kind, {e})
     {}
 
     inline PExpression<T> m_e() const {return this->children[0];}
@@ -94,7 +116,7 @@ template <typename T>
 class BinaryExpression : public Expression<T>
 {
 public:
-    explicit BinaryExpression(PExpression<T> e1, PExpression<T> e2) : Expression<T>({e1, e2})
+    BinaryExpression(ExpressionKind kind, PExpression<T> e1, PExpression<T> e2) : Expression<T>(kind, {e1, e2})
     {}
 
     inline PExpression<T> m_e1() const {return this->children[0];}
@@ -108,8 +130,8 @@ class EqualExpression : public BinaryExpression<T>
 {
 public:
     explicit EqualExpression(PExpression<T> e1, PExpression<T> e2)
-    : BinaryExpression<T>(e1,e2)
-    {}
+    : BinaryExpression<T>(ExpressionKind::Equal, e1,e2)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -138,8 +160,8 @@ class AddExpression : public BinaryExpression<T>
 {
 public:
     explicit AddExpression(PExpression<T> e1, PExpression<T> e2)
-    : BinaryExpression<T>(e1,e2)
-    {}
+    : BinaryExpression<T>(ExpressionKind::Add, e1,e2)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -160,7 +182,7 @@ template <typename T>
 class NegExpression : public UnaryExpression<T>
 {
 public:
-    explicit NegExpression(PExpression<T> e) : UnaryExpression<T>(e) {}
+    explicit NegExpression(PExpression<T> e) : UnaryExpression<T>(ExpressionKind::Neg, e) {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -182,8 +204,8 @@ class MultExpression : public BinaryExpression<T>
 {
 public:
     explicit MultExpression(PExpression<T> e1, PExpression<T> e2)
-    : BinaryExpression<T>(e1,e2)
-    {}
+    : BinaryExpression<T>(ExpressionKind::Mult, e1,e2)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -205,8 +227,8 @@ class DivExpression : public BinaryExpression<T>
 {
 public:
     explicit DivExpression(PExpression<T> e1, PExpression<T> e2)
-        : BinaryExpression<T>(e1,e2)
-    {}
+        : BinaryExpression<T>(ExpressionKind::Div, e1,e2)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -223,13 +245,36 @@ public:
 protected:
 };
 
+template <typename T>
+class LeftDivExpression : public BinaryExpression<T>
+{
+public:
+    explicit LeftDivExpression(PExpression<T> e1, PExpression<T> e2)
+        : BinaryExpression<T>(ExpressionKind::LeftDiv, e1,e2)
+    {this->Track(sizeof(*this));}
+
+    virtual PExpression<T> Clone() const
+    {
+        return std::make_shared<LeftDivExpression<T>>(this->m_e1()->Clone(), this->m_e2()->Clone());
+    }
+
+    virtual PExpression<T> accept(TransformationVisitor<T> &v) {
+        return v.visit(this);
+    }
+
+    virtual T accept(FoldingVisitor<T> &v) {
+        return v.visit(this);
+    }
+protected:
+};
+
 template <typename T>
 class PowExpression : public BinaryExpression<T>
 {
 public:
     explicit PowExpression(PExpression<T> e1, PExpression<T> e2)
-    : BinaryExpression<T>(e1,e2)
-    {}
+    : BinaryExpression<T>(ExpressionKind::Pow, e1,e2)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -251,8 +296,8 @@ class FactExpression : public UnaryExpression<T>
 {
 public:
     explicit FactExpression(PExpression<T> e)
-        : UnaryExpression<T>(e)
-    {}
+        : UnaryExpression<T>(ExpressionKind::Fact, e)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -273,7 +318,7 @@ template <typename T>
 class ValExpression : public Expression<T>
 {
 public:
-    explicit ValExpression(const T& v) : Expression<T>(), value(v) {}
+    explicit ValExpression(const T& v) : Expression<T>(ExpressionKind::Val), value(v) {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -299,8 +344,8 @@ class RecursivePlaceholderExpression : public Expression<T>
 {
 public:
     explicit RecursivePlaceholderExpression(const std::string& name, const ParametersCall<T>& params)
-        : Expression<T>(), value_(), name_(name), params_(params)
-    {}
+        : Expression<T>(ExpressionKind::RecursivePlaceholder), name_(name), params_(params)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -314,20 +359,10 @@ public:
 
     const ParametersCall<T>& params() {return params_;}
 
-    void Set(const T& value)
-    {
-        value_ = value;
-    }
-
-    T get() const {
-        return value_;
-    }
-
     virtual T accept(FoldingVisitor<T>& v) {return v.visit(this);}
     virtual PExpression<T> accept(TransformationVisitor<T>& v)  {return v.visit(this);}
 
 protected:
-    T value_;
     std::string name_;
     ParametersCall<T> params_;
 };
@@ -336,9 +371,9 @@ template <typename T>
 class RecursiveExpression : public Expression<T>
 {
 public:
-    explicit RecursiveExpression(PExpression<T> expr, dynarray<PExpression<T>> recursive_placeholders)
-        : Expression<T>(std::move(recursive_placeholders)), expr_(expr)
-    {}
+    explicit RecursiveExpression(PExpression<T> expr, expression_array<T> recursive_placeholders)
+        : Expression<T>(ExpressionKind::Recursive, std::move(recursive_placeholders)), expr_(expr)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -361,12 +396,12 @@ class MatExpression : public Expression<T>
 public:
 
     explicit MatExpression(PExpression<T> e)
-        :  Expression<T>({e}), n_(1), m_(1)
-    {}
+        :  Expression<T>(ExpressionKind::Mat, {e}), n_(1), m_(1)
+    {this->Track(sizeof(*this));}
 
-    MatExpression(size_t n, size_t m, dynarray<PExpression<T>> expr)
-        : Expression<T>(expr), n_(n), m_(m)
-    {}
+    MatExpression(size_t n, size_t m, expression_array<T> expr)
+        : Expression<T>(ExpressionKind::Mat, expr), n_(n), m_(m)
+    {this->Track(sizeof(*this));}
 
     virtual std::pair<size_t,size_t> Size() const
     {
@@ -375,7 +410,7 @@ public:
 
     virtual PExpression<T> Clone() const
     {
-        dynarray<PExpression<T>> expr(this->children.size());
+        expression_array<T> expr(this->children.size());
         for(size_t i =0; i < expr.size(); ++i) {
             expr[i] = this->children[i]->Clone();
         }
@@ -401,8 +436,8 @@ class RefExpression : public Expression<T>
 {
 public:
     explicit RefExpression(const std::string& name)
-        : Expression<T>(), m_name(name)
-    { }
+        : Expression<T>(ExpressionKind::Ref), m_name(name)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -430,8 +465,8 @@ class FuncExpression : public BinaryExpression<T>
 {
 public:
     explicit FuncExpression(PExpression<T> ref_expression, PExpression<T> e1, PExpression<T> e2)
-        : BinaryExpression<T>(e1,e2), m_name(ref_expression->Name()), ref_expression_(ref_expression)
-    { }
+        : BinaryExpression<T>(ExpressionKind::Func, e1,e2), m_name(ref_expression->Name()), ref_expression_(ref_expression)
+    {this->Track(sizeof(*this));}
 
     virtual PExpression<T> Clone() const
     {
@@ -0,0 +1,44 @@
+#ifndef H_EXPR_NODES
+#define H_EXPR_NODES
+
+/**
+ ***************************************
+ * The node types of the expression trees.
+ *
+ * INKAMATH_EXPRESSION_NODES(NODE) expands NODE(Name) for every Name of a
+ * NameExpression class, in the order of the ExpressionVisitor methods.
+ * The forward declarations, the ExpressionKind tag stored in every node
+ * and the switch of EvaluationVisitor::Eval are generated from it : a new
+ * node type is added here and to these visitors.
+ ***************************************
+ */
+
+#define INKAMATH_EXPRESSION_NODES(NODE) \
+    NODE(Equal) \
+    NODE(Add) \
+    NODE(Neg) \
+    NODE(Mult) \
+    NODE(Div) \
+    NODE(LeftDiv) \
+    NODE(Pow) \
+    NODE(Fact) \
+    NODE(Val) \
+    NODE(Mat) \
+    NODE(Ref) \
+    NODE(Func) \
+    NODE(RecursivePlaceholder) \
+    NODE(Recursive)
+
+#define INKAMATH_DECLARE_EXPRESSION(name) \
+    template <typename T> \
+    class name##Expression;
+INKAMATH_EXPRESSION_NODES(INKAMATH_DECLARE_EXPRESSION)
+#undef INKAMATH_DECLARE_EXPRESSION
+
+enum class ExpressionKind : unsigned char {
+#define INKAMATH_EXPRESSION_KIND(name) name,
+    INKAMATH_EXPRESSION_NODES(INKAMATH_EXPRESSION_KIND)
+#undef INKAMATH_EXPRESSION_KIND
+};
+
+#endif // H_EXPR_NODES
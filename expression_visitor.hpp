@@ -9,9 +9,16 @@
 #include <stdexcept>
 #include <algorithm>
 #include <functional>
+#include <mutex>
 #include "dynarraylike.hpp"
 #include "expression_dict.hpp"
 #include "numeric_interface.hpp"
+#include "native_functions.hpp"
+#include "eval_budget.hpp"
+#include "profiler.hpp"
+#include "expression_nodes.hpp"
+#include "thread_pool.hpp"
+#include "elementwise.hpp"
 
 template <typename T>
 class Expression;
@@ -19,45 +26,6 @@ class Expression;
 template <typename T>
 using PExpression = std::shared_ptr<Expression<T>>;
 
-template <typename T>
-class EqualExpression;
-
-template <typename T>
-class AddExpression;
-
-template <typename T>
-class NegExpression;
-
-template <typename T>
-class MultExpression;
-
-template <typename T>
-class DivExpression;
-
-template <typename T>
-class PowExpression;
-
-template <typename T>
-class FactExpression;
-
-template <typename T>
-class ValExpression;
-
-template <typename T>
-class MatExpression;
-
-template <typename T>
-class RefExpression;
-
-template <typename T>
-class FuncExpression;
-
-template <typename T>
-class RecursivePlaceholderExpression;
-
-template <typename T>
-class RecursiveExpression;
-
 template <typename T>
 class ParametersCall;
 
@@ -69,6 +37,7 @@ public:
     virtual ReturnType visit(NegExpression<T>* expr) = 0;
     virtual ReturnType visit(MultExpression<T>* expr) = 0;
     virtual ReturnType visit(DivExpression<T>* expr) = 0;
+    virtual ReturnType visit(LeftDivExpression<T>* expr) = 0;
     virtual ReturnType visit(PowExpression<T>* expr) = 0;
     virtual ReturnType visit(FactExpression<T>* expr) = 0;
     virtual ReturnType visit(ValExpression<T>* expr) = 0;
@@ -196,6 +165,10 @@ public:
 		return visit_others_expr_imp(expr);
 	}
 
+	virtual PExpression<T> visit(LeftDivExpression<T>* expr) {
+		return visit_others_expr_imp(expr);
+	}
+
 	virtual PExpression<T> visit(PowExpression<T>* expr) {
 		return visit_others_expr_imp(expr);
 	}
@@ -314,6 +287,10 @@ public:
 		return visit_unexpected_expression();
 	}
 
+    virtual PExpression<T> visit(LeftDivExpression<T>* ) {
+		return visit_unexpected_expression();
+	}
+
     virtual PExpression<T> visit(PowExpression<T>* ) {
 		return visit_unexpected_expression();
 	}
@@ -383,6 +360,10 @@ public:
         return binary_visit(expr);
     }
 
+    virtual PExpression<T> visit(LeftDivExpression<T>* expr) {
+        return binary_visit(expr);
+    }
+
     virtual PExpression<T> visit(PowExpression<T>* expr) {
         return binary_visit(expr);
     }
@@ -460,57 +441,102 @@ template <typename T>
 class ReferenceStack;
 
 template <typename T>
-class EvaluationVisitor : public FoldingVisitor<T> {
+class JitCompiler;
+
+template <typename T>
+class EvaluationVisitor final : public FoldingVisitor<T> {
 public:
 
-    EvaluationVisitor<T>(ReferenceStack<T>& stack) : stack_(stack) {}
+    EvaluationVisitor<T>(ReferenceStack<T>& stack) : stack_(stack), budget_(stack.Budget()) {}
 
     ReferenceStack<T>& stack() {return stack_;}
 
+    // Evaluation of the node with a switch on its kind : the children are
+    // evaluated the same way, the visits being called without accept.
+    T Eval(Expression<T>* expr) {
+        switch(expr->Kind()) {
+#define INKAMATH_EVALUATE_NODE(name) \
+        case ExpressionKind::name: return visit(static_cast<name##Expression<T>*>(expr));
+        INKAMATH_EXPRESSION_NODES(INKAMATH_EVALUATE_NODE)
+#undef INKAMATH_EVALUATE_NODE
+        }
+        return expr->accept(*this);
+    }
+
+    T Eval(const PExpression<T>& expr) {
+        return Eval(expr.get());
+    }
+
     virtual T visit(EqualExpression<T>* expr) {
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Equal");
         if(expr->children[0]->children.size() > 0) {
-            this->stack_.Set(expr->Name(), ParametersDefinition<T>(expr->children[0]->children[0], expr->children[0]->children[1]), expr->children[1]);
+            this->stack_.Define(expr->Name(), ParametersDefinition<T>(expr->children[0]->children[0], expr->children[0]->children[1]), expr->children[1]);
         }
         else {
-            this->stack_.Set(expr->Name(), ParametersDefinition<T>(), expr->children[1]);
+            this->stack_.Define(expr->Name(), ParametersDefinition<T>(), expr->children[1]);
         }
-        return expr->m_e1()->accept(*this);
+        return Eval(expr->m_e1());
     }
 
     virtual T visit(AddExpression<T>* expr) {
-        return expr->m_e1()->accept(*this)
-             + expr->m_e2()->accept(*this);
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Add");
+        return Eval(expr->m_e1())
+             + Eval(expr->m_e2());
     }
 
     virtual T visit(NegExpression<T>* expr) {
-        return -expr->m_e()->accept(*this);
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Neg");
+        return -Eval(expr->m_e());
     }
 
     virtual T visit(MultExpression<T>* expr) {
-        return expr->m_e1()->accept(*this)
-             * expr->m_e2()->accept(*this);
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Mult");
+        return Eval(expr->m_e1())
+             * Eval(expr->m_e2());
     }
 
     virtual T visit(DivExpression<T>* expr) {
-        return expr->m_e1()->accept(*this)
-             / expr->m_e2()->accept(*this);
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Div");
+        return Eval(expr->m_e1())
+             / Eval(expr->m_e2());
+    }
+
+    virtual T visit(LeftDivExpression<T>* expr) {
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("LeftDiv");
+        return  numeric_interface<T>::solve(
+                    Eval(expr->m_e1()),
+                    Eval(expr->m_e2()));
     }
 
     virtual T visit(PowExpression<T>* expr) {
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Pow");
         return  numeric_interface<T>::pow(
-                    expr->m_e1()->accept(*this),
-                    expr->m_e2()->accept(*this));
+                    Eval(expr->m_e1()),
+                    Eval(expr->m_e2()));
     }
 
     virtual T visit(FactExpression<T>* expr) {
-        return  T(numeric_interface<T>::fact(expr->m_e()->accept(*this)));
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Fact");
+        return  T(numeric_interface<T>::fact(Eval(expr->m_e())));
     }
 
     virtual T visit(ValExpression<T>* expr) {
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Val");
         return expr->value;
     }
 
     virtual T visit(MatExpression<T>* expr) {
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Mat");
 
         size_t n, m;
         std::tie(n, m) = expr->Size();
@@ -518,11 +544,9 @@ public:
         dynarray<std::pair<size_t, size_t>> sizes(n*m);
 
         // Evaluating the matrix expression
-        for(size_t i = 0; i < n; ++i) {
-            for(size_t j = 0; j < m; ++j) {
-                evaluation[i*m+j] = expr->children[i*m+j]->accept(*this);
-                sizes[i*m+j] = evaluation[i*m+j].Size();
-            }
+        EvaluateCells(expr->children, evaluation);
+        for(size_t i = 0; i < n*m; ++i) {
+            sizes[i] = evaluation[i].Size();
         }
 
         // Compute the result size of each row and col in the matrix expression
@@ -542,76 +566,340 @@ public:
         dynarray<size_t> rj_cols = j_cols;
 
         for(size_t i = 1; i < n; ++i) {
-            ri_rows[i] += i_rows[i-1];
+            ri_rows[i] += ri_rows[i-1];
         }
         size_t rn = ri_rows.back();
         ri_rows.back() = 0;
         std::rotate(ri_rows.begin(), ri_rows.end()-1, ri_rows.end());
 
         for(size_t j = 1; j < m; ++j) {
-            rj_cols[j] += j_cols[j-1];
+            rj_cols[j] += rj_cols[j-1];
         }
         size_t rm = rj_cols.back();
         rj_cols.back() = 0;
         std::rotate(rj_cols.begin(), rj_cols.end()-1, rj_cols.end());
 
-        // Populate the final matrix with the right size
-        T retval(rn, rm);
-        for(size_t i = 0; i < n; ++i) {
-            for(size_t j = 0; j < m; ++j) {
+        typedef typename T::value_type value_type;
+        static const value_type zero(0);
+        // Calls f(row, col, values, count, repeat) on the segments of the rows
+        // of the final matrix, in row order : the count elements from col are
+        // values[0..count) or, when repeat, count times values[0]
+        auto for_each_segment = [&](std::function<void(size_t, size_t, const value_type*, size_t, bool)> f) {
+            for(size_t i = 0; i < n; ++i) {
                 for(size_t ri = 0; ri < i_rows[i]; ++ri) {
-                    for(size_t rj = 0; rj < j_cols[j]; ++rj) {
+                    const size_t row = ri_rows[i]+ri;
+                    for(size_t j = 0; j < m; ++j) {
+                        const T& cell = evaluation[i*m+j];
                         auto s = sizes[i*m+j];
-                        if(ri < s.first && rj < s.second) {
+                        size_t col = rj_cols[j];
+                        // the previous (up and left) evaluated cell result is extended
+                        const value_type last = cell(s.first, s.second);
+                        if(ri < s.first) {
                             // get the evaluated cell result
-                            retval((ri_rows[i]+ri+1), (rj_cols[j]+rj+1)) = evaluation[i*m+j](ri+1, rj+1);
+                            if(const SparseStorage<value_type>* sparse = cell.Sparse()) {
+                                size_t next = 0;
+                                for(size_t k = sparse->row_begin[ri]; k < sparse->row_begin[ri+1]; ++k) {
+                                    f(row, col+next, &zero, sparse->columns[k]-next, true);
+                                    f(row, col+sparse->columns[k], &sparse->values[k], 1, false);
+                                    next = sparse->columns[k]+1;
+                                }
+                                f(row, col+next, &zero, s.second-next, true);
+                            }
+                            else {
+                                f(row, col, cell.data()+ri*s.second, s.second, false);
+                            }
+                            col += s.second;
                         }
-                        else {
-                            // extend the previous (up and left) evaluated cell result
-                            retval((ri_rows[i]+ri+1), (rj_cols[j]+rj+1)) = evaluation[i*m+j](s.first, s.second);
+                        f(row, col, &last, rj_cols[j]+j_cols[j]-col, true);
+                    }
+                }
+            }
+        };
+
+        // Mostly zero large matrices (block matrices) are stored sparse
+        if(rn*rm >= SparseStorage<value_type>::min_size) {
+            size_t nonzeros = 0;
+            for_each_segment([&nonzeros](size_t, size_t, const value_type* values, size_t count, bool repeat) {
+                if(repeat) {
+                    nonzeros += (*values != zero) ? count : 0;
+                }
+                else {
+                    nonzeros += count - std::count(values, values+count, zero);
+                }
+            });
+            if(SparseStorage<value_type>::IsWorth(rn, rm, nonzeros)) {
+                std::shared_ptr<SparseStorage<value_type>> storage = std::make_shared<SparseStorage<value_type>>(rn, rm);
+                size_t row = 0;
+                for_each_segment([&](size_t r, size_t col, const value_type* values, size_t count, bool repeat) {
+                    for(; row < r; ++row) {
+                        storage->EndRow(row);
+                    }
+                    if(repeat && *values == zero) {
+                        return;
+                    }
+                    for(size_t k = 0; k < count; ++k) {
+                        const value_type& x = repeat ? *values : values[k];
+                        if(x != zero) {
+                            storage->Push(col+k, x);
                         }
                     }
+                });
+                for(; row < rn; ++row) {
+                    storage->EndRow(row);
                 }
+                storage->Record();
+                return T(rn, rm, std::shared_ptr<const SparseStorage<value_type>>(storage));
             }
         }
 
+        // Populate the final matrix with the right size
+        T retval(rn, rm);
+        value_type* p = retval.data();
+        for_each_segment([p, rm](size_t row, size_t col, const value_type* values, size_t count, bool repeat) {
+            if(repeat) {
+                std::fill_n(p+row*rm+col, count, *values);
+            }
+            else {
+                std::copy(values, values+count, p+row*rm+col);
+            }
+        });
+
         // Surprisingly it just works (at least for now).
         // Note to self : refactor later
         return retval; // finally
     }
 
     virtual T visit(RefExpression<T>* expr) {
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Ref");
         return stack_.Eval(expr->Name(), ParametersCall<T>());
     }
 
     virtual T visit(FuncExpression<T>* expr) {
-        return stack_.Eval(expr->Name(), ParametersCall<T>(expr->m_e1(), expr->m_e2()));
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Func");
+        if(expr->Name() == "map" && !stack_.Contains("map")) {
+            return Map(expr);
+        }
+        return Call(expr);
     }
 
     virtual T visit(RecursivePlaceholderExpression<T>* expr) {
-        return expr->get();
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("RecursivePlaceholder");
+        // Resolved from the memo of the sequence evaluation in progress
+        return stack_.SafeRecursiveEval(expr->Name(), expr->params());
     }
 
     virtual T visit(RecursiveExpression<T>* expr) {
-        for(auto e : expr->children) {
-            // We don't want to visit children here as we expect RecursivePlaceholderExpression
-            auto rec =  dynamic_cast<RecursivePlaceholderExpression<T>*>(e.get());
-            if(rec) {
-                rec->Set(stack_.SafeRecursiveEval(rec->Name(), rec->params()));
+        budget_.Tick();
+        INKAMATH_PROFILE_NODE("Recursive");
+        return Eval(expr->recursive_expr());
+    }
+
+
+    // Nodes evaluated by the first cell of a matrix literal (or the first
+    // call of a map) times the other cells (or calls) above which they are
+    // evaluated in parallel
+    static const size_t parallel_nodes = 20000;
+
+private:
+    // Call of a function : compiled, built-in or user defined
+    T Call(FuncExpression<T>* expr) {
+#ifdef INKAMATH_JIT
+        if(JitCompiler<T>* jit = stack_.Jit()) {
+            T result;
+            if(jit->TryCall(expr, *this, result)) {
+                return result;
             }
-            else {
-                // TODO:
-                // throw something as interpreter internal error ?
-                // assert ?
-                // refactor RecursiveExpression to hold RecursivePlaceholderExpression directly ?
+        }
+#endif
+        const NativeFunction<T>* native = NativeFunctions<T>::Instance().Find(expr->Name());
+        if(native && !stack_.Contains(expr->Name())) {
+            // missing arguments evaluate to 0 like any undefined parameter
+            ParametersCall<T> params(expr->m_e1(), expr->m_e2());
+            dynarray<T> args(native->arity);
+            args.fill(T());
+            size_t i = 0;
+            for(auto arg : params.parameters_expression()) {
+                if(i == args.size()) break;
+                args[i++] = Eval(arg);
+            }
+            return native->function(args);
+        }
+        return stack_.Eval(expr->Name(), ParametersCall<T>(expr->m_e1(), expr->m_e2()));
+    }
+
+    // map(f, A) : matrix of the size of A whose elements are the scalar
+    // results of f called with each element of A, A being evaluated once.
+    // The first call estimates the cost of the others, which run in blocks
+    // on the thread pool from parallel_nodes.
+    T Map(FuncExpression<T>* expr) {
+        typedef typename T::value_type value_type;
+        ParametersCall<T> params(expr->m_e1(), expr->m_e2());
+        const std::vector<PExpression<T>>& args = params.parameters_expression();
+        if(args.size() != 2 || !params.parameters_dict().empty() || args[0]->Kind() != ExpressionKind::Ref) {
+            throw std::runtime_error("Invalid map call : map(function, matrix) expected.\n");
+        }
+        PExpression<T> function = args[0];
+        // the result is dense, so is the walked copy of a sparse matrix
+        T a = Eval(args[1]).ToDense();
+        size_t rows, cols;
+        std::tie(rows, cols) = a.Size();
+        size_t count = rows*cols;
+        T result(rows, cols);
+        if(count == 0) {
+            return result;
+        }
+        const value_type* pa = a.data();
+        value_type* pr = result.data();
+        auto map_range = [&function, pa, pr](EvaluationVisitor<T>& evaluator, size_t begin, size_t end) {
+            ReferenceStack<T>& stack = evaluator.stack();
+            const std::string name = function->Name();
+            ParametersDefinition<T> params;
+            PExpression<T> body;
+            stack.FindSingleDefinition(name, params, body);
+#ifdef INKAMATH_JIT
+            // the compiled functions are called through Call
+            bool environment = body && !stack.Jit() && IsReadOnly(body.get());
+#else
+            bool environment = body && IsReadOnly(body.get());
+#endif
+            if(environment) {
+                // The calls of a function defined by a single expression share
+                // one environment, in which only the first parameter changes.
+                typename ReferenceStack<T>::Guard guard(stack);
+                EvaluationBudget::DepthGuard depth(evaluator.budget_);
+                params.SetCallParameters(ParametersCall<T>(), evaluator);
+                for(size_t i = begin; i < end; ++i) {
+                    evaluator.budget_.Tick();
+                    INKAMATH_PROFILE_REFERENCE(name);
+                    if(!params.parameters_names().empty()) {
+                        stack.Set(params.parameters_names().front(), ParametersDefinition<T>(), std::make_shared<ValExpression<T>>(T(pa[i])));
+                    }
+                    pr[i] = Scalar(evaluator.Eval(body));
+                }
+                return;
+            }
+            for(size_t i = begin; i < end; ++i) {
+                evaluator.budget_.Tick();
+                FuncExpression<T> call(function, std::make_shared<ValExpression<T>>(T(pa[i])), PExpression<T>());
+                pr[i] = Scalar(evaluator.Call(&call));
             }
+        };
+
+        size_t nodes = budget_.Nodes();
+        map_range(*this, 0, 1);
+        nodes = budget_.Nodes() - nodes;
+        if(IsParallel(nodes, count-1)) {
+            size_t tasks = std::min(count-1, ThreadPool::Shared().Concurrency()*Elementwise::blocks_per_thread);
+            size_t block = (count-1+tasks-1)/tasks;
+            ParallelEvaluate((count-1+block-1)/block, [&](EvaluationVisitor<T>& evaluator, size_t k) {
+                map_range(evaluator, 1+k*block, std::min(count, 1+(k+1)*block));
+            });
+        }
+        else {
+            map_range(*this, 1, count);
         }
-        return expr->recursive_expr()->accept(*this);
+        return result;
     }
 
+    static typename T::value_type Scalar(const T& r) {
+        if(r.Size() != std::make_pair(size_t(1), size_t(1))) {
+            throw std::runtime_error("Invalid map call : the function shall return a scalar.\n");
+        }
+        return r.get(0);
+    }
+
+    // The cells are evaluated in order, or the first one alone to estimate
+    // their cost and the others in parallel when no cell defines a
+    // reference.
+    void EvaluateCells(const expression_array<T>& cells, dynarray<T>& evaluation) {
+        size_t count = cells.size();
+        if(count == 0) {
+            return;
+        }
+        size_t nodes = budget_.Nodes();
+        evaluation[0] = Eval(cells[0]);
+        nodes = budget_.Nodes() - nodes;
+
+        if(IsParallel(nodes, count-1)
+                && std::all_of(cells.begin(), cells.end(), [](const PExpression<T>& cell) { return IsReadOnly(cell.get()); })) {
+            ParallelEvaluate(count-1, [&](EvaluationVisitor<T>& evaluator, size_t k) {
+                evaluation[k+1] = evaluator.Eval(cells[k+1]);
+            });
+        }
+        else {
+            for(size_t i = 1; i < count; ++i) {
+                evaluation[i] = Eval(cells[i]);
+            }
+        }
+    }
+
+    // count evaluations estimated at nodes each are worth the thread pool
+    static bool IsParallel(size_t nodes, size_t count) {
+#ifndef INKAMATH_PROFILING
+        return ThreadPool::Shared().Concurrency() > 1 && !ThreadPool::InTask()
+                && count > 0 && nodes*count >= parallel_nodes;
+#else
+        // the profiler expects a single evaluating thread
+        (void)nodes;
+        (void)count;
+        return false;
+#endif
+    }
+
+    // Calls f(evaluator, k) for each k in [0, count) on the shared thread
+    // pool. Each pool thread evaluates on its own fork of the stack, the
+    // stack of this evaluator is not modified meanwhile.
+    template <typename F>
+    void ParallelEvaluate(size_t count, F f) {
+        budget_.Commit();
+        std::mutex forks_mutex;
+        std::vector<std::unique_ptr<ReferenceStack<T>>> forks;
+        ThreadPool::Shared().ParallelFor(count, [&](size_t k) {
+            std::unique_ptr<ReferenceStack<T>> fork;
+            {
+                std::lock_guard<std::mutex> lock(forks_mutex);
+                if(!forks.empty()) {
+                    fork = std::move(forks.back());
+                    forks.pop_back();
+                }
+            }
+            if(!fork) {
+                fork.reset(new ReferenceStack<T>(stack_.Fork()));
+            }
+            {
+                EvaluationBudget::Task task(fork->Budget());
+                EvaluationVisitor<T> evaluator(*fork);
+                f(evaluator, k);
+            }
+            std::lock_guard<std::mutex> lock(forks_mutex);
+            forks.push_back(std::move(fork));
+        });
+        for(const auto& fork : forks) {
+            budget_.Join(fork->Budget());
+        }
+    }
+
+    // No node of the tree defines a reference
+    static bool IsReadOnly(const Expression<T>* expr) {
+        if(!expr) {
+            return true;
+        }
+        if(expr->Kind() == ExpressionKind::Equal) {
+            return false;
+        }
+        for(const PExpression<T>& child : expr->children) {
+            if(!IsReadOnly(child.get())) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-private:
     ReferenceStack<T>& stack_;
+    EvaluationBudget& budget_;
 };
 
 
@@ -2,6 +2,7 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
+CONFIG += thread
 
 QMAKE_CXXFLAGS += -std=c++11
 QMAKE_CXXFLAGS += -W -Wall
@@ -10,6 +11,13 @@ QMAKE_CXXFLAGS +=-static-libgcc -static-libstdc++ -ggdb
 
 QMAKE_CXXFLAGS_RELEASE *= -O3
 
+# per reference profiling (:profile and :flame REPL commands)
+#DEFINES += INKAMATH_PROFILING
+
+# native compilation of the hot functions with the system compiler (POSIX)
+#DEFINES += INKAMATH_JIT INKAMATH_JIT_INCLUDE_DIR=\\\"$$PWD\\\"
+#LIBS += -ldl
+
 INCLUDEPATH += D:\boost\boost_1_55_0
 
 SOURCES += main.cpp \
@@ -18,6 +26,7 @@ SOURCES += main.cpp \
 HEADERS += \
     best_promotion.hpp \
     expression.hpp \
+    expression_nodes.hpp \
     expression_dict.hpp \
     expression_visitor.hpp \
     interpreter.hpp \
@@ -27,11 +36,31 @@ HEADERS += \
     pmath.hpp \
     reference.hpp \
     sequence.hpp \
+    summation.hpp \
+    thread_pool.hpp \
     token.hpp \
     reference_stack.hpp \
     parameters.hpp \
     dynarraylike.hpp \
-    getlines.hpp
+    getlines.hpp \
+    linalg.hpp \
+    native_functions.hpp \
+    eval_budget.hpp \
+    elementwise.hpp \
+    sparse.hpp \
+    bigfloat.hpp \
+    interval.hpp \
+    profiler.hpp \
+    alloc_tracker.hpp \
+    pool_allocator.hpp \
+    output_buffer.hpp \
+    number_format.hpp \
+    number_parse.hpp \
+    matrix_io.hpp \
+    session.hpp \
+    codegen.hpp \
+    jit.hpp \
+    cpp_export.hpp
 
 OTHER_FILES += \
     .gitignore
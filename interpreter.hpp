@@ -17,7 +17,16 @@
 #include "token.hpp"
 #include "numeric_interface.hpp"
 #include "reference_stack.hpp"
+#include "eval_budget.hpp"
+#include "alloc_tracker.hpp"
+#include "profiler.hpp"
 #include "dynarraylike.hpp"
+#include "matrix_io.hpp"
+#include "session.hpp"
+#include "cpp_export.hpp"
+#ifdef INKAMATH_JIT
+#include "jit.hpp"
+#endif
 
 template <typename T>
 using PExpression = std::shared_ptr<Expression<T>>;
@@ -31,12 +40,49 @@ public:
 
     typedef typename U::value_type value_type;
     typedef U matrix_type;
+    typedef std::list<Token<T>, TrackingAllocator<Token<T>, AllocToken>> token_list;
 
     U Eval(const std::string& s);
     void PrintTokens(void);
 
+    // Front end only (tools and benchmarks), errors are thrown
+    size_t Tokenize(const std::string& s); // returns the number of tokens
+    PExpression<U> Compile(const std::string& s);
+
+    // Budget of each Eval call, an exceeded budget is reported as an error
+    void SetLimits(const EvaluationLimits& limits);
+    // Thread-safe : stops the evaluation in progress
+    void Cancel();
+    CancelToken GetCancelToken();
+
     void ResetInterpreter(void);
 
+    // Defines name as the matrix stored in path (.csv or binary matrix
+    // file, see matrix_io.hpp). Errors are reported as the Eval ones.
+    bool Load(const std::string& name, const std::string& path);
+
+    // Letters followed by digits, the names read by the lexer
+    static bool IsReferenceName(const std::string& name);
+
+    // Snapshot of the definitions (see session.hpp). Restoring replaces
+    // the definitions of the same names and keeps the other ones.
+    bool SaveSession(const std::string& path);
+    bool RestoreSession(const std::string& path);
+
+    // Writes the definitions as a C++ header of function templates on the
+    // scalar type (see cpp_export.hpp)
+    bool ExportCpp(const std::string& path, const std::string& space = "inkamath_export");
+
+#ifdef INKAMATH_JIT
+    // Calls of a function before its native compilation (see jit.hpp),
+    // 0 disables the compilation
+    void SetJitThreshold(size_t calls);
+    size_t JitCompiledCount() const;
+#endif
+
+    // Stream of the evaluation errors (std::cout by default)
+    void SetErrorStream(std::ostream& os);
+
 private:
     void Lexer(const std::string& s);
     void Number_Lexer(const std::string& s, size_t& i);
@@ -53,17 +99,26 @@ private:
     PExpression<U> ParseParameters();
     PExpression<U> ParseSubExpr();
 
-    std::list< Token<T> > m_toklist;
-    typename std::list< Token<T> >::iterator m_i;
+    token_list m_toklist;
+    typename token_list::iterator m_i;
 
     PExpression<U> m_E;
     ReferenceStack<U> stack_;
     std::ostringstream oss;
+    std::ostream* m_err;
+#ifdef INKAMATH_JIT
+    std::shared_ptr<JitCompiler<U>> m_jit;
+#endif
 };
 
 template <typename T, typename U>
-Interpreter<T,U>::Interpreter()
-{}
+Interpreter<T,U>::Interpreter() : m_err(&std::cout)
+{
+#ifdef INKAMATH_JIT
+    m_jit = std::make_shared<JitCompiler<U>>();
+    stack_.SetJit(m_jit);
+#endif
+}
 
 template <typename T, typename U>
 Interpreter<T,U>::~Interpreter()
@@ -71,6 +126,44 @@ Interpreter<T,U>::~Interpreter()
 
 }
 
+template <typename T, typename U>
+void Interpreter<T,U>::SetLimits(const EvaluationLimits& limits)
+{
+    stack_.Budget().SetLimits(limits);
+}
+
+template <typename T, typename U>
+void Interpreter<T,U>::Cancel()
+{
+    stack_.Budget().Token().Cancel();
+}
+
+template <typename T, typename U>
+CancelToken Interpreter<T,U>::GetCancelToken()
+{
+    return stack_.Budget().Token();
+}
+
+#ifdef INKAMATH_JIT
+template <typename T, typename U>
+void Interpreter<T,U>::SetJitThreshold(size_t calls)
+{
+    m_jit->SetThreshold(calls);
+}
+
+template <typename T, typename U>
+size_t Interpreter<T,U>::JitCompiledCount() const
+{
+    return m_jit->CompiledCount();
+}
+#endif
+
+template <typename T, typename U>
+void Interpreter<T,U>::SetErrorStream(std::ostream& os)
+{
+    m_err = &os;
+}
+
 template <typename T, typename U>
 void Interpreter<T,U>::ResetInterpreter()
 {
@@ -121,6 +214,9 @@ void Interpreter<T,U>::Lexer(const std::string& s)
         case '/':
             m_toklist.push_back(Token<T>(Div));
             break;
+        case '\\':
+            m_toklist.push_back(Token<T>(LDiv));
+            break;
         case '^':
             m_toklist.push_back(Token<T>(Pow));
             break;
@@ -132,9 +228,15 @@ void Interpreter<T,U>::Lexer(const std::string& s)
             break;
         case ' ':
             break;
+        case 'i':
+            // the imaginary unit unless it starts a reference name (ex: inv)
+            if(i+1 < s.length() && std::isalpha(s[i+1]))
+                Reference_Lexer(s,i);
+            else
+                this->Number_Lexer(s,i);
+            break;
 		case '0': case '1': case '2': case '3': case '4':
 		case '5': case '6': case '7': case '8': case '9':
-		case 'i':
             this->Number_Lexer(s,i);
             break;
         case '#': // inkamath comments
@@ -184,7 +286,12 @@ void Interpreter<T,U>::Reference_Lexer(const std::string &s, size_t& i)
             ++i;
         }
         std::string name(s.substr(s_i,i-s_i));
-        m_toklist.push_back(Token<T>(Func,0,name));
+        if (name.capacity() > std::string().capacity())
+        {
+            // not held in the small string buffer
+            AllocationTracker::Record(AllocString, name.capacity()+1);
+        }
+        m_toklist.push_back(Token<T>(Func,T(),name));
         --i;
     }
     else
@@ -233,7 +340,7 @@ template <typename T, typename U>
 PExpression<U> Interpreter<T,U>::ParseEqualExpr()
 {
     PExpression<U> e,ref,params,expr,sub;
-    typename std::list< Token<T> >::iterator m_s = m_i;
+    typename token_list::iterator m_s = m_i;
     if (m_i != m_toklist.end() && m_i->type == Func)
     {
         std::string name = m_i++->name;
@@ -286,16 +393,21 @@ template <typename T, typename U>
 PExpression<U> Interpreter<T,U>::ParseMultExpr()
 {
     PExpression<U> e = ParsePowExpr();
-    while (m_i != m_toklist.end() && (m_i->type == Mult || m_i->type == Div) )
+    while (m_i != m_toklist.end() && (m_i->type == Mult || m_i->type == Div || m_i->type == LDiv) )
     {
-        if ((m_i++)->type == Mult)
+        Type type = (m_i++)->type;
+        if (type == Mult)
         {
             e.reset(new MultExpression<U>(e,ParsePowExpr()));
         }
-        else
+        else if (type == Div)
         {
             e.reset(new DivExpression<U>(e,ParsePowExpr()));
         }
+        else
+        {
+            e.reset(new LeftDivExpression<U>(e,ParsePowExpr()));
+        }
     }
     return e;
 }
@@ -307,7 +419,16 @@ PExpression<U> Interpreter<T,U>::ParsePowExpr()
     if (m_i != m_toklist.end() && m_i->type == Pow)
     {
         ++m_i;
-        e.reset(new PowExpression<U>(e,ParsePowExpr()));
+        if (m_i != m_toklist.end() && m_i->type == Min)
+        {
+            // a^-b*c is (a^(-b))*c, the unary minus only applies to the exponent
+            ++m_i;
+            e.reset(new PowExpression<U>(e,PExpression<U>(new NegExpression<U>(ParsePowExpr()))));
+        }
+        else
+        {
+            e.reset(new PowExpression<U>(e,ParsePowExpr()));
+        }
     }
     return e;
 }
@@ -341,16 +462,21 @@ PExpression<U> Interpreter<T,U>::ParseMatrix()
 }
 
 template <typename T>
-dynarray<PExpression<T>>
+expression_array<T>
  make_matrix_array_from_vector(size_t n, size_t m, std::vector<PExpression<T>>& mat,
                            std::vector<size_t>& size)
 {
-    auto exprs = dynarray<PExpression<T>>(n*m);
+    auto exprs = expression_array<T>(n*m);
+    // the missing cells share the same zero
+    PExpression<T> zero;
     size_t prev = 0;
     for(size_t i = 0; i < n; ++i) {
         std::move(mat.begin()+prev, mat.begin()+prev+size[i], exprs.begin()+i*m);
         for(size_t j = size[i]; j <m; ++j) {
-            exprs[i*m+j] = PExpression<T>(new ValExpression<T>(T(0)));
+            if(!zero) {
+                zero = PExpression<T>(new ValExpression<T>(T(0)));
+            }
+            exprs[i*m+j] = zero;
         }
         prev += size[i];
     }
@@ -435,7 +561,7 @@ PExpression<U>  Interpreter<T,U>::ParseSimpleExpr()
     return e;
 }
 
-void print(std::string s)
+inline void print(std::string s)
 {
     std::cout << s;
 }
@@ -444,7 +570,7 @@ template <typename T, typename U>
 PExpression<U> Interpreter<T,U>::ParseParameters()
 {
     PExpression<U> e;
-    typename std::list< Token<T> >::iterator m_s = m_i;
+    typename token_list::iterator m_s = m_i;
     if (m_i != m_toklist.end() && m_i++->type == LPar && m_i != m_toklist.end() && m_i->type != RPar)
     {
         e = ParseMatrix();
@@ -463,7 +589,7 @@ template <typename T, typename U>
 PExpression<U> Interpreter<T,U>::ParseSubExpr()
 {
     PExpression<U> e;
-    typename std::list< Token<T> >::iterator m_s = m_i;
+    typename token_list::iterator m_s = m_i;
     if (m_i != m_toklist.end() && m_i++->type == Sub)
     {
         e = ParseSimpleExpr();
@@ -483,28 +609,135 @@ U Interpreter<T,U>::Eval(const std::string& s)
     U ret = U(); // relatively exception safe :o
     try
     {
+        // a Cancel() issued from now on stops this evaluation
+        stack_.Budget().Start();
         /* the following functions might throw some evaluation errors */
         Lexer(s);
         m_E = ParseAll();
+        INKAMATH_PROFILE_REFERENCE("eval");
         EvaluationVisitor<U> evaluator(stack_);
-        ret = m_E->accept(evaluator);
+        ret = evaluator.Eval(m_E);
     }
     catch (const std::exception& e)
     {
-        std::cout << "Error : " << e.what();
+        *m_err << "Error : " << e.what();
     }
     catch (...)
     {
-        std::cout << "Unknown error" << std::endl;
+        *m_err << "Unknown error" << std::endl;
     }
     ResetInterpreter(); // reset whatever happens and forgive the user
     return ret;
 }
 
+template <typename T, typename U>
+bool Interpreter<T,U>::Load(const std::string& name, const std::string& path)
+{
+    try
+    {
+        if (!IsReferenceName(name))
+        {
+            throw std::runtime_error("Invalid reference name '" + name + "'.\n");
+        }
+        U m = load_matrix<value_type>(path);
+        stack_.Define(name, ParametersDefinition<U>(), std::make_shared<ValExpression<U>>(m));
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        *m_err << "Error : " << e.what();
+    }
+    return false;
+}
+
+template <typename T, typename U>
+bool Interpreter<T,U>::IsReferenceName(const std::string& name)
+{
+    size_t i = 0;
+    while (i < name.length() && std::isalpha(static_cast<unsigned char>(name[i])))
+    {
+        ++i;
+    }
+    if (i == 0)
+    {
+        return false;
+    }
+    while (i < name.length() && std::isdigit(static_cast<unsigned char>(name[i])))
+    {
+        ++i;
+    }
+    return i == name.length();
+}
+
+template <typename T, typename U>
+bool Interpreter<T,U>::SaveSession(const std::string& path)
+{
+    try
+    {
+        SessionSnapshot<U>::Save(stack_, path);
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        *m_err << "Error : " << e.what();
+    }
+    return false;
+}
+
+template <typename T, typename U>
+bool Interpreter<T,U>::RestoreSession(const std::string& path)
+{
+    try
+    {
+        SessionSnapshot<U>::Load(stack_, path);
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        *m_err << "Error : " << e.what();
+    }
+    return false;
+}
+
+template <typename T, typename U>
+bool Interpreter<T,U>::ExportCpp(const std::string& path, const std::string& space)
+{
+    try
+    {
+        CppExport<U>::Save(stack_, path, space);
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        *m_err << "Error : " << e.what();
+    }
+    return false;
+}
+
+template <typename T, typename U>
+size_t Interpreter<T,U>::Tokenize(const std::string& s)
+{
+    ResetInterpreter();
+    Lexer(s);
+    size_t count = m_toklist.size();
+    ResetInterpreter();
+    return count;
+}
+
+template <typename T, typename U>
+PExpression<U> Interpreter<T,U>::Compile(const std::string& s)
+{
+    ResetInterpreter();
+    Lexer(s);
+    PExpression<U> expr = ParseAll();
+    ResetInterpreter();
+    return expr;
+}
+
 template <typename T, typename U>
 void Interpreter<T,U>::PrintTokens(void)
 {
-    typename std::list<Token<T> >::iterator i = m_toklist.begin();
+    typename token_list::iterator i = m_toklist.begin();
     while (i != m_toklist.end())
     {
         std::cout << i->Print();
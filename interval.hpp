@@ -0,0 +1,698 @@
+#ifndef H_INTERVAL
+#define H_INTERVAL
+
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <ostream>
+#include <algorithm>
+#include <complex>
+
+#include "number_format.hpp"
+#include "number_parse.hpp"
+
+/**
+ ***************************************
+ * Interval of doubles [lo, hi] enclosing the exact result of a
+ * computation, the scalar of Interpreter<std::complex<Interval>>.
+ *
+ * The bounds of +, -, *, / and sqrt are rounded outward : the rounding
+ * to nearest is corrected towards -inf (+inf) from the exact error of the
+ * operation (TwoSum for a sum, the fused multiply-add or Dekker's product
+ * for a product, a quotient and a square root), so an exact operation,
+ * like the integer arithmetic of the scripts, gives a point interval. The
+ * rounding mode of the processor is never changed. The other functions widen the libm values of the bounds
+ * by libm_ulps (gamma_ulps for gamma), above the errors the glibc
+ * documents, and account for the extrema within the interval.
+ * A decimal literal other than an integer is enclosed in the doubles
+ * around its nearest double.
+ * The interval of the sum of a series term is the enclosure of that
+ * finite sum : the truncation of a limit (f without index) stays the
+ * interpreter's stopping criterion.
+ *
+ * Ordering (<, >, std::max) compares the midpoints, so that the
+ * interpreter and std::complex take the branches the double would take,
+ * == compares the bounds. The branch cuts of the complex functions are
+ * decided on the midpoints, the gamma function of a complex non real
+ * argument keeps its 15 digits Lanczos approximation and isn't enclosed.
+ * An interval is printed as one number when its bounds print the same,
+ * as [lo,hi] otherwise.
+ ***************************************
+ */
+
+class Interval
+{
+public:
+    static const int precision = 9;
+    // two numbers, brackets and comma
+    static const size_t buffer_size = 2*number_buffer_size + 3;
+    static const int libm_ulps = 4;
+    static const int gamma_ulps = 16;
+
+    Interval() : lo_(0), hi_(0) {}
+    Interval(double a) : lo_(a), hi_(a) {}
+    Interval(double lo, double hi) : lo_(lo), hi_(hi) {}
+
+    double Lower() const {return lo_;}
+    double Upper() const {return hi_;}
+    bool IsNaN() const {return std::isnan(lo_) || std::isnan(hi_);}
+    bool IsPoint() const {return lo_ == hi_;}
+    bool Contains(double x) const {return lo_ <= x && x <= hi_;}
+
+    double Mid() const
+    {
+        if (lo_ == hi_)
+        {
+            return lo_;
+        }
+        if (std::isinf(lo_) && std::isinf(hi_))
+        {
+            return 0;
+        }
+        return lo_/2 + hi_/2;
+    }
+
+    // Upper bound of hi-lo
+    double Width() const
+    {
+        return AddUp(hi_, -lo_);
+    }
+
+    Interval operator-() const {return Interval(-hi_, -lo_);}
+
+    Interval& operator+=(const Interval& b) {return *this = *this + b;}
+    Interval& operator-=(const Interval& b) {return *this = *this - b;}
+    Interval& operator*=(const Interval& b) {return *this = *this * b;}
+    Interval& operator/=(const Interval& b) {return *this = *this / b;}
+
+    friend Interval operator+(const Interval& a, const Interval& b)
+    {
+        return Interval(AddDown(a.lo_, b.lo_), AddUp(a.hi_, b.hi_));
+    }
+
+    friend Interval operator-(const Interval& a, const Interval& b)
+    {
+        return Interval(AddDown(a.lo_, -b.hi_), AddUp(a.hi_, -b.lo_));
+    }
+
+    friend Interval operator*(const Interval& a, const Interval& b)
+    {
+        if (a.IsNaN() || b.IsNaN())
+        {
+            return NaN();
+        }
+        if (a.IsPoint() && b.IsPoint())
+        {
+            return Product(a.lo_, b.lo_);
+        }
+        if (a.lo_ >= 0 && b.lo_ >= 0)
+        {
+            return Interval(Product(a.lo_, b.lo_).lo_, Product(a.hi_, b.hi_).hi_);
+        }
+        return Hull(Product(a.lo_, b.lo_), Product(a.lo_, b.hi_),
+                    Product(a.hi_, b.lo_), Product(a.hi_, b.hi_));
+    }
+
+    friend Interval operator/(const Interval& a, const Interval& b)
+    {
+        if (a.IsNaN() || b.IsNaN())
+        {
+            return NaN();
+        }
+        if (b.lo_ == 0 && b.hi_ == 0)
+        {
+            // as the double : +-inf, or nan for 0/0
+            const double q1 = a.lo_/b.lo_, q2 = a.hi_/b.lo_;
+            return (std::isnan(q1) || std::isnan(q2)) ? NaN() : Interval(std::min(q1, q2), std::max(q1, q2));
+        }
+        if (b.lo_ <= 0 && b.hi_ >= 0)
+        {
+            return Interval(-HUGE_VAL, HUGE_VAL);
+        }
+        if (b.IsPoint())
+        {
+            return a.IsPoint() ? Quotient(a.lo_, b.lo_) : Hull(Quotient(a.lo_, b.lo_), Quotient(a.hi_, b.lo_));
+        }
+        if (a.lo_ >= 0 && b.lo_ > 0)
+        {
+            return Interval(Quotient(a.lo_, b.hi_).lo_, Quotient(a.hi_, b.lo_).hi_);
+        }
+        return Hull(Hull(Quotient(a.lo_, b.lo_), Quotient(a.lo_, b.hi_)),
+                    Hull(Quotient(a.hi_, b.lo_), Quotient(a.hi_, b.hi_)));
+    }
+
+    friend bool operator==(const Interval& a, const Interval& b) {return a.lo_ == b.lo_ && a.hi_ == b.hi_;}
+    friend bool operator!=(const Interval& a, const Interval& b) {return !(a == b);}
+    friend bool operator<(const Interval& a, const Interval& b) {return a.Mid() < b.Mid();}
+    friend bool operator>(const Interval& a, const Interval& b) {return a.Mid() > b.Mid();}
+    friend bool operator<=(const Interval& a, const Interval& b) {return a.Mid() <= b.Mid();}
+    friend bool operator>=(const Interval& a, const Interval& b) {return a.Mid() >= b.Mid();}
+
+    // Encloses pi
+    static Interval Pi()
+    {
+        return Interval(3.141592653589793, 3.1415926535897936);
+    }
+
+    /* numeric_interface */
+    static Interval zero() {return Interval();}
+    static Interval one() {return Interval(1);}
+    static int toInt(const Interval& a) {return static_cast<int>(a.Mid());}
+    static Interval conj(const Interval& a) {return a;}
+
+    static Interval abs(const Interval& a)
+    {
+        if (a.lo_ >= 0)
+        {
+            return a;
+        }
+        if (a.hi_ <= 0)
+        {
+            return -a;
+        }
+        return Interval(0, std::max(-a.lo_, a.hi_));
+    }
+
+    // The negative part of a is ignored
+    static Interval sqrt(const Interval& a)
+    {
+        if (a.IsNaN() || a.hi_ < 0)
+        {
+            return NaN();
+        }
+        return Interval(SquareRoot(std::max(a.lo_, 0.0)).lo_, SquareRoot(a.hi_).hi_);
+    }
+
+    static Interval exp(const Interval& a)
+    {
+        if (a == zero())
+        {
+            return one();
+        }
+        const double hi = LibmUp(std::exp(a.hi_));
+        return Interval(std::max(LibmDown(std::exp(a.lo_)), 0.0),
+                        (hi == 0 && a.hi_ != -HUGE_VAL) ? std::numeric_limits<double>::denorm_min() : hi);
+    }
+
+    // The negative part of a is ignored
+    static Interval log(const Interval& a)
+    {
+        if (a.IsNaN() || a.hi_ < 0)
+        {
+            return NaN();
+        }
+        return Interval(a.lo_ <= 0 ? -HUGE_VAL : LibmDown(std::log(a.lo_)), LibmUp(std::log(a.hi_)));
+    }
+
+    // Integer powers by squaring, exp(b*log(a)) for the others
+    static Interval pow(const Interval& a, const Interval& b)
+    {
+        if (b.IsPoint() && std::fabs(b.lo_) < (1 << 30) && b.lo_ == std::floor(b.lo_))
+        {
+            const int n = static_cast<int>(b.lo_);
+            Interval r = one(), x = a;
+            for (unsigned k = unsigned(n < 0 ? -n : n); k != 0; k >>= 1)
+            {
+                if (k & 1)
+                {
+                    r *= x;
+                }
+                x = Square(x);
+            }
+            return n < 0 ? one()/r : r;
+        }
+        return exp(b*log(a));
+    }
+
+    static Interval sin(const Interval& a)
+    {
+        // maxima at pi/2 + 2k pi, minima at 3pi/2 + 2k pi
+        return Periodic(a, [](double x) {return std::sin(x);}, 0.5, 1.5);
+    }
+
+    static Interval cos(const Interval& a)
+    {
+        // maxima at 2k pi, minima at pi + 2k pi
+        return Periodic(a, [](double x) {return std::cos(x);}, 0, 1);
+    }
+
+    static Interval tan(const Interval& a)
+    {
+        // increasing between the poles at pi/2 + k pi
+        if (a.IsPoint())
+        {
+            return Increasing(a, [](double x) {return std::tan(x);});
+        }
+        if (a.IsNaN() || PossiblyContains(a, 0.5, 1))
+        {
+            return a.IsNaN() ? NaN() : Interval(-HUGE_VAL, HUGE_VAL);
+        }
+        return Increasing(a, [](double x) {return std::tan(x);});
+    }
+
+    static Interval atan(const Interval& a)
+    {
+        return Increasing(a, [](double x) {return std::atan(x);});
+    }
+
+    static Interval atan2(const Interval& y, const Interval& x)
+    {
+        const Interval half_pi = Pi()/Interval(2);
+        if (x.IsNaN() || y.IsNaN())
+        {
+            return NaN();
+        }
+        if (x.lo_ > 0)
+        {
+            return atan(y/x);
+        }
+        if (y.lo_ > 0)
+        {
+            return half_pi - atan(x/y);
+        }
+        if (y.hi_ < 0)
+        {
+            return -half_pi - atan(x/y);
+        }
+        if (y.lo_ == 0 && y.hi_ == 0 && (x.hi_ < 0 || x.IsPoint()))
+        {
+            // on the negative real axis or at 0, as the double
+            if (std::atan2(y.lo_, x.lo_) == 0)
+            {
+                return Interval(y.lo_);
+            }
+            return std::signbit(y.lo_) ? -Pi() : Pi();
+        }
+        return Interval(-Pi().hi_, Pi().hi_);
+    }
+
+    static Interval asin(const Interval& a)
+    {
+        if (a.IsNaN() || a.lo_ > 1 || a.hi_ < -1)
+        {
+            return NaN();
+        }
+        return Increasing(Interval(std::max(a.lo_, -1.0), std::min(a.hi_, 1.0)), [](double x) {return std::asin(x);});
+    }
+
+    static Interval acos(const Interval& a)
+    {
+        if (a.IsNaN() || a.lo_ > 1 || a.hi_ < -1)
+        {
+            return NaN();
+        }
+        return Interval(LibmDown(std::acos(std::min(a.hi_, 1.0))), LibmUp(std::acos(std::max(a.lo_, -1.0))));
+    }
+
+    static Interval sinh(const Interval& a)
+    {
+        return Increasing(a, [](double x) {return std::sinh(x);});
+    }
+
+    static Interval cosh(const Interval& a)
+    {
+        if (a.IsNaN())
+        {
+            return NaN();
+        }
+        const Interval b = abs(a);
+        return Interval(std::max(LibmDown(std::cosh(b.lo_)), 1.0), LibmUp(std::cosh(b.hi_)));
+    }
+
+    static Interval tanh(const Interval& a)
+    {
+        const Interval r = Increasing(a, [](double x) {return std::tanh(x);});
+        return Interval(std::max(r.lo_, -1.0), std::min(r.hi_, 1.0));
+    }
+
+    // Enclosed on the positive reals, where gamma has a single minimum
+    static Interval gamma(const Interval& a)
+    {
+        static const double x_min = 1.4616321449683623;
+        static const double gamma_min = 0.8856031944108887;
+        if (a.IsNaN())
+        {
+            return NaN();
+        }
+        auto down = [](double x) {return LibmDown(std::tgamma(x), gamma_ulps);};
+        auto up = [](double x) {return LibmUp(std::tgamma(x), gamma_ulps);};
+        if (a.IsPoint())
+        {
+            return Interval(down(a.lo_), up(a.lo_));
+        }
+        if (a.lo_ <= 0)
+        {
+            return Interval(-HUGE_VAL, HUGE_VAL);
+        }
+        if (a.lo_ >= std::nextafter(x_min, HUGE_VAL))
+        {
+            return Interval(down(a.lo_), up(a.hi_));
+        }
+        if (a.hi_ <= std::nextafter(x_min, -HUGE_VAL))
+        {
+            return Interval(down(a.hi_), up(a.lo_));
+        }
+        return Interval(LibmDown(gamma_min, gamma_ulps), std::max(up(a.lo_), up(a.hi_)));
+    }
+
+    // Product of the integers up to n, gamma(n+1) for the other arguments
+    static Interval fact(const Interval& n)
+    {
+        if (n.IsPoint() && n.lo_ >= 0 && n.lo_ <= 170 && n.lo_ == std::floor(n.lo_))
+        {
+            Interval r = one();
+            for (int k = 2; k <= static_cast<int>(n.lo_); ++k)
+            {
+                r *= Interval(k);
+            }
+            return r;
+        }
+        return gamma(n + one());
+    }
+
+    // A number as the double parses it : a point interval for an integer
+    // written without fraction nor exponent below 2^53, and for 0
+    static bool parse(Interval& num, const char* begin, char* &end)
+    {
+        double value;
+        const char* e = begin;
+        if (!parse_number(value, begin, e))
+        {
+            end = const_cast<char*>(begin);
+            return false;
+        }
+        end = const_cast<char*>(e);
+        bool exact = value == 0 || (std::fabs(value) < 9007199254740992.0
+                                    && std::find_if(begin, e, [](char c) {return c == '.' || c == 'e' || c == 'E';}) == e);
+        num = exact ? Interval(value) : Interval(std::nextafter(value, -HUGE_VAL), std::nextafter(value, HUGE_VAL));
+        return true;
+    }
+
+    static char* format(char* first, char* last, const Interval& a, int prec = precision)
+    {
+        char lo[number_buffer_size], hi[number_buffer_size];
+        char* lo_end = format_number(lo, lo+sizeof(lo), a.lo_, prec);
+        char* hi_end = format_number(hi, hi+sizeof(hi), a.hi_, prec);
+        const size_t lo_size = lo_end-lo, hi_size = hi_end-hi;
+        if (a.IsNaN() || std::string(lo, lo_size) == std::string(hi, hi_size))
+        {
+            if (size_t(last-first) < lo_size)
+            {
+                return first;
+            }
+            return std::copy(lo, lo_end, first);
+        }
+        if (size_t(last-first) < lo_size+hi_size+3)
+        {
+            return first;
+        }
+        char* p = first;
+        *p++ = '[';
+        p = std::copy(lo, lo_end, p);
+        *p++ = ',';
+        p = std::copy(hi, hi_end, p);
+        *p++ = ']';
+        return p;
+    }
+
+    static std::string toString(const Interval& a)
+    {
+        char buffer[buffer_size];
+        return std::string(buffer, format(buffer, buffer+sizeof(buffer), a));
+    }
+
+private:
+    static Interval NaN()
+    {
+        return Interval(std::nan(""));
+    }
+
+    static Interval Hull(const Interval& a, const Interval& b)
+    {
+        return Interval(std::min(a.lo_, b.lo_), std::max(a.hi_, b.hi_));
+    }
+
+    static Interval Hull(const Interval& a, const Interval& b, const Interval& c, const Interval& d)
+    {
+        return Hull(Hull(a, b), Hull(c, d));
+    }
+
+    static Interval Square(const Interval& a)
+    {
+        const Interval b = abs(a);
+        return Interval(Product(b.lo_, b.lo_).lo_, Product(b.hi_, b.hi_).hi_);
+    }
+
+    // Below, the error of a product or a quotient may not be representable
+    static double Tiny()
+    {
+        return std::numeric_limits<double>::min()*9007199254740992.0;
+    }
+
+    // r, a finite result rounded to nearest or an overflow, towards -inf
+    // (+inf) when the sign of the exact result minus r is e
+    static double Down(double r, double e)
+    {
+        if (std::isinf(r))
+        {
+            return r > 0 ? DBL_MAX : r;
+        }
+        return e < 0 ? Next(r, -1) : r;
+    }
+
+    static double Up(double r, double e)
+    {
+        if (std::isinf(r))
+        {
+            return r < 0 ? -DBL_MAX : r;
+        }
+        return e > 0 ? Next(r, 1) : r;
+    }
+
+    // The double after the finite r in the direction of the sign of dir
+    // (std::nextafter without the call)
+    static double Next(double r, int dir)
+    {
+        if (r == 0)
+        {
+            return dir*std::numeric_limits<double>::denorm_min();
+        }
+        int64_t bits;
+        std::memcpy(&bits, &r, sizeof(r));
+        bits += (r > 0) == (dir > 0) ? 1 : -1;
+        std::memcpy(&r, &bits, sizeof(r));
+        return r;
+    }
+
+    // Error of the sum s = a + b (TwoSum)
+    static double SumError(double a, double b, double s)
+    {
+        const double bb = s - a;
+        return (a - (s - bb)) + (b - bb);
+    }
+
+    static double AddDown(double a, double b)
+    {
+        const double s = a + b;
+        if (!std::isfinite(a) || !std::isfinite(b))
+        {
+            return s;
+        }
+        return Down(s, std::isinf(s) ? 0 : SumError(a, b, s));
+    }
+
+    static double AddUp(double a, double b)
+    {
+        const double s = a + b;
+        if (!std::isfinite(a) || !std::isfinite(b))
+        {
+            return s;
+        }
+        return Up(s, std::isinf(s) ? 0 : SumError(a, b, s));
+    }
+
+    // Error a*b - p of the product p = a*b, with the fused multiply-add
+    // when the processor has one, by Dekker's splitting otherwise
+    static double ProductError(double a, double b, double p)
+    {
+#ifdef FP_FAST_FMA
+        return std::fma(a, b, -p);
+#else
+        if (std::fabs(a) > 1e300 || std::fabs(b) > 1e300)
+        {
+            return std::fma(a, b, -p);
+        }
+        const double split = 134217729.0; // 2^27+1
+        const double ca = split*a, cb = split*b;
+        const double ah = ca - (ca - a), al = a - ah;
+        const double bh = cb - (cb - b), bl = b - bh;
+        return ((ah*bh - p) + ah*bl + al*bh) + al*bl;
+#endif
+    }
+
+    // Bounds of a*b, 0 times an infinite bound is 0 (signed as the double)
+    static Interval Product(double a, double b)
+    {
+        if (a == 0 || b == 0)
+        {
+            return Interval(std::signbit(a) != std::signbit(b) ? -0.0 : 0.0);
+        }
+        const double p = a*b;
+        if (!std::isfinite(a) || !std::isfinite(b))
+        {
+            return Interval(p);
+        }
+        if (std::isinf(p) || std::fabs(p) < Tiny())
+        {
+            return Interval(Down(p, -1), Up(p, 1));
+        }
+        const double e = ProductError(a, b, p);
+        return Interval(Down(p, e), Up(p, e));
+    }
+
+    // Bounds of a/b, b != 0 ; the sign of a/b - q is the one of the
+    // remainder (a - q*b)/b, a - q*b being exact
+    static Interval Quotient(double a, double b)
+    {
+        const double q = a/b;
+        if (a == 0 || !std::isfinite(a) || !std::isfinite(b))
+        {
+            return Interval(q);
+        }
+        if (std::isinf(q) || std::fabs(q) < Tiny())
+        {
+            return Interval(Down(q, -1), Up(q, 1));
+        }
+        const double p = q*b;
+        const double r = (a - p) - ProductError(q, b, p);
+        const double e = b > 0 ? r : -r;
+        return Interval(Down(q, e), Up(q, e));
+    }
+
+    // Bounds of the square root of a >= 0
+    static Interval SquareRoot(double a)
+    {
+        const double s = std::sqrt(a);
+        if (a == 0 || std::isinf(a))
+        {
+            return Interval(s);
+        }
+        if (a < Tiny())
+        {
+            return Interval(Down(s, -1), Up(s, 1));
+        }
+        const double p = s*s;
+        const double e = (a - p) - ProductError(s, s, p);
+        return Interval(Down(s, e), Up(s, e));
+    }
+
+    // Bounds of the exact value of a libm result v ; 0 and the infinities
+    // are exact (the callers handle an underflow to 0)
+    static double LibmDown(double v, int ulps = libm_ulps)
+    {
+        if (v == 0 || !std::isfinite(v))
+        {
+            return v;
+        }
+        return v - (std::fabs(v)*ulps*DBL_EPSILON + ulps*std::numeric_limits<double>::denorm_min());
+    }
+
+    static double LibmUp(double v, int ulps = libm_ulps)
+    {
+        if (v == 0 || !std::isfinite(v))
+        {
+            return v;
+        }
+        return v + (std::fabs(v)*ulps*DBL_EPSILON + ulps*std::numeric_limits<double>::denorm_min());
+    }
+
+    template <typename Func>
+    static Interval Increasing(const Interval& a, Func f)
+    {
+        if (a.IsNaN())
+        {
+            return NaN();
+        }
+        return Interval(LibmDown(f(a.lo_)), LibmUp(f(a.hi_)));
+    }
+
+    // Whether a may contain (offset + k period) pi for an integer k, in
+    // the doubt (rounding of the reduction) it does
+    static bool PossiblyContains(const Interval& a, double offset, double period)
+    {
+        const double unit = Pi().lo_*period;
+        const double t_lo = a.lo_/unit - offset/period;
+        const double t_hi = a.hi_/unit - offset/period;
+        const double doubt = (std::fabs(t_lo) + std::fabs(t_hi) + 1)*1e-14;
+        return std::floor(t_hi + doubt) >= std::ceil(t_lo - doubt);
+    }
+
+    // f of period 2 pi, from -1 to 1, maximal at max_at pi + 2k pi and
+    // minimal at min_at pi + 2k pi
+    template <typename Func>
+    static Interval Periodic(const Interval& a, Func f, double max_at, double min_at)
+    {
+        if (a.IsNaN())
+        {
+            return NaN();
+        }
+        if (a.IsPoint())
+        {
+            return Interval(std::max(LibmDown(f(a.lo_)), -1.0), std::min(LibmUp(f(a.lo_)), 1.0));
+        }
+        if (!(a.Width() < 6) || std::fabs(a.lo_) > 1e15 || std::fabs(a.hi_) > 1e15)
+        {
+            return Interval(-1, 1);
+        }
+        const double f_lo = f(a.lo_), f_hi = f(a.hi_);
+        const double lo = PossiblyContains(a, min_at, 2) ? -1 : LibmDown(std::min(f_lo, f_hi));
+        const double hi = PossiblyContains(a, max_at, 2) ? 1 : LibmUp(std::max(f_lo, f_hi));
+        return Interval(std::max(lo, -1.0), std::min(hi, 1.0));
+    }
+
+    double lo_;
+    double hi_;
+};
+
+/* Free functions, found by argument dependent lookup from std::complex */
+inline Interval abs(const Interval& a) {return Interval::abs(a);}
+inline Interval sqrt(const Interval& a) {return Interval::sqrt(a);}
+inline Interval exp(const Interval& a) {return Interval::exp(a);}
+inline Interval log(const Interval& a) {return Interval::log(a);}
+inline Interval pow(const Interval& a, const Interval& b) {return Interval::pow(a, b);}
+inline Interval sin(const Interval& a) {return Interval::sin(a);}
+inline Interval cos(const Interval& a) {return Interval::cos(a);}
+inline Interval tan(const Interval& a) {return Interval::tan(a);}
+inline Interval atan(const Interval& a) {return Interval::atan(a);}
+inline Interval atan2(const Interval& y, const Interval& x) {return Interval::atan2(y, x);}
+inline Interval sinh(const Interval& a) {return Interval::sinh(a);}
+inline Interval cosh(const Interval& a) {return Interval::cosh(a);}
+inline Interval tanh(const Interval& a) {return Interval::tanh(a);}
+
+// Quotient of complex intervals, preferred to the std::complex one which
+// divides by the norm computed from the largest component (abs)
+inline std::complex<Interval> operator/(const std::complex<Interval>& a, const std::complex<Interval>& b)
+{
+    const Interval c = b.real(), d = b.imag();
+    if (d == Interval())
+    {
+        return std::complex<Interval>(a.real()/c, a.imag()/c);
+    }
+    const Interval n = Interval::pow(c, 2) + Interval::pow(d, 2);
+    return std::complex<Interval>((a.real()*c + a.imag()*d)/n, (a.imag()*c - a.real()*d)/n);
+}
+
+inline std::complex<Interval> operator/(const Interval& a, const std::complex<Interval>& b)
+{
+    return std::complex<Interval>(a)/b;
+}
+
+inline std::ostream& operator<<(std::ostream& os, const Interval& a)
+{
+    return os << Interval::toString(a);
+}
+
+#endif // H_INTERVAL
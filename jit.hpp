@@ -0,0 +1,295 @@
+#ifndef H_JIT
+#define H_JIT
+
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+#include "codegen.hpp"
+#include "reference_stack.hpp"
+#include "profiler.hpp"
+
+/**
+ ***************************************
+ * Native compilation of the hot user functions (INKAMATH_JIT).
+ *
+ * A function defined by a single scalar expression of its parameters
+ * (f(x,y)=..., no default value, no index) is compiled once it has been
+ * called threshold times : CodeGenVisitor translates its body to C++, the
+ * system compiler builds a shared object and the function is loaded with
+ * dlopen. The later calls with scalar arguments run the native code ;
+ * matrix arguments, keyword arguments, other arities and the functions
+ * using anything else than their parameters, literals, operators and
+ * native functions are evaluated by the interpreter as before.
+ * A compiled function is dropped when it is redefined and bypassed while
+ * a native function it uses is shadowed by a user definition.
+ *
+ * The compiler is $INKAMATH_JIT_CXX (c++ by default), the generated code
+ * includes numeric_interface.hpp from $INKAMATH_JIT_INCLUDE, or from
+ * INKAMATH_JIT_INCLUDE_DIR given at build time, or from the directory of
+ * this header. Compilation is synchronous and the objects are removed
+ * with the compiler.
+ ***************************************
+ */
+
+template <typename V>
+struct jit_scalar_name {
+    static const char* name() {return nullptr;}
+};
+
+template <>
+struct jit_scalar_name<double> {
+    static const char* name() {return "double";}
+};
+
+template <>
+struct jit_scalar_name<std::complex<double>> {
+    static const char* name() {return "std::complex<double>";}
+};
+
+template <typename T>
+class JitCompiler
+{
+public:
+    typedef typename T::value_type value_type;
+    typedef void (*function_type)(const value_type* args, value_type* result);
+
+    static const size_t default_threshold = 100;
+
+    JitCompiler() : threshold_(default_threshold), compiled_(0) {}
+
+    ~JitCompiler() {
+        for(void* handle : handles_) {
+            dlclose(handle);
+        }
+        for(const std::string& file : files_) {
+            std::remove(file.c_str());
+        }
+        if(!directory_.empty()) {
+            rmdir(directory_.c_str());
+        }
+    }
+
+    // Number of interpreted calls before compiling, 0 disables the compiler
+    void SetThreshold(size_t calls) {
+        threshold_ = calls;
+    }
+
+    size_t CompiledCount() const {
+        return compiled_;
+    }
+
+    // Evaluates the call through native code, returns false to let the
+    // interpreter evaluate it.
+    bool TryCall(FuncExpression<T>* expr, EvaluationVisitor<T>& evaluator, T& result) {
+        if(threshold_ == 0 || expr->m_e2()) {
+            return false;
+        }
+        ReferenceStack<T>& stack = evaluator.stack();
+        const std::string& name = expr->Name();
+        const Reference<T>* reference = stack.Find(name);
+        if(!reference || std::get<1>(reference->general_expr_) || !reference->indexed_expr_.empty()
+                || !std::get<1>(reference->single_expr_)) {
+            return false;
+        }
+
+        Entry& entry = entries_[name];
+        if(entry.body != std::get<1>(reference->single_expr_)) {
+            // new definition
+            entry = Entry();
+            entry.body = std::get<1>(reference->single_expr_);
+        }
+        if(entry.state == Entry::Unsupported) {
+            return false;
+        }
+        if(entry.state == Entry::Interpreted) {
+            if(++entry.calls < threshold_) {
+                return false;
+            }
+            entry.state = Compile(entry, std::get<0>(reference->single_expr_), stack) ? Entry::Compiled : Entry::Unsupported;
+            if(entry.state != Entry::Compiled) {
+                return false;
+            }
+        }
+        for(const std::string& native : entry.natives) {
+            if(stack.Contains(native)) {
+                return false;
+            }
+        }
+
+        ParametersCall<T> params(expr->m_e1(), PExpression<T>());
+        const std::vector<PExpression<T>>& args = params.parameters_expression();
+        if(!params.parameters_dict().empty() || args.size() != entry.names.size()) {
+            return false;
+        }
+
+        EvaluationBudget::DepthGuard depth(stack.Budget());
+        INKAMATH_PROFILE_REFERENCE(name);
+        // The arguments are evaluated as Reference::Eval does : each one
+        // sees the parameters bound before it.
+        std::unique_ptr<typename ReferenceStack<T>::Guard> guard;
+        if(args.size() > 1) {
+            guard.reset(new typename ReferenceStack<T>::Guard(stack));
+        }
+        std::vector<T> values;
+        std::vector<value_type> scalars;
+        bool scalar = true;
+        for(size_t i = 0; i < args.size(); ++i) {
+            values.push_back(evaluator.Eval(args[i]));
+            scalar = scalar && values[i].Size() == std::make_pair(size_t(1), size_t(1));
+            if(scalar) {
+                scalars.push_back(values[i](1,1));
+            }
+            if(i+1 < args.size()) {
+                stack.Set(entry.names[i], ParametersDefinition<T>(), std::make_shared<ValExpression<T>>(values[i]));
+            }
+        }
+
+        if(!scalar) {
+            if(!guard) {
+                guard.reset(new typename ReferenceStack<T>::Guard(stack));
+            }
+            if(!args.empty()) {
+                stack.Set(entry.names.back(), ParametersDefinition<T>(), std::make_shared<ValExpression<T>>(values.back()));
+            }
+            result = evaluator.Eval(entry.body);
+            return true;
+        }
+
+        value_type r;
+        entry.function(scalars.data(), &r);
+        result = T(r);
+        return true;
+    }
+
+private:
+    struct Entry {
+        enum State {Interpreted, Compiled, Unsupported};
+
+        Entry() : calls(0), state(Interpreted), function(nullptr) {}
+
+        PExpression<T> body; // keeps the compiled definition alive
+        size_t calls;
+        State state;
+        function_type function;
+        std::vector<std::string> names;
+        std::vector<std::string> natives;
+    };
+
+    bool Compile(Entry& entry, const ParametersDefinition<T>& params, ReferenceStack<T>& stack) {
+        const char* scalar = jit_scalar_name<value_type>::name();
+        if(!scalar || !params.parameters_dict().empty()) {
+            return false;
+        }
+        entry.names = params.parameters_names();
+        const std::vector<std::string>& names = entry.names;
+        auto parameter = [&names](const std::string& name) {
+            for(size_t i = 0; i < names.size(); ++i) {
+                if(names[i] == name) return int(i);
+            }
+            return -1;
+        };
+
+        std::string code;
+        try {
+            CodeGenVisitor<T> generator("S",
+                [&](const std::string& name) {
+                    int i = parameter(name);
+                    if(i < 0) throw CodeGenUnsupported("reference " + name);
+                    return "a[" + std::to_string(i) + "]";
+                },
+                [&](const std::string& name, const std::vector<std::string>& args, const std::string& index) {
+                    std::string native;
+                    if(index.empty() && parameter(name) < 0 && !stack.Contains(name) && args.size() == 1) {
+                        native = codegen_native("S", name, args[0]);
+                    }
+                    if(native.empty()) throw CodeGenUnsupported("function " + name);
+                    entry.natives.push_back(name);
+                    return native;
+                });
+            code = generator.Generate(entry.body);
+        }
+        catch(const CodeGenUnsupported&) {
+            return false;
+        }
+
+        if(directory_.empty()) {
+            const char* tmp = std::getenv("TMPDIR");
+            std::string pattern = std::string(tmp ? tmp : "/tmp") + "/inkamath-jit-XXXXXX";
+            std::vector<char> buffer(pattern.begin(), pattern.end());
+            buffer.push_back('\0');
+            if(!mkdtemp(buffer.data())) {
+                return false;
+            }
+            directory_ = buffer.data();
+        }
+        const std::string base = directory_ + "/f" + std::to_string(files_.size()/3);
+        const std::string source = base + ".cpp";
+        const std::string object = base + ".so";
+        files_.push_back(source);
+        files_.push_back(object);
+        files_.push_back(base + ".log");
+
+        FILE* file = std::fopen(source.c_str(), "w");
+        if(!file) {
+            return false;
+        }
+        std::string text = codegen_prelude()
+                + "\ntypedef " + scalar + " S;\n\n"
+                + "extern \"C\" void inkamath_jit(const S* a, S* r)\n{\n    *r = " + code + ";\n}\n";
+        const bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        std::fclose(file);
+        if(!written) {
+            return false;
+        }
+
+        const char* cxx = std::getenv("INKAMATH_JIT_CXX");
+        std::string command = std::string(cxx ? cxx : "c++")
+                + " -std=c++11 -O2 -shared -fPIC -I\"" + IncludeDirectory() + "\""
+                + " -o \"" + object + "\" \"" + source + "\" > \"" + base + ".log\" 2>&1";
+        if(std::system(command.c_str()) != 0) {
+            return false;
+        }
+        void* handle = dlopen(object.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if(!handle) {
+            return false;
+        }
+        handles_.push_back(handle);
+        entry.function = reinterpret_cast<function_type>(dlsym(handle, "inkamath_jit"));
+        if(!entry.function) {
+            return false;
+        }
+        ++compiled_;
+        return true;
+    }
+
+    static std::string IncludeDirectory() {
+        if(const char* dir = std::getenv("INKAMATH_JIT_INCLUDE")) {
+            return dir;
+        }
+#ifdef INKAMATH_JIT_INCLUDE_DIR
+        return INKAMATH_JIT_INCLUDE_DIR;
+#else
+        const std::string file = __FILE__;
+        const size_t slash = file.find_last_of('/');
+        return slash == std::string::npos ? "." : file.substr(0, slash);
+#endif
+    }
+
+    size_t threshold_;
+    size_t compiled_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::string directory_;
+    std::vector<std::string> files_;
+    std::vector<void*> handles_;
+};
+
+#endif // H_JIT
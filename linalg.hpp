@@ -0,0 +1,343 @@
+#ifndef H_LINALG
+#define H_LINALG
+
+#include <vector>
+#include <utility> // swap
+#include <stdexcept>
+
+#include "matrix.hpp"
+#include "numeric_interface.hpp"
+
+// Dense factorizations working directly on the contiguous row-major
+// buffer of Matrix<T>.
+// Indexes are 0-based here, Matrix accessors are 1-based.
+
+// LU decomposition with partial pivoting : P*A = L*U
+// L has a unit diagonal and is stored below the diagonal of U.
+// Costs about n^3/3 multiply-adds.
+template <typename T>
+class LUDecomposition
+{
+public:
+    typedef typename numeric_interface_imp_types<T>::abs magnitude_type;
+
+    explicit LUDecomposition(const Matrix<T>& a)
+        : m_lu(a), m_n(a.Size().first), m_perm(m_n), m_sign(1), m_singular(false)
+    {
+        if (a.Size().first != a.Size().second)
+        {
+            throw(std::runtime_error("LU decomposition of a non square matrix.\n"));
+        }
+
+        const size_t n = m_n;
+        T* lu = m_lu.data();
+        for (size_t i = 0; i < n; ++i) m_perm[i] = i;
+
+        for (size_t k = 0; k < n; ++k)
+        {
+            // partial pivoting
+            size_t p = k;
+            magnitude_type max = numeric_interface<T>::abs(lu[k*n+k]);
+            for (size_t i = k+1; i < n; ++i)
+            {
+                magnitude_type v = numeric_interface<T>::abs(lu[i*n+k]);
+                if (v > max)
+                {
+                    max = v;
+                    p = i;
+                }
+            }
+
+            if (max == magnitude_type(0))
+            {
+                m_singular = true;
+                continue;
+            }
+
+            if (p != k)
+            {
+                std::swap_ranges(lu+p*n, lu+p*n+n, lu+k*n);
+                std::swap(m_perm[p], m_perm[k]);
+                m_sign = -m_sign;
+            }
+
+            const T pivot = lu[k*n+k];
+            for (size_t i = k+1; i < n; ++i)
+            {
+                T* row = lu+i*n;
+                const T* pivot_row = lu+k*n;
+                const T l = row[k] / pivot;
+                row[k] = l;
+                for (size_t j = k+1; j < n; ++j)
+                {
+                    row[j] -= l*pivot_row[j];
+                }
+            }
+        }
+    }
+
+    bool IsSingular() const
+    {
+        return m_singular;
+    }
+
+    T Determinant() const
+    {
+        if (m_singular) return T(0);
+        const T* lu = m_lu.data();
+        T det = T(m_sign);
+        for (size_t k = 0; k < m_n; ++k)
+        {
+            det *= lu[k*m_n+k];
+        }
+        return det;
+    }
+
+    // Solve A*X = B
+    Matrix<T> Solve(const Matrix<T>& b) const
+    {
+        if (m_singular)
+        {
+            throw(std::runtime_error("Singular matrix.\n"));
+        }
+        if (b.Size().first != m_n)
+        {
+            throw(std::runtime_error("Incompatible dimensions in linear system.\n"));
+        }
+
+        const size_t n = m_n;
+        const size_t r = b.Size().second;
+        const T* lu = m_lu.data();
+        const Matrix<T> dense_b = b.ToDense();
+        const T* pb = dense_b.data();
+
+        Matrix<T> x(n, r);
+        T* px = x.data();
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::copy(pb+m_perm[i]*r, pb+m_perm[i]*r+r, px+i*r);
+        }
+
+        // forward substitution L*Y = P*B
+        for (size_t i = 1; i < n; ++i)
+        {
+            for (size_t k = 0; k < i; ++k)
+            {
+                const T l = lu[i*n+k];
+                for (size_t j = 0; j < r; ++j)
+                {
+                    px[i*r+j] -= l*px[k*r+j];
+                }
+            }
+        }
+
+        // backward substitution U*X = Y
+        for (size_t i = n; i-- > 0;)
+        {
+            for (size_t k = i+1; k < n; ++k)
+            {
+                const T u = lu[i*n+k];
+                for (size_t j = 0; j < r; ++j)
+                {
+                    px[i*r+j] -= u*px[k*r+j];
+                }
+            }
+            const T d = lu[i*n+i];
+            for (size_t j = 0; j < r; ++j)
+            {
+                px[i*r+j] /= d;
+            }
+        }
+        return x;
+    }
+
+    Matrix<T> Inverse() const
+    {
+        return Solve(Matrix<T>::identity(m_n));
+    }
+
+private:
+    Matrix<T> m_lu;
+    size_t m_n;
+    std::vector<size_t> m_perm;
+    int m_sign;
+    bool m_singular;
+};
+
+// QR decomposition by Householder reflections : A = Q*R
+// for a m x n matrix with m >= n. Used for least squares solutions.
+template <typename T>
+class QRDecomposition
+{
+public:
+    typedef typename numeric_interface_imp_types<T>::abs magnitude_type;
+
+    explicit QRDecomposition(const Matrix<T>& a)
+        : m_qr(a), m_m(a.Size().first), m_n(a.Size().second), m_vnorm(m_n), m_rank_deficient(false)
+    {
+        if (m_m < m_n)
+        {
+            throw(std::runtime_error("QR decomposition of an underdetermined system.\n"));
+        }
+
+        const size_t m = m_m;
+        const size_t n = m_n;
+        T* qr = m_qr.data();
+
+        for (size_t k = 0; k < n; ++k)
+        {
+            magnitude_type norm2 = 0;
+            for (size_t i = k; i < m; ++i)
+            {
+                magnitude_type v = numeric_interface<T>::abs(qr[i*n+k]);
+                norm2 += v*v;
+            }
+            magnitude_type norm = numeric_interface<magnitude_type>::sqrt(norm2);
+            if (norm == magnitude_type(0))
+            {
+                m_rank_deficient = true;
+                m_vnorm[k] = 0;
+                continue;
+            }
+
+            // v = x - alpha*e1 with alpha = -phase(x0)*|x| avoids cancellation
+            const T x0 = qr[k*n+k];
+            const magnitude_type ax0 = numeric_interface<T>::abs(x0);
+            const T phase = (ax0 == magnitude_type(0)) ? T(1) : x0/T(ax0);
+            const T alpha = -phase*T(norm);
+            qr[k*n+k] -= alpha;
+
+            magnitude_type vnorm2 = 0;
+            for (size_t i = k; i < m; ++i)
+            {
+                magnitude_type v = numeric_interface<T>::abs(qr[i*n+k]);
+                vnorm2 += v*v;
+            }
+            m_vnorm[k] = vnorm2;
+
+            // apply H = I - 2*v*v'/(v'*v) to the remaining columns
+            for (size_t j = k+1; j < n; ++j)
+            {
+                T s = T(0);
+                for (size_t i = k; i < m; ++i)
+                {
+                    s += numeric_interface<T>::conj(qr[i*n+k])*qr[i*n+j];
+                }
+                s = T(2)*s/T(vnorm2);
+                for (size_t i = k; i < m; ++i)
+                {
+                    qr[i*n+j] -= s*qr[i*n+k];
+                }
+            }
+
+            // keep v below the diagonal, store R(k,k) aside
+            m_diag.push_back(alpha);
+        }
+    }
+
+    bool IsRankDeficient() const
+    {
+        return m_rank_deficient;
+    }
+
+    // Least squares solution of A*X = B
+    Matrix<T> Solve(const Matrix<T>& b) const
+    {
+        if (m_rank_deficient)
+        {
+            throw(std::runtime_error("Rank deficient matrix.\n"));
+        }
+        if (b.Size().first != m_m)
+        {
+            throw(std::runtime_error("Incompatible dimensions in linear system.\n"));
+        }
+
+        const size_t m = m_m;
+        const size_t n = m_n;
+        const size_t r = b.Size().second;
+        const T* qr = m_qr.data();
+
+        // Y = Q'*B
+        Matrix<T> y(b);
+        T* py = y.data();
+        for (size_t k = 0; k < n; ++k)
+        {
+            for (size_t j = 0; j < r; ++j)
+            {
+                T s = T(0);
+                for (size_t i = k; i < m; ++i)
+                {
+                    s += numeric_interface<T>::conj(qr[i*n+k])*py[i*r+j];
+                }
+                s = T(2)*s/T(m_vnorm[k]);
+                for (size_t i = k; i < m; ++i)
+                {
+                    py[i*r+j] -= s*qr[i*n+k];
+                }
+            }
+        }
+
+        // R*X = Y(1:n,:)
+        Matrix<T> x(n, r);
+        T* px = x.data();
+        for (size_t i = n; i-- > 0;)
+        {
+            for (size_t j = 0; j < r; ++j)
+            {
+                T s = py[i*r+j];
+                for (size_t k = i+1; k < n; ++k)
+                {
+                    s -= qr[i*n+k]*px[k*r+j];
+                }
+                px[i*r+j] = s/m_diag[i];
+            }
+        }
+        return x;
+    }
+
+private:
+    Matrix<T> m_qr;
+    size_t m_m;
+    size_t m_n;
+    std::vector<magnitude_type> m_vnorm;
+    std::vector<T> m_diag;
+    bool m_rank_deficient;
+};
+
+// Solve A*X = B (left division A\B)
+// LU for square systems, least squares QR for overdetermined ones.
+template <typename T>
+Matrix<T> left_divide(const Matrix<T>& a, const Matrix<T>& b)
+{
+    if (a.Size().first == 1 && a.Size().second == 1)
+    {
+        // elementwise, a*(1/s) would round twice
+        const T s = a(1,1);
+        return b.Map([s](const T& x) {return x/s;});
+    }
+    else if (a.Size().first == a.Size().second)
+    {
+        return LUDecomposition<T>(a).Solve(b);
+    }
+    else
+    {
+        return QRDecomposition<T>(a).Solve(b);
+    }
+}
+
+// Solve X*B = A (right division A/B) through B.'*X.' = A.'
+template <typename T>
+Matrix<T> right_divide(const Matrix<T>& a, const Matrix<T>& b)
+{
+    if (b.Size().first == 1 && b.Size().second == 1)
+    {
+        const T s = b(1,1);
+        return a.Map([s](const T& x) {return x/s;});
+    }
+    else
+    {
+        return left_divide(b.transpose(), a.transpose()).transpose();
+    }
+}
+
+#endif // H_LINALG
@@ -2,7 +2,13 @@
 #include <iomanip>
 #include <complex>
 #include <queue>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
 #include "interpreter.hpp"
+#include "getlines.hpp"
+#include "output_buffer.hpp"
 #include "numeric_interface.hpp"
 
 /**
@@ -14,8 +20,47 @@
 
 using namespace std;
 
-int main(void)
+// Batch mode : evaluates each line of the input, skipping empty lines and
+// comments, and writes the results without prompt nor blank line.
+// Throughput is reported on the standard error.
+int batch(istream& in)
 {
+    OutputBuffer buffer(stdout);
+    ostream out(&buffer);
+    Interpreter<complex<double>> p;
+    p.SetErrorStream(out);
+
+    size_t lines = 0;
+    auto start = chrono::steady_clock::now();
+    for(auto& line : getlines(in))
+    {
+        if(!line.empty() && line.back() == '\r') line.pop_back();
+        if(line.empty() || line[0] == '#') continue;
+        out << p.Eval(line);
+        ++lines;
+    }
+    out.flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now()-start).count();
+    cerr << lines << " lines in " << seconds << " s ("
+         << (seconds > 0 ? lines/seconds : 0) << " lines/s)" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc > 1) // inkamath script.txt, or - for the standard input
+    {
+        string path = argv[1];
+        if(path == "-") return batch(cin);
+        ifstream file(path);
+        if(!file)
+        {
+            cerr << "Failed to open " << path << endl;
+            return 1;
+        }
+        return batch(file);
+    }
+
     cout << "inkamath 0.8\n" << endl;
     Interpreter<complex<double>> p;
 	
@@ -24,10 +69,72 @@ int main(void)
 		string s;
 		
 		cout << ">> ";
-		getline(cin,s);
+		if(!getline(cin,s)) break;
 
         if(s=="q") break; // quit interpreter
 
+        if(s==":alloc") { // allocations since the start or the last reset
+            AllocationTracker::Print(cout);
+            cout << endl;
+            continue;
+        }
+        if(s==":alloc reset") {
+            AllocationTracker::Reset();
+            continue;
+        }
+
+        if(s.compare(0, 6, ":load ")==0) { // :load name path
+            istringstream args(s.substr(6));
+            string name, path;
+            args >> name >> ws;
+            getline(args, path);
+            if(!Interpreter<complex<double>>::IsReferenceName(name))
+            {
+                cout << "Error : invalid reference name '" << name << "'" << endl << endl;
+                continue;
+            }
+            if(p.Load(name, path)) // the size only, the matrix might be huge
+            {
+                pair<size_t,size_t> size = p.Eval(name).Size();
+                cout << name << ": " << size.first << " x " << size.second << endl;
+            }
+            cout << endl;
+            continue;
+        }
+
+        if(s.compare(0, 6, ":save ")==0) { // snapshot of the definitions
+            p.SaveSession(s.substr(6));
+            cout << endl;
+            continue;
+        }
+        if(s.compare(0, 9, ":restore ")==0) {
+            p.RestoreSession(s.substr(9));
+            cout << endl;
+            continue;
+        }
+        if(s.compare(0, 8, ":export ")==0) { // definitions as a C++ header
+            p.ExportCpp(s.substr(8));
+            cout << endl;
+            continue;
+        }
+
+#ifdef INKAMATH_PROFILING
+        if(s==":profile") { // profile of the evaluations since the last reset
+            Profiler::Instance().Report(cout);
+            cout << endl;
+            continue;
+        }
+        if(s==":profile reset") {
+            Profiler::Instance().Reset();
+            continue;
+        }
+        if(s.compare(0, 7, ":flame ")==0) { // folded stacks for flamegraph.pl
+            ofstream file(s.substr(7));
+            Profiler::Instance().DumpFolded(file);
+            continue;
+        }
+#endif
+
         cout << p.Eval(s) << endl << endl;
     }
 	return 0;
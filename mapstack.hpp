@@ -142,9 +142,30 @@ public:
 
     bool Get(const key_type& ai_key, value_type& ao_value) const;
 
+    bool Contains(const key_type& ai_key) const {
+        return m_map.find(ai_key) != m_map.end();
+    }
+
+    // Visible value of ai_key without copy, nullptr when absent.
+    // Invalidated by the next modification of the stack.
+    const value_type* Find(const key_type& ai_key) const {
+        auto it = m_map.find(ai_key);
+        return it != m_map.end() ? &it->second.back() : nullptr;
+    }
+
 
     void Clear();
 
+    // Calls f on each value, the ones hidden by the upper levels included
+    template <typename Func>
+    void ForEachValue(Func f) {
+        for(auto& entry : m_map) {
+            for(auto& value : entry.second) {
+                f(value);
+            }
+        }
+    }
+
     struct Context {
         Context(Mapstack& parent) : parent_(parent) {
             parent_.Push();
@@ -9,49 +9,107 @@
 
 
 #include <stdexcept>
-#include <cstring> // memcpy
+#include <memory> // shared_ptr
+#include <cassert>
 
 
 #include "numeric_interface.hpp"
+#include "alloc_tracker.hpp"
+#include "elementwise.hpp"
+#include "sparse.hpp"
+
+template <typename T>
+class Matrix;
+
+template <typename T>
+Matrix<T> left_divide(const Matrix<T>& a, const Matrix<T>& b);
+
+template <typename T>
+Matrix<T> right_divide(const Matrix<T>& a, const Matrix<T>& b);
+
 
 template <typename T>
 class Matrix
 {
 public:
-    Matrix(const T& val = 0);
-    Matrix(const size_t&, const size_t&, const T& val = 0);
+    Matrix(const T& val = T());
+    // Scalar from a number of the interpreter (an index, a size)
+    template <typename V, typename = typename std::enable_if<std::is_arithmetic<V>::value>::type>
+    Matrix(V val) : Matrix(T(val)) {}
+    Matrix(const size_t&, const size_t&, const T& val = T());
     Matrix(std::vector<std::vector<T> >&);
-    Matrix(const Matrix<T>& other)
+    // Adopts a buffer of rows*cols elements (a file mapping for instance)
+    Matrix(size_t rows, size_t cols, std::shared_ptr<T> storage)
+        : m_rows(rows), m_cols(cols), m_mat(std::move(storage))
+    {}
+    // Sparse matrix, see sparse.hpp
+    Matrix(size_t rows, size_t cols, std::shared_ptr<const SparseStorage<T> > storage)
+        : m_rows(rows), m_cols(cols), m_sparse(std::move(storage))
+    {}
+
+    // Copies share the same buffer (copy-on-write).
+    // The buffer is cloned by the first mutating access on a shared matrix.
+    // A sparse matrix is converted to a dense buffer by the first mutating
+    // access, the const accesses keep it sparse.
+    Matrix(const Matrix<T>& other) = default;
+    Matrix(Matrix<T>&& other) = default;
+    Matrix<T>& operator=(const Matrix<T>& other) = default;
+    Matrix<T>& operator=(Matrix<T>&& other) = default;
+
+    std::pair<size_t,size_t> Size() const
+    {
+        return std::make_pair(m_rows,m_cols);
+    }
+    // Element i in row-major order
+    T get(size_t i) const
     {
-        m_rows = other.m_rows;
-        m_cols = other.m_cols;
-        m_mat = new T[m_rows*m_cols];
-        memcpy(m_mat,other.m_mat,m_rows*m_cols*(sizeof(T)));
+        return m_sparse ? m_sparse->At(i/m_cols, i%m_cols) : m_mat.get()[i];
     }
 
-    Matrix<T>& operator=(const Matrix<T>& other)
+    // Raw buffer of a dense matrix. A sparse matrix has none : walk its
+    // rows with ForEachRow or convert it with ToDense first.
+    const T* data() const
     {
-        Matrix<T> tmp(other);
-        std::swap(tmp.m_mat,m_mat);
-        m_rows = other.m_rows;
-        m_cols = other.m_cols;
-        return *this;
+        assert(!m_sparse);
+        return m_mat.get();
+    }
+
+    // Mutable access to the raw buffer, clones it first if it is shared
+    T* data()
+    {
+        Densify();
+        Detach();
+        return m_mat.get();
     }
 
-    ~Matrix();
+    bool IsSparse() const
+    {
+        return m_sparse != nullptr;
+    }
 
-    std::pair<size_t,size_t> Size() const
+    // Sparse storage, nullptr for a dense matrix
+    const SparseStorage<T>* Sparse() const
     {
-        return std::make_pair(m_rows,m_cols);
+        return m_sparse.get();
     }
-    const T& get(size_t i) const
+
+    size_t Nonzeros() const;
+    Matrix<T> ToSparse() const;
+    Matrix<T> ToDense() const;
+    // Sparse when worth it (SparseStorage::IsWorth), dense otherwise
+    Matrix<T> Packed() const;
+
+    bool IsShared() const
     {
-        return m_mat[i];
+        return m_sparse ? m_sparse.use_count() > 1 : m_mat.use_count() > 1;
     }
     T& operator()(const size_t&, const size_t&);
     T  operator()(const size_t&, const size_t&) const;
 
     static std::string toString(const Matrix<T>& a);
+    static std::string toString(const Matrix<T>& a, int precision);
+    // Elements of a row separated by a space, one row per line
+    void Write(std::ostream& os, int precision = numeric_interface<T>::precision) const;
     static int toInt(const Matrix<T>& a);
     static T toT(const Matrix<T>& a);
 
@@ -61,9 +119,53 @@ public:
     template <typename Func>
     Matrix<T> BinaryOp(const Matrix<T>&) const ;
 
+    // Elementwise application of f on the contiguous buffer
+    // (on the nonzeros of a sparse matrix when f(0) is 0)
+    template <typename Func>
+    Matrix<T> Map(Func f) const
+    {
+        if (m_rows == 1 && m_cols == 1 && !m_sparse)
+        {
+            return Matrix<T>(f(*m_mat));
+        }
+        if (m_sparse && f(T(0)) == T(0))
+        {
+            std::shared_ptr<SparseStorage<T> > c = std::make_shared<SparseStorage<T> >(m_rows, m_cols);
+            c->row_begin = m_sparse->row_begin;
+            c->columns = m_sparse->columns;
+            c->values.resize(m_sparse->values.size());
+            std::transform(m_sparse->values.begin(), m_sparse->values.end(), c->values.begin(), f);
+            c->Record();
+            return Matrix<T>(m_rows, m_cols, std::shared_ptr<const SparseStorage<T> >(c));
+        }
+        Matrix<T> c(m_rows, m_cols, Allocate(m_rows*m_cols));
+        T* pc = c.m_mat.get();
+        if (m_sparse)
+        {
+            ForEachRow([&](size_t i, const T* row) {
+                std::transform(row, row+m_cols, pc+i*m_cols, f);
+            });
+            return c;
+        }
+        const T* pa = m_mat.get();
+        Elementwise::For(m_rows*m_cols, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                pc[i] = f(pa[i]);
+            }
+        });
+        return c;
+    }
+
 
     Matrix<T> mul(const Matrix<T>& other) const;
 
+    // Product of each element by s, on the right
+    Matrix<T> Scale(const T& s) const
+    {
+        return Map([s](const T& x) {return x*s;});
+    }
+
     /* Implementation de Numerical interface */
     static Matrix<T>  pow(const Matrix<T> & a, const Matrix<T> & b)
     {
@@ -75,10 +177,25 @@ public:
             }
             else
             {
-                Matrix<T> r = a;
-                for(int i = 1; i < numeric_interface<T>::toInt(b(1,1)); ++i)
+                int n = numeric_interface<T>::toInt(b(1,1));
+                if(numeric_interface<T>::abs(b(1,1) - T(n)) != 0)
                 {
-                    r = r*r;
+                    throw(std::runtime_error("Non integer power is not implemented for Matrix type."));
+                }
+
+                // exponentiation by squaring, negative powers of the inverse
+                Matrix<T> x = (n < 0) ? inv(a) : a;
+                Matrix<T> r = identity(a.m_rows);
+                for(unsigned int k = (n < 0) ? -n : n; k != 0; k >>= 1)
+                {
+                    if(k & 1)
+                    {
+                        r = r*x;
+                    }
+                    if(k > 1)
+                    {
+                        x = x*x;
+                    }
                 }
                 return r;
             }
@@ -89,16 +206,10 @@ public:
         }
     }
 
+    // Elementwise factorial
     static typename numeric_interface_imp_types<Matrix<T> >::fact fact(const Matrix<T>& a)
     {
-        if (a.m_rows == 1 && a.m_cols == 1 )
-        {
-            return numeric_interface<T>::fact(a(1,1));
-        }
-        else
-        {
-            throw(std::runtime_error("Fact is not implemented for Matrix type."));
-        }
+        return a.Map([](const T& x) {return T(numeric_interface<T>::fact(x));});
     }
 
 	static typename numeric_interface_imp_types<Matrix<T> >::abs abs(const Matrix<T>& a)
@@ -118,6 +229,37 @@ public:
 		throw(std::runtime_error("Sqrt is not implemented for Matrix type."));
 	}
 
+    static Matrix<T> identity(size_t n)
+    {
+        Matrix<T> r(n, n);
+        for (size_t i = 1; i <= n; ++i) r(i,i) = T(1);
+        return r;
+    }
+
+    Matrix<T> transpose() const
+    {
+        if (m_sparse)
+        {
+            return SparseTranspose();
+        }
+        Matrix<T> r(m_cols, m_rows);
+        T* pr = r.data();
+        const T* pm = m_mat.get();
+        for (size_t i = 0; i < m_rows; ++i)
+        {
+            for (size_t j = 0; j < m_cols; ++j)
+            {
+                pr[j*m_rows+i] = pm[i*m_cols+j];
+            }
+        }
+        return r;
+    }
+
+    /* Linear algebra (see linalg.hpp) */
+    static Matrix<T> inv(const Matrix<T>& a);
+    static Matrix<T> det(const Matrix<T>& a);
+    static Matrix<T> solve(const Matrix<T>& a, const Matrix<T>& b);
+
     /* Symetric operators */
     friend Matrix<T> operator*(const Matrix<T>& a, const Matrix<T>& b)
     {
@@ -139,24 +281,85 @@ public:
         return UnaryOp<std::negate<value_type> >(*this);
     }
 
+    // Right division : solve X*b = a
     friend Matrix<T> operator/(const Matrix<T>& a, const Matrix<T>& b)
     {
-        return a.BinaryOp<std::divides<value_type> >(b);
+        return right_divide(a, b);
     }
 
     typedef T value_type;
 
+    // Calls f(i, row) for each row i with the row elements in a contiguous
+    // buffer (expanded for a sparse matrix)
+    template <typename Func>
+    void ForEachRow(Func f) const
+    {
+        if (m_sparse)
+        {
+            std::vector<T> row(m_cols);
+            for (size_t i = 0; i < m_rows; ++i)
+            {
+                m_sparse->ExpandRow(i, row.data());
+                f(i, const_cast<const T*>(row.data()));
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < m_rows; ++i)
+            {
+                f(i, const_cast<const T*>(m_mat.get()+i*m_cols));
+            }
+        }
+    }
+
 protected:
+    static std::shared_ptr<T> Allocate(size_t size)
+    {
+        AllocationTracker::Record(AllocMatrix, size*sizeof(T));
+        return std::shared_ptr<T>(new T[size], std::default_delete<T[]>());
+    }
+
+    // Replaces the sparse storage by a dense buffer
+    void Densify()
+    {
+        if (m_sparse)
+        {
+            std::shared_ptr<T> mat = Allocate(m_rows*m_cols);
+            for (size_t i = 0; i < m_rows; ++i)
+            {
+                m_sparse->ExpandRow(i, mat.get()+i*m_cols);
+            }
+            m_mat = std::move(mat);
+            m_sparse.reset();
+        }
+    }
+
+    Matrix<T> SparseTranspose() const;
+    template <typename Func>
+    Matrix<T> SparseBinaryOp(const Matrix<T>& other, Func f) const;
+    Matrix<T> SparseMul(const Matrix<T>& other) const;
+
+    void Detach()
+    {
+        if(IsShared())
+        {
+            std::shared_ptr<T> mat = Allocate(m_rows*m_cols);
+            std::copy(m_mat.get(), m_mat.get()+m_rows*m_cols, mat.get());
+            m_mat = std::move(mat);
+        }
+    }
+
     size_t m_rows;
     size_t m_cols;
 
-    T* m_mat;
+    std::shared_ptr<T> m_mat;
+    std::shared_ptr<const SparseStorage<T> > m_sparse;
 };
 
 template <typename T>
 struct numeric_interface_imp_types<Matrix<T> >
 {
-	typedef typename numeric_interface_imp_types<T>::fact fact;
+	typedef Matrix<T> fact;
 	typedef typename numeric_interface_imp_types<T>::abs abs;
 	typedef typename numeric_interface_imp_types<T>::sqrt sqrt;
 };
@@ -165,19 +368,19 @@ template <typename T>
 Matrix<T>::Matrix(const T& val)
 {
     m_rows=m_cols=1;
-    m_mat = new T[1];
+    m_mat = Allocate(1);
     *m_mat = val;
 }
 
 template <typename T>
 Matrix<T>::Matrix(const size_t& rows, const size_t& cols, const T& val) : m_rows(rows), m_cols(cols)
 {
-    m_mat = new T[m_rows*m_cols];
-    for (size_t i = 0; i < m_rows*cols; ++i) m_mat[i] = val;
+    m_mat = Allocate(m_rows*m_cols);
+    std::fill_n(m_mat.get(), m_rows*m_cols, val);
 }
 
 template <typename T>
-Matrix<T>::Matrix(std::vector<std::vector<T > >& mat) : m_rows(0), m_cols(0), m_mat(0)
+Matrix<T>::Matrix(std::vector<std::vector<T > >& mat) : m_rows(0), m_cols(0), m_mat()
 {
     m_rows=mat.size();
 
@@ -186,9 +389,7 @@ Matrix<T>::Matrix(std::vector<std::vector<T > >& mat) : m_rows(0), m_cols(0), m_
         m_cols = std::max(mat.at(i).size(),m_cols);
     }
 
-	// todo : reimplement this matrix class...
-    m_mat = new T[m_rows*m_cols];
-	// m_mat migth be leaked within this constructor
+    m_mat = Allocate(m_rows*m_cols);
 
     for (size_t i = 0; i < m_rows; ++i)
     {
@@ -207,18 +408,14 @@ Matrix<T>::Matrix(std::vector<std::vector<T > >& mat) : m_rows(0), m_cols(0), m_
     }
 }
 
-template <typename T>
-Matrix<T>::~Matrix()
-{
-    delete[] m_mat;
-}
-
 template <typename T>
 T & Matrix<T>::operator()(const size_t& i, const size_t& j)
 {
     if (i > 0 && i<=m_rows && j > 0 && j<=m_cols)
     {
-        return m_mat[(i-1)*m_cols+(j-1)];
+        Densify();
+        Detach();
+        return m_mat.get()[(i-1)*m_cols+(j-1)];
     }
     else // Erreur !
     {
@@ -231,7 +428,11 @@ T Matrix<T>::operator()(const size_t& i, const size_t& j) const
 {
     if (i > 0 && i<=m_rows && j > 0 && j<=m_cols)
     {
-        return m_mat[(i-1)*m_cols+(j-1)];
+        if (m_sparse)
+        {
+            return m_sparse->At(i-1, j-1);
+        }
+        return m_mat.get()[(i-1)*m_cols+(j-1)];
     }
     else // Erreur !
     {
@@ -244,21 +445,21 @@ Matrix<T> Matrix<T>::mul(const Matrix<T>& other) const
 {
     if (m_cols == 1 && m_rows == 1)
     {
-        Matrix<T> c(other);
-        std::transform(c.m_mat,c.m_mat+c.m_rows*c.m_cols,c.m_mat, std::bind2nd(std::multiplies<value_type>(),operator()(1,1)));
-        return c;
+        return other.Scale(get(0));
     }
     else if (other.m_cols == 1 && other.m_rows ==1)
     {
-        Matrix<T> c(*this);
-        std::transform(c.m_mat,c.m_mat+c.m_rows*c.m_cols,c.m_mat, std::bind2nd(std::multiplies<value_type>(),other(1,1)));
-        return c;
+        return Scale(other.get(0));
     }
     else if (m_cols != other.m_rows)
     {
         /* exception : dimensions des matrices non compatibles */
         throw(std::runtime_error("Incompatible dimensions in matrix product.\n"));
     }
+    else if (m_sparse || other.m_sparse)
+    {
+        return SparseMul(other);
+    }
     else
     {
         Matrix<T> c(m_rows, other.m_cols);
@@ -280,20 +481,37 @@ Matrix<T> Matrix<T>::mul(const Matrix<T>& other) const
 template <typename T>
 std::string Matrix<T>::toString(const Matrix<T>& a)
 {
-	const int MyPrec = 10;
-    size_t i,j;
-    std::ostringstream oss;
-	oss << std::fixed;
-	oss << std::setprecision(MyPrec);
-    for (i=1 ; i<=a.m_rows ; ++i)
-    {
-        for (j=1 ; j<a.m_cols ; ++j)
+    return toString(a, numeric_interface<T>::precision);
+}
+
+template <typename T>
+std::string Matrix<T>::toString(const Matrix<T>& a, int precision)
+{
+    std::string s;
+    char buffer[numeric_interface<T>::buffer_size];
+    a.ForEachRow([&](size_t, const T* p) {
+        for (size_t j=0 ; j<a.m_cols ; ++j)
         {
-            oss << numeric_interface<T>::toString(a(i,j)) << " ";
+            char* end = numeric_interface<T>::format(buffer, buffer+sizeof(buffer)-1, *p++, precision);
+            *end++ = (j+1 < a.m_cols) ? ' ' : '\n';
+            s.append(buffer, end);
         }
-        oss << numeric_interface<T>::toString(a(i,j)) << "\n";
-    }
-    return oss.str();
+    });
+    return s;
+}
+
+template <typename T>
+void Matrix<T>::Write(std::ostream& os, int precision) const
+{
+    char buffer[numeric_interface<T>::buffer_size];
+    ForEachRow([&](size_t, const T* p) {
+        for (size_t j=0 ; j<m_cols ; ++j)
+        {
+            char* end = numeric_interface<T>::format(buffer, buffer+sizeof(buffer)-1, *p++, precision);
+            *end++ = (j+1 < m_cols) ? ' ' : '\n';
+            os.write(buffer, end-buffer);
+        }
+    });
 }
 
 template <typename T>
@@ -306,7 +524,7 @@ int Matrix<T>::toInt(const Matrix<T>& a)
 {
     if (a.m_rows == 1 && a.m_cols == 1)
     {
-        return numeric_interface<T>::toInt(*a.m_mat);
+        return numeric_interface<T>::toInt(a(1,1));
     }
     else
     {
@@ -319,7 +537,7 @@ T Matrix<T>::toT(const Matrix<T>& a)
 {
     if (a.m_rows == 1 && a.m_cols == 1)
     {
-        return *a.m_mat;
+        return a(1,1);
     }
     else
     {
@@ -330,49 +548,310 @@ T Matrix<T>::toT(const Matrix<T>& a)
 
 template <typename T> template <typename Func>
 Matrix<T> Matrix<T>::UnaryOp(const Matrix<T>& other) const
+{
+    return other.Map(Func());
+}
+
+template <typename T> template <typename Func>
+Matrix<T> Matrix<T>::BinaryOp(const Matrix<T>& other) const
 {
     Func f;
-    Matrix<T> c(other.m_rows,other.m_cols);
-    for (size_t i = 1; i <= c.m_rows; ++i)
+    if (m_rows == 1 && m_cols == 1 && other.m_rows == 1 && other.m_cols == 1 && !m_sparse && !other.m_sparse)
     {
-        for (size_t j = 1; j<= c.m_cols; ++j)
+        // scalars, the usual operands of the interpreter
+        return Matrix<T>(f(*m_mat, *other.m_mat));
+    }
+    else if (m_rows == other.m_rows && m_cols == other.m_cols && (m_sparse || other.m_sparse))
+    {
+        return SparseBinaryOp(other, f);
+    }
+    else if (m_rows == other.m_rows && m_cols == other.m_cols)
+    {
+        Matrix<T> c(m_rows, m_cols, Allocate(m_rows*m_cols));
+        const T* pa = m_mat.get();
+        const T* pb = other.m_mat.get();
+        T* pc = c.m_mat.get();
+        Elementwise::For(m_rows*m_cols, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                pc[i] = f(pa[i], pb[i]);
+            }
+        });
+        return c;
+    }
+    else
+    {
+        throw(std::runtime_error("Incompatible dimensions in matrix operation.\n"));
+    }
+}
+
+template <typename T>
+size_t Matrix<T>::Nonzeros() const
+{
+    if (m_sparse)
+    {
+        return m_sparse->Nonzeros();
+    }
+    const T* p = m_mat.get();
+    return m_rows*m_cols - std::count(p, p+m_rows*m_cols, T(0));
+}
+
+template <typename T>
+Matrix<T> Matrix<T>::ToSparse() const
+{
+    if (m_sparse)
+    {
+        return *this;
+    }
+    std::shared_ptr<SparseStorage<T> > s = std::make_shared<SparseStorage<T> >(m_rows, m_cols);
+    const T* p = m_mat.get();
+    for (size_t i = 0; i < m_rows; ++i)
+    {
+        for (size_t j = 0; j < m_cols; ++j, ++p)
         {
-            c(i,j) = f(other(i,j));
+            if (*p != T(0))
+            {
+                s->Push(j, *p);
+            }
         }
+        s->EndRow(i);
     }
-    return c;
+    s->Record();
+    return Matrix<T>(m_rows, m_cols, std::shared_ptr<const SparseStorage<T> >(s));
+}
+
+template <typename T>
+Matrix<T> Matrix<T>::ToDense() const
+{
+    Matrix<T> r(*this);
+    r.Densify();
+    return r;
+}
+
+template <typename T>
+Matrix<T> Matrix<T>::Packed() const
+{
+    bool worth = SparseStorage<T>::IsWorth(m_rows, m_cols, Nonzeros());
+    if (worth == IsSparse())
+    {
+        return *this;
+    }
+    return worth ? ToSparse() : ToDense();
+}
+
+template <typename T>
+Matrix<T> Matrix<T>::SparseTranspose() const
+{
+    const SparseStorage<T>& a = *m_sparse;
+    std::shared_ptr<SparseStorage<T> > t = std::make_shared<SparseStorage<T> >(m_cols, m_rows);
+    // counting sort of the elements by column
+    for (size_t k = 0; k < a.Nonzeros(); ++k)
+    {
+        ++t->row_begin[a.columns[k]+1];
+    }
+    for (size_t j = 0; j < m_cols; ++j)
+    {
+        t->row_begin[j+1] += t->row_begin[j];
+    }
+    t->columns.resize(a.Nonzeros());
+    t->values.resize(a.Nonzeros());
+    std::vector<size_t> next(t->row_begin.begin(), t->row_begin.end()-1);
+    for (size_t i = 0; i < m_rows; ++i)
+    {
+        for (size_t k = a.row_begin[i]; k < a.row_begin[i+1]; ++k)
+        {
+            size_t& n = next[a.columns[k]];
+            t->columns[n] = i;
+            t->values[n] = a.values[k];
+            ++n;
+        }
+    }
+    t->Record();
+    return Matrix<T>(m_cols, m_rows, std::shared_ptr<const SparseStorage<T> >(t));
 }
 
 template <typename T> template <typename Func>
-Matrix<T> Matrix<T>::BinaryOp(const Matrix<T>& other) const
+Matrix<T> Matrix<T>::SparseBinaryOp(const Matrix<T>& other, Func f) const
 {
-    Func f;
-    if (m_rows == other.m_rows && m_cols == other.m_cols)
+    if (m_sparse && other.m_sparse && f(T(0), T(0)) == T(0))
+    {
+        // merge of the rows, the result elements at 0 are dropped
+        const SparseStorage<T>& a = *m_sparse;
+        const SparseStorage<T>& b = *other.m_sparse;
+        std::shared_ptr<SparseStorage<T> > c = std::make_shared<SparseStorage<T> >(m_rows, m_cols);
+        auto push = [&c](size_t j, const T& value) {
+            if (value != T(0))
+            {
+                c->Push(j, value);
+            }
+        };
+        for (size_t i = 0; i < m_rows; ++i)
+        {
+            size_t ka = a.row_begin[i], kb = b.row_begin[i];
+            const size_t ea = a.row_begin[i+1], eb = b.row_begin[i+1];
+            while (ka < ea || kb < eb)
+            {
+                if (kb == eb || (ka < ea && a.columns[ka] < b.columns[kb]))
+                {
+                    push(a.columns[ka], f(a.values[ka], T(0)));
+                    ++ka;
+                }
+                else if (ka == ea || b.columns[kb] < a.columns[ka])
+                {
+                    push(b.columns[kb], f(T(0), b.values[kb]));
+                    ++kb;
+                }
+                else
+                {
+                    push(a.columns[ka], f(a.values[ka], b.values[kb]));
+                    ++ka;
+                    ++kb;
+                }
+            }
+            c->EndRow(i);
+        }
+        c->Record();
+        return Matrix<T>(m_rows, m_cols, std::shared_ptr<const SparseStorage<T> >(c)).Packed();
+    }
+    // dense result, the sparse rows are expanded one at a time
+    Matrix<T> c(m_rows, m_cols, Allocate(m_rows*m_cols));
+    T* pc = c.m_mat.get();
+    std::vector<T> row(m_sparse ? m_cols : 0);
+    std::vector<T> other_row(other.m_sparse ? m_cols : 0);
+    for (size_t i = 0; i < m_rows; ++i)
+    {
+        const T* pa = m_mat.get()+i*m_cols;
+        const T* pb = other.m_mat.get()+i*m_cols;
+        if (m_sparse)
+        {
+            m_sparse->ExpandRow(i, row.data());
+            pa = row.data();
+        }
+        if (other.m_sparse)
+        {
+            other.m_sparse->ExpandRow(i, other_row.data());
+            pb = other_row.data();
+        }
+        for (size_t j = 0; j < m_cols; ++j)
+        {
+            pc[i*m_cols+j] = f(pa[j], pb[j]);
+        }
+    }
+    return c;
+}
+
+template <typename T>
+Matrix<T> Matrix<T>::SparseMul(const Matrix<T>& other) const
+{
+    const size_t n = other.m_cols;
+    if (m_sparse && other.m_sparse)
     {
-        Matrix<T> c(m_rows,m_cols);
-        for (size_t i = 1; i <= c.m_rows; ++i)
+        // Gustavson : row i of the product accumulates the rows k of other
+        // for the nonzeros (i, k) of this matrix
+        const SparseStorage<T>& a = *m_sparse;
+        const SparseStorage<T>& b = *other.m_sparse;
+        std::shared_ptr<SparseStorage<T> > c = std::make_shared<SparseStorage<T> >(m_rows, n);
+        std::vector<T> acc(n, T(0));
+        std::vector<bool> used(n, false);
+        std::vector<size_t> touched;
+        for (size_t i = 0; i < m_rows; ++i)
         {
-            for (size_t j = 1; j<= c.m_cols; ++j)
+            for (size_t ka = a.row_begin[i]; ka < a.row_begin[i+1]; ++ka)
             {
-                c(i,j) = f(operator()(i,j),other(i,j));
+                const size_t k = a.columns[ka];
+                for (size_t kb = b.row_begin[k]; kb < b.row_begin[k+1]; ++kb)
+                {
+                    const size_t j = b.columns[kb];
+                    if (!used[j])
+                    {
+                        used[j] = true;
+                        touched.push_back(j);
+                    }
+                    acc[j] += a.values[ka]*b.values[kb];
+                }
+            }
+            std::sort(touched.begin(), touched.end());
+            for (size_t j : touched)
+            {
+                if (acc[j] != T(0))
+                {
+                    c->Push(j, acc[j]);
+                }
+                acc[j] = T(0);
+                used[j] = false;
+            }
+            touched.clear();
+            c->EndRow(i);
+        }
+        c->Record();
+        return Matrix<T>(m_rows, n, std::shared_ptr<const SparseStorage<T> >(c)).Packed();
+    }
+    Matrix<T> c(m_rows, n, T(0));
+    T* pc = c.m_mat.get();
+    if (m_sparse)
+    {
+        // row i of the product : sum of the rows k of other
+        const SparseStorage<T>& a = *m_sparse;
+        const T* pb = other.m_mat.get();
+        for (size_t i = 0; i < m_rows; ++i)
+        {
+            for (size_t ka = a.row_begin[i]; ka < a.row_begin[i+1]; ++ka)
+            {
+                const T& v = a.values[ka];
+                const T* row = pb+a.columns[ka]*n;
+                for (size_t j = 0; j < n; ++j)
+                {
+                    pc[i*n+j] += v*row[j];
+                }
             }
         }
-        return c;
     }
     else
     {
-        throw(std::runtime_error("Incompatible dimensions in matrix operation.\n"));
+        // element (i, k) of this matrix times row k of other
+        const SparseStorage<T>& b = *other.m_sparse;
+        const T* pa = m_mat.get();
+        for (size_t i = 0; i < m_rows; ++i)
+        {
+            for (size_t k = 0; k < m_cols; ++k)
+            {
+                const T& v = pa[i*m_cols+k];
+                for (size_t kb = b.row_begin[k]; kb < b.row_begin[k+1]; ++kb)
+                {
+                    pc[i*n+b.columns[kb]] += v*b.values[kb];
+                }
+            }
+        }
     }
+    return c;
 }
 
 
 template <typename T>
 std::ostream& operator <<(std::ostream& Stream, const Matrix<T>& Obj)
 {
-	static const int PREC = 10;
-	Stream.setf(std::ios::fixed,std::ios::floatfield);
-	Stream.precision(PREC);
-    return Stream << Matrix<T>::toString(Obj);
+    Obj.Write(Stream);
+    return Stream;
+}
+
+#include "linalg.hpp"
+
+template <typename T>
+Matrix<T> Matrix<T>::inv(const Matrix<T>& a)
+{
+    return LUDecomposition<T>(a).Inverse();
+}
+
+template <typename T>
+Matrix<T> Matrix<T>::det(const Matrix<T>& a)
+{
+    return LUDecomposition<T>(a).Determinant();
+}
+
+template <typename T>
+Matrix<T> Matrix<T>::solve(const Matrix<T>& a, const Matrix<T>& b)
+{
+    return left_divide(a, b);
 }
 
 #endif
@@ -0,0 +1,332 @@
+#ifndef H_MATRIX_IO
+#define H_MATRIX_IO
+
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define INKAMATH_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "matrix.hpp"
+#include "number_parse.hpp"
+
+/**
+ ***************************************
+ * Matrix files.
+ *
+ * Binary : a 32 bytes header followed by the row-major elements,
+ * everything little-endian.
+ *   offset 0  : "INKAMAT1"
+ *   offset 8  : uint32 element type (1 : float64, 2 : complex128 as re, im)
+ *   offset 12 : uint32 reserved, 0
+ *   offset 16 : uint64 rows
+ *   offset 24 : uint64 columns
+ * When the element type is the one of the matrix (and the host is
+ * little-endian) the matrix uses the mapped file directly without copy.
+ * The mapping is private : writing to the matrix never changes the file.
+ *
+ * CSV : one row per line, numbers separated by ',', ';', spaces or tabs.
+ ***************************************
+ */
+
+// Read-only view of a whole file, mapped in memory when possible.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path) : m_data(nullptr), m_size(0), m_mapped(false)
+    {
+#ifdef INKAMATH_USE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Failed to open " + path + ".\n");
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Failed to read " + path + ".\n");
+        }
+        m_size = size_t(st.st_size);
+        if (m_size > 0)
+        {
+            // private writable pages : copy-on-write by the system
+            void* p = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Failed to map " + path + ".\n");
+            }
+            m_data = static_cast<char*>(p);
+            m_mapped = true;
+        }
+        ::close(fd);
+#else
+        std::ifstream file(path.c_str(), std::ios::binary);
+        if (!file) throw std::runtime_error("Failed to open " + path + ".\n");
+        file.seekg(0, std::ios::end);
+        m_size = size_t(file.tellg());
+        file.seekg(0, std::ios::beg);
+        m_buffer.resize(m_size);
+        if (m_size > 0 && !file.read(&m_buffer[0], m_size))
+        {
+            throw std::runtime_error("Failed to read " + path + ".\n");
+        }
+        m_data = m_size > 0 ? &m_buffer[0] : nullptr;
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifdef INKAMATH_USE_MMAP
+        if (m_mapped) ::munmap(m_data, m_size);
+#endif
+    }
+
+    char* data() {return m_data;}
+    size_t size() const {return m_size;}
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::vector<char> m_buffer;
+};
+
+namespace matrix_io {
+
+static const char magic[8] = {'I','N','K','A','M','A','T','1'};
+static const size_t header_size = 32;
+
+enum ElementType : uint32_t {Float64 = 1, Complex128 = 2};
+
+inline bool little_endian()
+{
+    const uint16_t one = 1;
+    unsigned char c;
+    std::memcpy(&c, &one, 1);
+    return c == 1;
+}
+
+inline uint64_t read_le(const char* p, size_t bytes)
+{
+    uint64_t v = 0;
+    for (size_t i = bytes; i-- > 0;)
+    {
+        v = (v << 8) | uint64_t(static_cast<unsigned char>(p[i]));
+    }
+    return v;
+}
+
+inline void write_le(char* p, uint64_t v, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        p[i] = char(v & 0xff);
+        v >>= 8;
+    }
+}
+
+inline double read_double(const char* p)
+{
+    uint64_t bits = read_le(p, 8);
+    double d;
+    std::memcpy(&d, &bits, 8);
+    return d;
+}
+
+template <typename T>
+struct element_traits;
+
+template <>
+struct element_traits<double>
+{
+    static const uint32_t type = Float64;
+    static double convert(const char* p, uint32_t file_type)
+    {
+        if (file_type != Float64)
+        {
+            throw std::runtime_error("Complex data in a real matrix.\n");
+        }
+        return read_double(p);
+    }
+};
+
+template <>
+struct element_traits<std::complex<double>>
+{
+    static const uint32_t type = Complex128;
+    static std::complex<double> convert(const char* p, uint32_t file_type)
+    {
+        if (file_type == Float64) return std::complex<double>(read_double(p), 0);
+        return std::complex<double>(read_double(p), read_double(p+8));
+    }
+};
+
+inline size_t element_size(uint32_t type)
+{
+    switch (type)
+    {
+    case Float64: return 8;
+    case Complex128: return 16;
+    default: throw std::runtime_error("Unknown element type in matrix file.\n");
+    }
+}
+
+} // namespace matrix_io
+
+template <typename T>
+Matrix<T> load_matrix_binary(const std::string& path)
+{
+    using namespace matrix_io;
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(path);
+    const char* p = file->data();
+    if (file->size() < header_size || std::memcmp(p, magic, sizeof(magic)) != 0)
+    {
+        throw std::runtime_error(path + " is not a matrix file.\n");
+    }
+    const uint32_t type = uint32_t(read_le(p+8, 4));
+    const uint64_t rows = read_le(p+16, 8);
+    const uint64_t cols = read_le(p+24, 8);
+    const size_t size = element_size(type);
+    if (rows == 0 || cols == 0 || cols > (file->size()-header_size)/size/rows
+        || rows*cols*size != file->size()-header_size)
+    {
+        throw std::runtime_error(path + " has an invalid size.\n");
+    }
+
+    if (type == element_traits<T>::type && size == sizeof(T) && little_endian())
+    {
+        // zero copy : the matrix keeps the file alive
+        T* data = reinterpret_cast<T*>(file->data()+header_size);
+        return Matrix<T>(size_t(rows), size_t(cols), std::shared_ptr<T>(file, data));
+    }
+
+    Matrix<T> m(static_cast<size_t>(rows), static_cast<size_t>(cols));
+    T* data = m.data();
+    const char* e = p+header_size;
+    for (size_t i = 0; i < rows*cols; ++i, e += size)
+    {
+        data[i] = element_traits<T>::convert(e, type);
+    }
+    return m;
+}
+
+template <typename T>
+void save_matrix_binary(const std::string& path, const Matrix<T>& m)
+{
+    using namespace matrix_io;
+    char header[header_size] = {};
+    std::memcpy(header, magic, sizeof(magic));
+    write_le(header+8, element_traits<T>::type, 4);
+    write_le(header+16, m.Size().first, 8);
+    write_le(header+24, m.Size().second, 8);
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    if (!file) throw std::runtime_error("Failed to open " + path + ".\n");
+    file.write(header, header_size);
+    // row by row : a sparse matrix is expanded one row at a time
+    const size_t row_bytes = m.Size().second*sizeof(T);
+    m.ForEachRow([&](size_t, const T* row) {
+        if (little_endian())
+        {
+            file.write(reinterpret_cast<const char*>(row), row_bytes);
+        }
+        else
+        {
+            const double* d = reinterpret_cast<const double*>(row);
+            char le[8];
+            for (size_t i = 0; i < row_bytes/8; ++i)
+            {
+                uint64_t bits;
+                std::memcpy(&bits, d+i, 8);
+                write_le(le, bits, 8);
+                file.write(le, 8);
+            }
+        }
+    });
+    if (!file) throw std::runtime_error("Failed to write " + path + ".\n");
+}
+
+template <typename T>
+Matrix<T> load_matrix_csv(const std::string& path)
+{
+    MappedFile file(path);
+    const char* p = file.data();
+    const char* end = p+file.size();
+    std::vector<double> values;
+    size_t rows = 0;
+    size_t cols = 0;
+    std::string number; // numbers are parsed from a NUL terminated copy
+    while (p < end)
+    {
+        // one line
+        size_t count = 0;
+        while (p < end && *p != '\n')
+        {
+            if (*p == ',' || *p == ';' || *p == ' ' || *p == '\t' || *p == '\r')
+            {
+                ++p;
+                continue;
+            }
+            const char* q = p;
+            while (q < end && *q != ',' && *q != ';' && *q != ' ' && *q != '\t' && *q != '\r' && *q != '\n') ++q;
+            number.assign(p, q);
+            double v;
+            const char* e;
+            if (!parse_number(v, number.c_str(), e) || *e != '\0')
+            {
+                throw std::runtime_error("Invalid number '" + number + "' in " + path + ".\n");
+            }
+            values.push_back(v);
+            ++count;
+            p = q;
+        }
+        if (p < end) ++p; // '\n'
+        if (count == 0) continue; // blank line
+        if (rows > 0 && count != cols)
+        {
+            throw std::runtime_error("Rows of different lengths in " + path + ".\n");
+        }
+        cols = count;
+        ++rows;
+    }
+    if (rows == 0)
+    {
+        throw std::runtime_error(path + " is empty.\n");
+    }
+
+    Matrix<T> m(rows, cols);
+    T* data = m.data();
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        data[i] = T(values[i]);
+    }
+    return m;
+}
+
+// CSV for the .csv extension, binary otherwise
+template <typename T>
+Matrix<T> load_matrix(const std::string& path)
+{
+    const std::string csv = ".csv";
+    if (path.size() >= csv.size() && path.compare(path.size()-csv.size(), csv.size(), csv) == 0)
+    {
+        return load_matrix_csv<T>(path);
+    }
+    return load_matrix_binary<T>(path);
+}
+
+#endif // H_MATRIX_IO
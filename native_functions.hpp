@@ -0,0 +1,86 @@
+#ifndef H_NATIVE_FUNCTIONS
+#define H_NATIVE_FUNCTIONS
+
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+#include "dynarraylike.hpp"
+#include "numeric_interface.hpp"
+
+// Built-in functions implemented in C++.
+// They are looked up by EvaluationVisitor when a function call names
+// no user reference : any user definition shadows the native one.
+template <typename T>
+struct NativeFunction
+{
+    typedef std::function<T(const dynarray<T>&)> function_type;
+
+    size_t arity;
+    function_type function;
+};
+
+template <typename T>
+class NativeFunctions
+{
+public:
+    static const NativeFunctions<T>& Instance()
+    {
+        static const NativeFunctions<T> instance;
+        return instance;
+    }
+
+    const NativeFunction<T>* Find(const std::string& name) const
+    {
+        auto it = functions_.find(name);
+        return it != functions_.end() ? &it->second : nullptr;
+    }
+
+private:
+    typedef typename T::value_type value_type;
+    typedef numeric_interface<value_type> ni;
+
+    NativeFunctions()
+    {
+        Register("inv", 1, [](const dynarray<T>& args) {return T::inv(args[0]);});
+        Register("det", 1, [](const dynarray<T>& args) {return T::det(args[0]);});
+
+        // storage of a matrix, see sparse.hpp
+        Register("sparse", 1, [](const dynarray<T>& args) {return args[0].ToSparse();});
+        Register("full", 1, [](const dynarray<T>& args) {return args[0].ToDense();});
+        Register("nnz", 1, [](const dynarray<T>& args) {return T(value_type(double(args[0].Nonzeros())));});
+
+        // elementwise functions
+        RegisterElementwise("exp", &ni::exp);
+        RegisterElementwise("log", &ni::log);
+        RegisterElementwise("ln", &ni::log);
+        RegisterElementwise("sin", &ni::sin);
+        RegisterElementwise("cos", &ni::cos);
+        RegisterElementwise("tan", &ni::tan);
+        RegisterElementwise("asin", &ni::asin);
+        RegisterElementwise("acos", &ni::acos);
+        RegisterElementwise("atan", &ni::atan);
+        RegisterElementwise("sinh", &ni::sinh);
+        RegisterElementwise("cosh", &ni::cosh);
+        RegisterElementwise("tanh", &ni::tanh);
+        RegisterElementwise("sqrt", [](const value_type& a) {return value_type(ni::sqrt(a));});
+        RegisterElementwise("abs", [](const value_type& a) {return value_type(ni::abs(a));});
+        RegisterElementwise("conj", &ni::conj);
+        RegisterElementwise("gamma", &ni::gamma);
+    }
+
+    template <typename Func>
+    void RegisterElementwise(const std::string& name, Func f)
+    {
+        Register(name, 1, [f](const dynarray<T>& args) {return args[0].Map(f);});
+    }
+
+    void Register(const std::string& name, size_t arity, typename NativeFunction<T>::function_type function)
+    {
+        functions_[name] = NativeFunction<T>{arity, std::move(function)};
+    }
+
+    std::unordered_map<std::string, NativeFunction<T>> functions_;
+};
+
+#endif // H_NATIVE_FUNCTIONS
@@ -0,0 +1,81 @@
+#ifndef H_NUMBER_FORMAT
+#define H_NUMBER_FORMAT
+
+#include <cstdio> // std::snprintf
+#include <clocale> // std::localeconv
+#include <cstring> // std::memcpy
+#include <limits>
+#include <type_traits>
+
+#if defined(__has_include)
+#if __has_include(<charconv>) && __cplusplus >= 201703L
+#include <charconv>
+#endif
+#endif
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#define INKAMATH_HAS_TO_CHARS
+#endif
+
+// Locale free number formatting into a caller buffer.
+// Floating point numbers are written as printf "%.<precision>g" would
+// in the "C" locale (std::to_chars when the library has it, snprintf
+// otherwise), integers in base 10.
+// The functions return the end of the written characters, or first if
+// [first, last) is too small. number_buffer_size characters are always
+// enough for a scalar. A NaN is written "nan" whatever its sign bit,
+// which depends on how the operations producing it were compiled.
+
+static const size_t number_buffer_size = 64;
+
+template <typename T>
+typename std::enable_if<std::is_floating_point<T>::value, char*>::type
+format_number(char* first, char* last, T a, int precision)
+{
+    if (a != a)
+    {
+        if (last-first < 3) return first;
+        std::memcpy(first, "nan", 3);
+        return first+3;
+    }
+#ifdef INKAMATH_HAS_TO_CHARS
+    std::to_chars_result result = std::to_chars(first, last, a, std::chars_format::general, precision);
+    return result.ec == std::errc() ? result.ptr : first;
+#else
+    int n = std::snprintf(first, last-first, "%.*Lg", precision, static_cast<long double>(a));
+    if (n < 0 || n >= last-first) return first;
+    // the decimal point of the current C locale
+    const char point = *std::localeconv()->decimal_point;
+    if (point != '.')
+    {
+        for (char* c = first; c != first+n; ++c)
+        {
+            if (*c == point) *c = '.';
+        }
+    }
+    return first+n;
+#endif
+}
+
+template <typename T>
+typename std::enable_if<std::is_integral<T>::value, char*>::type
+format_number(char* first, char* last, T a, int = 0)
+{
+    char digits[std::numeric_limits<T>::digits10+2];
+    char* d = digits+sizeof(digits);
+    typedef typename std::make_unsigned<T>::type unsigned_type;
+    // magnitude without overflow for the minimum value
+    unsigned_type u = a < 0 ? unsigned_type(0)-unsigned_type(a) : unsigned_type(a);
+    do
+    {
+        *--d = char('0'+u%10);
+        u /= 10;
+    } while (u != 0);
+    size_t n = size_t(digits+sizeof(digits)-d) + (a < 0 ? 1 : 0);
+    if (size_t(last-first) < n) return first;
+    if (a < 0) *first++ = '-';
+    std::memcpy(first, d, size_t(digits+sizeof(digits)-d));
+    return first+(digits+sizeof(digits)-d);
+}
+
+#endif // H_NUMBER_FORMAT
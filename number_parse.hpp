@@ -0,0 +1,173 @@
+#ifndef H_NUMBER_PARSE
+#define H_NUMBER_PARSE
+
+#include <cfloat> // FLT_EVAL_METHOD
+#include <cstdlib> // std::strtod
+#include <clocale> // std::localeconv
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Locale free parsing of decimal floating point numbers :
+// [+-]digits[.digits][(e|E)[+-]digits]
+//
+// Numbers with at most 19 significant digits whose value is exactly
+// m*10^e with m < 2^53 and |e| <= 22 are computed with a single correctly
+// rounded multiplication or division (Clinger's fast path). The other
+// ones (long mantissas, large exponents) go to strtod with the decimal
+// point of the current locale, hexadecimal, inf and nan go to strtod
+// unchanged. The result is always the correctly rounded double.
+//
+// Returns false, with end == begin, when no number starts at begin.
+
+// The fast path needs double operations rounded to double (not x87)
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define INKAMATH_FAST_FLOAT_PATH 1
+#else
+#define INKAMATH_FAST_FLOAT_PATH 0
+#endif
+
+inline bool parse_number(double& value, const char* begin, const char*& end)
+{
+    static const double powers_of_ten[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = begin;
+    bool negative = false;
+    if (*p == '+' || *p == '-')
+    {
+        negative = (*p == '-');
+        ++p;
+    }
+
+    if (*p == '0' && (p[1] == 'x' || p[1] == 'X'))
+    {
+        // hexadecimal : strtod syntax
+        char* e;
+        value = std::strtod(begin, &e);
+        end = e;
+        return end != begin;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;       // significant digits read in mantissa
+    int exponent = 0;     // decimal exponent of mantissa
+    bool truncated = false;
+    bool any_digit = false;
+
+    for (; *p >= '0' && *p <= '9'; ++p)
+    {
+        any_digit = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa*10 + uint64_t(*p-'0');
+            if (mantissa != 0) ++digits;
+        }
+        else
+        {
+            ++exponent;
+            truncated = truncated || *p != '0';
+        }
+    }
+    const char* point = nullptr;
+    if (*p == '.')
+    {
+        point = p++;
+        for (; *p >= '0' && *p <= '9'; ++p)
+        {
+            any_digit = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa*10 + uint64_t(*p-'0');
+                if (mantissa != 0) ++digits;
+                --exponent;
+            }
+            else
+            {
+                truncated = truncated || *p != '0';
+            }
+        }
+    }
+
+    if (!any_digit)
+    {
+        if (point == nullptr && (*p == 'i' || *p == 'I' || *p == 'n' || *p == 'N'))
+        {
+            // inf, infinity, nan : strtod syntax
+            char* e;
+            value = std::strtod(begin, &e);
+            end = e;
+            return end != begin;
+        }
+        end = begin;
+        return false;
+    }
+
+    if (*p == 'e' || *p == 'E')
+    {
+        const char* q = p+1;
+        bool negative_exponent = false;
+        if (*q == '+' || *q == '-')
+        {
+            negative_exponent = (*q == '-');
+            ++q;
+        }
+        if (*q >= '0' && *q <= '9')
+        {
+            int e = 0;
+            for (; *q >= '0' && *q <= '9'; ++q)
+            {
+                if (e < 100000) e = e*10 + (*q-'0');
+            }
+            exponent += negative_exponent ? -e : e;
+            p = q;
+        }
+    }
+    end = p;
+
+    if (INKAMATH_FAST_FLOAT_PATH && !truncated && mantissa <= (uint64_t(1) << 53))
+    {
+        if (mantissa == 0)
+        {
+            value = negative ? -0.0 : 0.0;
+            return true;
+        }
+        if (exponent >= -22 && exponent <= 22)
+        {
+            double m = double(mantissa);
+            value = exponent < 0 ? m/powers_of_ten[-exponent] : m*powers_of_ten[exponent];
+            if (negative) value = -value;
+            return true;
+        }
+        if (exponent > 22 && exponent <= 22+15)
+        {
+            // 123e30 = 123000000000000000e15 when the mantissa stays exact
+            uint64_t m = mantissa;
+            int e = exponent;
+            while (e > 22 && m <= (uint64_t(1) << 53)/10)
+            {
+                m *= 10;
+                --e;
+            }
+            if (e <= 22)
+            {
+                value = double(m)*powers_of_ten[e];
+                if (negative) value = -value;
+                return true;
+            }
+        }
+    }
+
+    // slow path : strtod on a copy using the decimal point of the locale
+    std::string copy(begin, end);
+    if (point != nullptr)
+    {
+        copy[point-begin] = *std::localeconv()->decimal_point;
+    }
+    value = std::strtod(copy.c_str(), nullptr);
+    return true;
+}
+
+#endif // H_NUMBER_PARSE
@@ -11,12 +11,34 @@
 #include <string> // std::string
 #include <sstream> // std::ostringstream
 #include <iomanip> // std::setprecision
+#include <vector> // std::vector
+#include <cstring> // std::memcpy
+#include <stdexcept> // std::overflow_error
+
+#include "number_format.hpp"
+#include "number_parse.hpp"
 
 #define _NUMERIC_INTERFACE_PRECISION 9
 
 template <typename T, bool>
 struct numeric_interface_imp;
 
+// Printing precision and format buffer size of the types numeric_interface
+// forwards to : T::precision and T::buffer_size when T defines them
+template <typename T, typename = void>
+struct numeric_interface_format
+{
+    static const int precision = _NUMERIC_INTERFACE_PRECISION;
+    static const size_t buffer_size = number_buffer_size;
+};
+
+template <typename T>
+struct numeric_interface_format<T, decltype(void(T::buffer_size))>
+{
+    static const int precision = T::precision;
+    static const size_t buffer_size = T::buffer_size;
+};
+
 template <typename T>
 struct numeric_interface
 : public numeric_interface_imp<T,std::is_arithmetic<T>::value>
@@ -41,10 +63,15 @@ struct numeric_interface_imp_types
 template <typename T, bool>
 struct numeric_interface_imp
 {
-	 static const int precision = _NUMERIC_INTERFACE_PRECISION;
+	 static const int precision = numeric_interface_format<T>::precision;
+	 static const size_t buffer_size = numeric_interface_format<T>::buffer_size;
      static T zero() {return T::zero();}
      static T one() {return T::one();}
      static int toInt(const T& a) {return T::toInt(a);}
+     static char* format(char* first, char* last, const T& a, int prec = precision)
+     {
+         return T::format(first, last, a, prec);
+     }
      static std::string toString(const T& a) {return T::toString(a);}
      static T pow(const T& a, const T& b) {return T::pow(a,b);}
 
@@ -54,6 +81,24 @@ struct numeric_interface_imp
 	 
 	 static typename numeric_interface_imp_types<T>::sqrt sqrt(const T& a) {return T::sqrt(a);}
 
+	 static T conj(const T& a) {return T::conj(a);}
+
+	 static T solve(const T& a, const T& b) {return T::solve(a,b);}
+
+	 /* Elementary functions used by the native functions */
+	 static T exp(const T& a) {return T::exp(a);}
+	 static T log(const T& a) {return T::log(a);}
+	 static T sin(const T& a) {return T::sin(a);}
+	 static T cos(const T& a) {return T::cos(a);}
+	 static T tan(const T& a) {return T::tan(a);}
+	 static T asin(const T& a) {return T::asin(a);}
+	 static T acos(const T& a) {return T::acos(a);}
+	 static T atan(const T& a) {return T::atan(a);}
+	 static T sinh(const T& a) {return T::sinh(a);}
+	 static T cosh(const T& a) {return T::cosh(a);}
+	 static T tanh(const T& a) {return T::tanh(a);}
+	 static T gamma(const T& a) {return T::gamma(a);}
+
      static bool parse(T& num, const char* begin, char* &end)
      {
          return T::parse(num,begin,end);
@@ -63,7 +108,16 @@ struct numeric_interface_imp
 template <typename T>
 struct numeric_interface_imp<std::complex<T>,false>
 {
-	static const int precision = _NUMERIC_INTERFACE_PRECISION;
+	static const int precision = numeric_interface<T>::precision;
+	static const size_t buffer_size = 2*numeric_interface<T>::buffer_size;
+
+    static char* append(char* first, char* last, const char* s, size_t n)
+    {
+        if(size_t(last-first) < n) return first;
+        std::memcpy(first, s, n);
+        return first+n;
+    }
+
     static std::complex<T> zero()
     {
         return std::complex<T>(numeric_interface<T>::zero(),
@@ -81,56 +135,72 @@ struct numeric_interface_imp<std::complex<T>,false>
         return static_cast<size_t>(numeric_interface<T>::toInt(a.real()));
     }
 
-    static std::string toString(const std::complex<T>& a)
+    // a, a+i*b, a-i*b, i*b... with 1 omitted for the imaginary part
+    static char* format(char* first, char* last, const std::complex<T>& a, int prec = precision)
     {
-        std::string s;
         T real = a.real();
         T imag = a.imag();
-        if(a.real() != 0)
+        char* p = first;
+        if(real == 0 && imag == 0)
         {
-            s = numeric_interface<T>::toString(real);
-
-            if(imag > 0)
-            {
-                s += "+i";
-            }
-            else if(imag < 0)
-            {
-                s += "-i";
-                imag = -imag;
-            }
-            if(imag != 1 && imag != -1 && imag != 0)
-            {
-                s+= "*" + numeric_interface<T>::toString(imag);
-            }
+            return append(p, last, "0", 1);
         }
-        else if(a.imag() != 0)
+        // an interval around 0 (see interval.hpp) is neither < 0 nor > 0
+        const bool positive = imag > 0 || (!(imag < 0) && imag != 0 && imag == imag);
+        if(real != 0)
         {
-            if(imag > 0)
-            {
-                s += "i";
-            }
-            else if(imag < 0)
-            {
-                s += "-i";
-                imag = -imag;
-            }
-            if(imag != 1 && imag != -1 && imag != 0)
+            p = numeric_interface<T>::format(p, last, real, prec);
+            if(positive)
             {
-                s+= "*" + numeric_interface<T>::toString(imag);
+                p = append(p, last, "+i", 2);
             }
         }
-        else
+        else if(positive)
+        {
+            p = append(p, last, "i", 1);
+        }
+        if(imag < 0)
+        {
+            p = append(p, last, "-i", 2);
+            imag = -imag;
+        }
+        if(imag != 1 && imag != -1 && imag != 0)
         {
-            s = "0";
+            p = append(p, last, "*", 1);
+            p = numeric_interface<T>::format(p, last, imag, prec);
         }
+        return p;
+    }
 
-        return s;
+    static std::string toString(const std::complex<T>& a)
+    {
+        char buffer[buffer_size];
+        return std::string(buffer, format(buffer, buffer+sizeof(buffer), a));
     }
 
     static std::complex<T> pow(const std::complex<T>& a,
                                const std::complex<T>& b)
     {
+        // the library pow of the other types goes through exp and log :
+        // exact integer powers by squaring
+        const T zero = numeric_interface<T>::zero();
+        if(!std::is_floating_point<T>::value && b.imag() == zero
+           && numeric_interface<T>::abs(b.real()) < T(1 << 30)
+           && b.real() == T(numeric_interface<T>::toInt(b.real())))
+        {
+            const int n = numeric_interface<T>::toInt(b.real());
+            const std::complex<T> one(numeric_interface<T>::one(), zero);
+            std::complex<T> r = one, x = a;
+            for(unsigned k = unsigned(n < 0 ? -n : n); k != 0; k >>= 1)
+            {
+                if(k & 1)
+                {
+                    r *= x;
+                }
+                x *= x;
+            }
+            return n < 0 ? one/r : r;
+        }
         return std::pow(a,b);
     }
 
@@ -149,9 +219,13 @@ struct numeric_interface_imp<std::complex<T>,false>
         return std::pow(a,b);
     }
 
-    static typename numeric_interface_imp_types<T>::fact fact(const std::complex<T>& a)
+    static std::complex<T> fact(const std::complex<T>& a)
     {
-        return numeric_interface<T>::fact(a.real());
+        if(a.imag() == 0)
+        {
+            return std::complex<T>(numeric_interface<T>::fact(a.real()), 0);
+        }
+        return gamma(a + std::complex<T>(1));
     }
 
 	static typename numeric_interface_imp_types<T>::abs abs(const std::complex<T>& a)
@@ -159,6 +233,77 @@ struct numeric_interface_imp<std::complex<T>,false>
 		return numeric_interface<T>::sqrt(a.real()*a.real()+a.imag()*a.imag());
 	}
 
+	static std::complex<T> conj(const std::complex<T>& a)
+	{
+		return std::complex<T>(a.real(), -a.imag());
+	}
+
+	// Negated reals carry a -0 imaginary part (-4 is -(4+0i)), take them
+	// back to the upper side of the branch cuts.
+	static std::complex<T> principal(const std::complex<T>& a)
+	{
+		return a + std::complex<T>(numeric_interface<T>::zero());
+	}
+
+	static std::complex<T> sqrt(const std::complex<T>& a) {return std::sqrt(principal(a));}
+	static std::complex<T> exp(const std::complex<T>& a) {return std::exp(a);}
+	static std::complex<T> log(const std::complex<T>& a) {return std::log(principal(a));}
+	static std::complex<T> sin(const std::complex<T>& a) {return std::sin(a);}
+	static std::complex<T> cos(const std::complex<T>& a) {return std::cos(a);}
+	static std::complex<T> tan(const std::complex<T>& a) {return std::tan(a);}
+	static std::complex<T> asin(const std::complex<T>& a) {return std::asin(principal(a));}
+	static std::complex<T> acos(const std::complex<T>& a)
+	{
+		if(!std::is_floating_point<T>::value)
+		{
+			// the library acos of the other types has a double pi/2
+			const std::complex<T> t = asin(a);
+			return std::complex<T>(numeric_interface<T>::acos(numeric_interface<T>::zero()) - t.real(), -t.imag());
+		}
+		return std::acos(principal(a));
+	}
+	static std::complex<T> atan(const std::complex<T>& a) {return std::atan(principal(a));}
+	static std::complex<T> sinh(const std::complex<T>& a) {return std::sinh(a);}
+	static std::complex<T> cosh(const std::complex<T>& a) {return std::cosh(a);}
+	static std::complex<T> tanh(const std::complex<T>& a) {return std::tanh(a);}
+
+	static std::complex<T> gamma(const std::complex<T>& a)
+	{
+		if(a.imag() == 0)
+		{
+			return std::complex<T>(numeric_interface<T>::gamma(a.real()), 0);
+		}
+		return std::exp(lgamma(a));
+	}
+
+	// Lanczos approximation (g=7, n=9) of log(Gamma(a)) with the reflection
+	// formula for Re(a) < 1/2, about 15 significant digits.
+	// Evaluated in log form so that large arguments don't overflow.
+	static std::complex<T> lgamma(const std::complex<T>& a)
+	{
+		static const T pi = T(3.14159265358979323846);
+		if(a.real() < T(0.5))
+		{
+			return std::log(pi / std::sin(pi*a)) - lgamma(std::complex<T>(1) - a);
+		}
+
+		static const T g = 7;
+		static const T coefficients[] = {
+			T(0.99999999999980993), T(676.5203681218851), T(-1259.1392167224028),
+			T(771.32342877765313), T(-176.61502916214059), T(12.507343278686905),
+			T(-0.13857109526572012), T(9.9843695780195716e-6), T(1.5056327351493116e-7)
+		};
+
+		std::complex<T> z = a - std::complex<T>(1);
+		std::complex<T> x = coefficients[0];
+		for(int k = 1; k < 9; ++k)
+		{
+			x += coefficients[k] / (z + std::complex<T>(T(k)));
+		}
+		std::complex<T> t = z + g + T(0.5);
+		return T(0.5)*numeric_interface<T>::log(2*pi) + (z + T(0.5))*std::log(t) - t + std::log(x);
+	}
+
     static bool parse(std::complex<T>& num, const char* begin, char* &end)
     {
         T zero = numeric_interface<T>::zero();
@@ -186,7 +331,7 @@ struct numeric_interface_imp<std::complex<T>,false>
 template <typename T>
 struct numeric_interface_imp_types<std::complex<T> >
 {
-	typedef typename numeric_interface_imp_types<T>::fact fact;
+	typedef std::complex<T> fact;
 	typedef typename numeric_interface_imp_types<T>::abs abs;
 	typedef typename numeric_interface_imp_types<T>::sqrt sqrt;
 };
@@ -196,34 +341,84 @@ template <typename T>
 struct numeric_interface_imp<T,true>
 {
 	static const int precision = _NUMERIC_INTERFACE_PRECISION;
+	static const size_t buffer_size = number_buffer_size;
     typedef typename best_promotion<T>::type best_type;
 
     static T zero() {return 0;}
     static T one() {return 1;}
     static int toInt(const T& a) {return static_cast<int>(a);}
-    static std::string toString(const T& a) 
+    static char* format(char* first, char* last, const T& a, int prec = precision)
+    {
+        return format_number(first, last, a, prec);
+    }
+    static std::string toString(const T& a)
 	{
-		std::ostringstream oss;
-		oss << std::setprecision(precision);
-		oss << a;
-		return oss.str();
+        char buffer[number_buffer_size];
+        return std::string(buffer, format(buffer, buffer+sizeof(buffer), a));
 	}
     static T pow(const T& a,const T& b) {return std::pow(a,b);}
     
+    // n! from a table for the integers with a finite double factorial,
+    // Gamma(n+1) for the other arguments : inf or NaN at the negative
+    // integers, the poles of Gamma.
+    // For an integer type, 1 below 1 and std::overflow_error when n!
+    // is not representable.
 	static T fact(const T& n)
     {
-        T i = 1;
-        T n1 = 1;
-        while (n >= i)
+        return fact(n, std::is_integral<T>());
+    }
+
+    static T fact(const T& n, std::true_type)
+    {
+        T f = 1;
+        for (T i = 2; i <= n; ++i)
         {
-            n1 *= i;
-            ++i;
+            if (f > std::numeric_limits<T>::max()/i)
+            {
+                throw std::overflow_error("Factorial overflow.");
+            }
+            f *= i;
         }
-        return n1;
+        return f;
+    }
+
+    static T fact(const T& n, std::false_type)
+    {
+        static const std::vector<double> table = make_factorial_table(171);
+        if (n >= 0 && n < static_cast<T>(table.size()) && n == std::floor(n))
+        {
+            return static_cast<T>(table[static_cast<size_t>(n)]);
+        }
+        return static_cast<T>(std::tgamma(static_cast<double>(n) + 1));
+    }
+
+    static std::vector<double> make_factorial_table(size_t size)
+    {
+        std::vector<double> table(size);
+        table[0] = 1;
+        for (size_t i = 1; i < size; ++i)
+        {
+            table[i] = table[i-1]*i;
+        }
+        return table;
     }
 
 	static T abs(const T& a) {return std::abs(a);}
 	static T sqrt(const T& a) {return std::sqrt(a);}
+	static T conj(const T& a) {return a;}
+
+	static T exp(const T& a) {return std::exp(a);}
+	static T log(const T& a) {return std::log(a);}
+	static T sin(const T& a) {return std::sin(a);}
+	static T cos(const T& a) {return std::cos(a);}
+	static T tan(const T& a) {return std::tan(a);}
+	static T asin(const T& a) {return std::asin(a);}
+	static T acos(const T& a) {return std::acos(a);}
+	static T atan(const T& a) {return std::atan(a);}
+	static T sinh(const T& a) {return std::sinh(a);}
+	static T cosh(const T& a) {return std::cosh(a);}
+	static T tanh(const T& a) {return std::tanh(a);}
+	static T gamma(const T& a) {return std::tgamma(a);}
 
     /* dummy template parameter */
     /*
@@ -264,15 +459,17 @@ struct numeric_interface_imp<T,true>
 };
 
 template <>
-bool numeric_interface_imp<double,true>::
+inline bool numeric_interface_imp<double,true>::
 parse(double& num, const char* begin, char* &end)
 {
-    num = (std::strtod(begin,&end));
-    return (end!=begin);
+    const char* e = begin;
+    bool ret = parse_number(num, begin, e);
+    end = const_cast<char*>(e);
+    return ret;
 }
 
 template <>
-bool numeric_interface_imp<long,true>::
+inline bool numeric_interface_imp<long,true>::
 parse(long& num, const char* begin, char* &end)
 {
     num = (std::strtol(begin,&end,10));
@@ -280,7 +477,7 @@ parse(long& num, const char* begin, char* &end)
 }
 
 template <>
-bool numeric_interface_imp<unsigned long,true>::
+inline bool numeric_interface_imp<unsigned long,true>::
 parse(unsigned long& num, const char* begin, char* &end)
 {
     num = (std::strtoul(begin,&end,10));
@@ -0,0 +1,66 @@
+#ifndef H_OUTPUT_BUFFER
+#define H_OUTPUT_BUFFER
+
+#include <cstdio>
+#include <streambuf>
+#include <vector>
+
+// Output stream buffer writing to a C stream by large blocks.
+// Unlike std::cout with std::endl nothing is flushed before the buffer
+// is full, the stream is flushed or the buffer is destroyed.
+class OutputBuffer : public std::streambuf
+{
+public:
+    explicit OutputBuffer(std::FILE* file, size_t size = 1 << 20)
+        : m_file(file), m_buffer(size)
+    {
+        setp(m_buffer.data(), m_buffer.data()+m_buffer.size());
+    }
+
+    ~OutputBuffer()
+    {
+        sync();
+    }
+
+protected:
+    virtual int_type overflow(int_type c)
+    {
+        if (sync() != 0) return traits_type::eof();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    virtual std::streamsize xsputn(const char* s, std::streamsize n)
+    {
+        if (n > epptr()-pptr())
+        {
+            if (sync() != 0) return 0;
+            if (n > epptr()-pptr())
+            {
+                // larger than the whole buffer
+                return std::streamsize(std::fwrite(s, 1, size_t(n), m_file));
+            }
+        }
+        traits_type::copy(pptr(), s, size_t(n));
+        pbump(int(n));
+        return n;
+    }
+
+    virtual int sync()
+    {
+        size_t n = size_t(pptr()-pbase());
+        if (n && std::fwrite(pbase(), 1, n, m_file) != n) return -1;
+        setp(m_buffer.data(), m_buffer.data()+m_buffer.size());
+        return std::fflush(m_file);
+    }
+
+private:
+    std::FILE* m_file;
+    std::vector<char> m_buffer;
+};
+
+#endif // H_OUTPUT_BUFFER
@@ -11,6 +11,9 @@ class ReferenceStack;
 template <typename T>
 class ParametersCall;
 
+template <typename T>
+class SessionSnapshot;
+
 template <typename T>
 class ParametersDefinition
 {
@@ -53,17 +56,17 @@ public:
     void SetCallParameters(const ParametersCall<T>& param_call, EvaluationVisitor<T>& evaluator) {
         ReferenceStack<T>& stack_ = evaluator.stack();
         for(auto definition : parameters_dict_) {
-            stack_.Set(definition.first, ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(definition.second->accept(evaluator))));
+            stack_.Set(definition.first, ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(evaluator.Eval(definition.second))));
         }
         auto pname = parameters_names_.begin();
         for(auto expr : param_call.parameters_expression()) {
             if(pname != parameters_names_.end()) {
-                stack_.Set(*pname, ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(expr->accept(evaluator))));
+                stack_.Set(*pname, ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(evaluator.Eval(expr))));
                 ++pname;
             }
         }
         for(auto kwarg : param_call.parameters_dict_) {
-            stack_.Set(kwarg.first, ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(kwarg.second->accept(evaluator))));
+            stack_.Set(kwarg.first, ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(evaluator.Eval(kwarg.second))));
         }
     }
 
@@ -76,6 +79,8 @@ public:
 
 
 protected:
+    friend class SessionSnapshot<T>;
+
     std::vector<std::string> parameters_names_;
     ExprDict<T> parameters_dict_;
     std::string index_name_;
@@ -113,8 +118,9 @@ public:
                 subexpr->accept(subexpr_visitor);
             }
             catch(const std::exception& ) {
-                return;
+                // not a linear index, evaluated as is by TryEvalIndex
                 subexpr_ = subexpr;
+                return;
             }
         }
         else {
@@ -134,7 +140,7 @@ public:
         EvaluationVisitor<T> evaluator(stack);
         if(indexed_) {
             if(subexpr_) {
-                index_evaluation = numeric_interface<T>::toInt(subexpr_->accept(evaluator));
+                index_evaluation = numeric_interface<T>::toInt(evaluator.Eval(subexpr_));
             }
             else if (index_name_ != "") {
                 index_evaluation = numeric_interface<T>::toInt(T(a_)*stack.Eval(index_name_, ParametersCall<T>())+T(b_));
@@ -157,6 +163,8 @@ public:
 
 
 protected:
+    friend class SessionSnapshot<T>;
+
     std::vector<std::string> parameters_names_;
     std::vector<PExpression<T>> parameters_exprs_;
     ExprDict<T> parameters_dict_;
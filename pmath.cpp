@@ -1,13 +1,7 @@
 #include "pmath.hpp"
+#include "numeric_interface.hpp"
 
 double fact(double n)
 {
-    double i = 1;
-    double n1 = 1;
-    while (n >= i)
-    {
-        n1 *= i;
-        ++i;
-    }
-    return n1;
+    return numeric_interface<double>::fact(n);
 }
@@ -0,0 +1,119 @@
+#ifndef H_POOL_ALLOCATOR
+#define H_POOL_ALLOCATOR
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Free lists of small fixed size blocks carved from large chunks.
+// Size classes are multiples of 16 bytes up to max_block bytes.
+// Chunks are kept until the end of the process : a freed block is only
+// reused for a block of the same class.
+class SmallBlockPool
+{
+public:
+    static const size_t granularity = 16;
+    static const size_t max_block = 128;
+    static const size_t chunk_size = 64*1024;
+
+    static SmallBlockPool& Instance() {
+        // never destroyed : blocks may be released by static objects
+        static SmallBlockPool* pool = new SmallBlockPool();
+        return *pool;
+    }
+
+    void* Allocate(size_t bytes) {
+        const size_t c = Class(bytes);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(!free_[c]) {
+            Refill(c);
+        }
+        Block* block = free_[c];
+        free_[c] = block->next;
+        return block;
+    }
+
+    void Deallocate(void* p, size_t bytes) {
+        const size_t c = Class(bytes);
+        Block* block = static_cast<Block*>(p);
+        std::lock_guard<std::mutex> lock(mutex_);
+        block->next = free_[c];
+        free_[c] = block;
+    }
+
+private:
+    struct Block {
+        Block* next;
+    };
+
+    static const size_t classes = max_block/granularity;
+
+    SmallBlockPool() {
+        for(size_t c = 0; c < classes; ++c) free_[c] = nullptr;
+    }
+
+    static size_t Class(size_t bytes) {
+        return bytes ? (bytes-1)/granularity : 0;
+    }
+
+    void Refill(size_t c) {
+        const size_t block_size = (c+1)*granularity;
+        chunks_.emplace_back(new char[chunk_size]);
+        char* chunk = chunks_.back().get();
+        for(size_t offset = 0; offset+block_size <= chunk_size; offset += block_size) {
+            Block* block = reinterpret_cast<Block*>(chunk+offset);
+            block->next = free_[c];
+            free_[c] = block;
+        }
+    }
+
+    std::mutex mutex_;
+    Block* free_[classes];
+    std::vector<std::unique_ptr<char[]>> chunks_;
+};
+
+// Stateless allocator serving small arrays from the SmallBlockPool,
+// larger ones from the standard allocator.
+template <typename T>
+struct PoolAllocator
+{
+    typedef T value_type;
+
+    template <typename U>
+    struct rebind {
+        typedef PoolAllocator<U> other;
+    };
+
+    PoolAllocator() {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if(n*sizeof(T) <= SmallBlockPool::max_block && alignof(T) <= SmallBlockPool::granularity) {
+            return static_cast<T*>(SmallBlockPool::Instance().Allocate(n*sizeof(T)));
+        }
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* p, size_t n) {
+        if(n*sizeof(T) <= SmallBlockPool::max_block && alignof(T) <= SmallBlockPool::granularity) {
+            SmallBlockPool::Instance().Deallocate(p, n*sizeof(T));
+        }
+        else {
+            std::allocator<T>().deallocate(p, n);
+        }
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) {
+    return false;
+}
+
+#endif // H_POOL_ALLOCATOR
@@ -0,0 +1,192 @@
+#ifndef H_PROFILER
+#define H_PROFILER
+
+/**
+ ***************************************
+ * Evaluation profiler, compiled in with INKAMATH_PROFILING.
+ *
+ * Attributes call counts, inclusive/exclusive time, memo hits and tracked
+ * bytes allocated (see alloc_tracker.hpp) to each user reference and to
+ * each node type.
+ * Exclusive time and bytes of a frame exclude the ones of its children.
+ * The reference frames can be dumped as folded stacks (one "a;b;c ns"
+ * line per stack) for flame graph tools.
+ *
+ * Without INKAMATH_PROFILING the INKAMATH_PROFILE_* macros expand to
+ * nothing. The profiler is global and expects one evaluating thread
+ * at a time.
+ ***************************************
+ */
+
+#ifdef INKAMATH_PROFILING
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+
+#include "alloc_tracker.hpp"
+
+class Profiler
+{
+public:
+    struct Stats
+    {
+        size_t calls = 0;
+        double inclusive_ns = 0;
+        double exclusive_ns = 0;
+        size_t memo_hits = 0;
+        size_t bytes = 0; // exclusive
+    };
+
+    enum FrameKind {Reference, Node};
+
+    static Profiler& Instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    void Enter(FrameKind kind, const std::string& name)
+    {
+        std::vector<Frame>& frames = kind == Reference ? references_ : nodes_;
+        Stats& stats = kind == Reference ? reference_stats_[name] : node_stats_[name];
+        ++stats.calls;
+        if(kind == Reference) {
+            path_lengths_.push_back(path_.size());
+            if(!path_.empty()) path_ += ';';
+            path_ += name;
+        }
+        frames.push_back(Frame{&stats, clock::now(), AllocationTracker::ThreadBytes(), 0, 0});
+    }
+
+    void Leave(FrameKind kind)
+    {
+        std::vector<Frame>& frames = kind == Reference ? references_ : nodes_;
+        Frame frame = frames.back();
+        frames.pop_back();
+
+        double inclusive = std::chrono::duration<double, std::nano>(clock::now()-frame.start).count();
+        size_t bytes = AllocationTracker::ThreadBytes()-frame.start_bytes;
+        frame.stats->inclusive_ns += inclusive;
+        frame.stats->exclusive_ns += inclusive-frame.children_ns;
+        frame.stats->bytes += bytes-frame.children_bytes;
+        if(!frames.empty()) {
+            frames.back().children_ns += inclusive;
+            frames.back().children_bytes += bytes;
+        }
+
+        if(kind == Reference) {
+            folded_[path_] += inclusive-frame.children_ns;
+            path_.resize(path_lengths_.back());
+            path_lengths_.pop_back();
+        }
+    }
+
+    // Counted for the reference being evaluated
+    void MemoHit()
+    {
+        if(!references_.empty()) {
+            ++references_.back().stats->memo_hits;
+        }
+    }
+
+    void Reset()
+    {
+        reference_stats_.clear();
+        node_stats_.clear();
+        folded_.clear();
+    }
+
+    void Report(std::ostream& os) const
+    {
+        Print(os, "reference", reference_stats_);
+        os << "\n";
+        Print(os, "node", node_stats_);
+    }
+
+    // Flame graph input : exclusive nanoseconds per reference stack
+    void DumpFolded(std::ostream& os) const
+    {
+        for(auto& stack : folded_) {
+            os << stack.first << " " << static_cast<unsigned long long>(stack.second) << "\n";
+        }
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct Frame
+    {
+        Stats* stats;
+        clock::time_point start;
+        size_t start_bytes;
+        double children_ns;
+        size_t children_bytes;
+    };
+
+    typedef std::unordered_map<std::string, Stats> stats_map;
+
+    // sorted by decreasing exclusive time
+    static void Print(std::ostream& os, const std::string& title, const stats_map& stats)
+    {
+        std::vector<std::pair<std::string, Stats>> rows(stats.begin(), stats.end());
+        std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, Stats>& a,
+                                               const std::pair<std::string, Stats>& b) {
+            return a.second.exclusive_ns > b.second.exclusive_ns;
+        });
+        os << std::left << std::setw(20) << title << std::right
+           << std::setw(12) << "calls" << std::setw(14) << "incl(ms)" << std::setw(14) << "excl(ms)"
+           << std::setw(12) << "memo hits" << std::setw(14) << "bytes" << "\n";
+        os << std::fixed << std::setprecision(3);
+        for(auto& row : rows) {
+            os << std::left << std::setw(20) << row.first << std::right
+               << std::setw(12) << row.second.calls
+               << std::setw(14) << row.second.inclusive_ns*1e-6
+               << std::setw(14) << row.second.exclusive_ns*1e-6
+               << std::setw(12) << row.second.memo_hits
+               << std::setw(14) << row.second.bytes << "\n";
+        }
+        os << std::defaultfloat;
+    }
+
+    stats_map reference_stats_;
+    stats_map node_stats_;
+    std::vector<Frame> references_;
+    std::vector<Frame> nodes_;
+    std::string path_;
+    std::vector<size_t> path_lengths_;
+    std::map<std::string, double> folded_;
+};
+
+// RAII frame, also closed when an evaluation error unwinds the stack
+class ProfileScope
+{
+public:
+    ProfileScope(Profiler::FrameKind kind, const std::string& name) : kind_(kind) {
+        Profiler::Instance().Enter(kind_, name);
+    }
+    ~ProfileScope() {
+        Profiler::Instance().Leave(kind_);
+    }
+private:
+    Profiler::FrameKind kind_;
+};
+
+#define INKAMATH_PROFILE_REFERENCE(name) ProfileScope inkamath_profile_scope(Profiler::Reference, name)
+#define INKAMATH_PROFILE_NODE(name) ProfileScope inkamath_profile_scope(Profiler::Node, name)
+#define INKAMATH_PROFILE_MEMO_HIT() Profiler::Instance().MemoHit()
+
+#else
+
+#define INKAMATH_PROFILE_REFERENCE(name)
+#define INKAMATH_PROFILE_NODE(name)
+#define INKAMATH_PROFILE_MEMO_HIT()
+
+#endif // INKAMATH_PROFILING
+
+#endif // H_PROFILER
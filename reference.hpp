@@ -5,15 +5,21 @@
 #include "parameters.hpp"
 #include "mapstack.hpp"
 #include "expression_visitor.hpp"
+#include "profiler.hpp"
+#include "summation.hpp"
 
 template <typename T>
 using PExpression = std::shared_ptr<Expression<T>>;
 
 
+#include <list>
 #include <map>
+#include <memory>
+#include <set>
 #include <stack>
 #include <tuple>
 #include <stdexcept>
+#include <limits>
 
 
 template <typename T>
@@ -30,9 +36,21 @@ class ReferenceStack;
 template <typename T>
 class EvaluationVisitor;
 
+template <typename T>
+class SessionSnapshot;
+
+template <typename T>
+class JitCompiler;
+
+template <typename T>
+class CppExport;
+
 template <typename T>
 class Reference {
 public:
+    typedef std::map<size_t, T> Indexed_values;
+    // values of the parameters by names
+    typedef std::map<std::string, T> Bound_values;
 
     void add_expression(const std::string& ai_reference_name, const ParametersDefinition<T>& ai_parameters, PExpression<T>  ai_expression) {
         if(reference_name_.empty()) {
@@ -52,14 +70,27 @@ public:
             single_expr_ = ExpressionDefinition<T>(ai_parameters, ai_expression);
         }
 
+        // the terms memoized by the previous calls are invalidated
+        memos_ = std::make_shared<Sequence_memos>();
+
         ParametersDefinition<T> gen_params_def;
         gen_params_def = std::get<0>(general_expr_);
         if( gen_params_def.parameters_dict() != ai_parameters.parameters_dict()
                 || gen_params_def.parameters_names() != ai_parameters.parameters_names()) {
             // memoized index is invalidated when adding a new expression
             // with different parameters
-            memoized_index_.clear();
+            memoized_index_.reset();
         }
+        UpdateSummation();
+    }
+
+    // Definition of a function by a single expression, without index nor
+    // sequence, or an empty definition
+    ExpressionDefinition<T> SingleDefinition() const {
+        if(std::get<1>(general_expr_) || !indexed_expr_.empty()) {
+            return ExpressionDefinition<T>();
+        }
+        return single_expr_;
     }
 
     T Eval( const ParametersCall<T>& ai_parameters, ReferenceStack<T>& stack) {
@@ -76,6 +107,11 @@ public:
 //        else {
 //            return this->EvalImp(ai_parameters, stack);
 //        }
+        if(std::get<1>(general_expr_)) {
+            // The memo of the terms is chosen once the parameters are bound,
+            // see TryEvaluateGeneralExpression
+            memoized_index_.reset();
+        }
         return this->EvalImp(ai_parameters, stack);
 
     }
@@ -89,6 +125,12 @@ public:
         T evaluation = {};
         EvaluationVisitor<T> evaluator(stack);
 
+        // Share the memo of the evaluation in progress
+        memoized_index_ = stack.SequenceMemo(reference_name_);
+        if(!memoized_index_) {
+            memoized_index_ = std::make_shared<Indexed_values>();
+        }
+
         // Important note: Indexed expression shall not be recursive! ==> stack overflow
         if(!TryEvaluateIndexedExpression(ai_parameters, evaluator, evaluation)) {
             PExpression<T> gen_expr_def;
@@ -100,13 +142,13 @@ public:
                     &&  gen_params_def.parameters_names() == ai_parameters.parameters_names()) {
                 int index_value;
                 if(ai_parameters.TryEvalIndex(stack, index_value)) {
-                    auto it = memoized_index_.find(index_value);
-                    if(it != memoized_index_.end()) {
+                    auto it = memoized_index_->find(index_value);
+                    if(it != memoized_index_->end()) {
+                        INKAMATH_PROFILE_MEMO_HIT();
                         evaluation = it->second;
                     }
                     else if(index_value < 0) {
                         evaluation = {};
-                        memoized_index_[index_value] = evaluation;
                     }
                     else if(!TryEvaluateIndexedExpression(ai_parameters, evaluator, evaluation)) {
                         ParametersCall<T> fwd_parameter(0,index_value,true);
@@ -117,6 +159,13 @@ public:
         }
         return evaluation;
     }
+
+    // Memos used by another thread : the calls of the copy start from new ones
+    void ForkMemos() {
+        if(memos_) {
+            memos_ = std::make_shared<Sequence_memos>();
+        }
+    }
 	
 private:
     T EvalImp( const ParametersCall<T>& ai_parameters, ReferenceStack<T>& stack) {
@@ -150,7 +199,7 @@ private:
 
                 ind_params_def.SetCallParameters(ai_parameters, evaluator);
                 if(ind_expr_def) {
-                    evaluation = ind_expr_def->accept(evaluator);
+                    evaluation = evaluator.Eval(ind_expr_def);
                     succeed = true;
                 }
             }
@@ -164,34 +213,83 @@ private:
         PExpression<T> gen_expr_def;
         ParametersDefinition<T> gen_params_def;
         std::tie(gen_params_def, gen_expr_def) = general_expr_;
+        int index_value;
         if(gen_expr_def) {
-            if(ai_parameters.indexed()) {
-                size_t index = ai_parameters.b() - gen_params_def.b();
-                if(ai_parameters.a() != 0) {
-                    index *= ai_parameters.a();
+            if(ai_parameters.TryEvalIndex(stack, index_value)) {
+                if(index_value < gen_params_def.b()) {
+                    // terms before the first one are null
+                    evaluation = {};
+                    return true;
                 }
+                size_t index = index_value - gen_params_def.b();
                 if(gen_params_def.a() != 0) {
                     index /= gen_params_def.a();
                 }
                 gen_params_def.SetCallParameters(ai_parameters, evaluator);
+                std::unique_ptr<typename ReferenceStack<T>::SequenceScope> scope;
+                if(!memoized_index_) {
+                    // top level call : share the terms with the previous calls
+                    // and with the recursive references
+                    memoized_index_ = Memo(gen_params_def, ai_parameters, stack);
+                    scope.reset(new typename ReferenceStack<T>::SequenceScope(stack, reference_name_, memoized_index_));
+                }
+                auto memoized = memoized_index_->find(index);
+                if(memoized != memoized_index_->end()) {
+                    INKAMATH_PROFILE_MEMO_HIT();
+                    evaluation = memoized->second;
+                    return true;
+                }
                 typename ReferenceStack<T>::Guard guard(stack);
+                if(IsLinearRecursion(gen_params_def, gen_expr_def) && index < max_index) {
+                    // Evaluate the missing previous terms in increasing order :
+                    // the recursive references then hit the memo and the native
+                    // stack stays constant instead of growing with the index.
+                    size_t first = index;
+                    while(first > 0 && !memoized_index_->count(first-1) && !indexed_expr_.count(first-1)) {
+                        --first;
+                    }
+                    if(summand_) {
+                        // f_n=f_(n-1)+g : sum g from the last known term
+                        stack.Set(gen_params_def.index_name(), ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(T(first))));
+                        CompensatedSum<T> sum(evaluator.Eval(previous_));
+                        for(size_t i = first; i <= index; ++i) {
+                            stack.Set(gen_params_def.index_name(), ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(T(i))));
+                            sum.Add(evaluator.Eval(summand_));
+                            (*memoized_index_)[i] = sum.Value();
+                        }
+                        evaluation = (*memoized_index_)[index];
+                        return true;
+                    }
+                    for(size_t i = first; i < index; ++i) {
+                        if(!indexed_expr_.count(i)) {
+                            stack.Set(gen_params_def.index_name(), ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(T(i))));
+                            (*memoized_index_)[i] = evaluator.Eval(gen_expr_def);
+                        }
+                    }
+                }
                 stack.Set(gen_params_def.index_name(), ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(T(index))));
-                evaluation = gen_expr_def->accept(evaluator);
-                memoized_index_[index] = evaluation;
+                evaluation = evaluator.Eval(gen_expr_def);
+                (*memoized_index_)[index] = evaluation;
                 succeed = true;
             }
             else {
+                // the limit is searched from the first terms at each call
+                std::unique_ptr<typename ReferenceStack<T>::SequenceScope> scope;
+                if(!memoized_index_) {
+                    memoized_index_ = std::make_shared<Indexed_values>();
+                    scope.reset(new typename ReferenceStack<T>::SequenceScope(stack, reference_name_, memoized_index_));
+                }
                 size_t start_index = 0;
                 T start_evaluation;
-                if(!memoized_index_.empty() || !indexed_expr_.empty()) {
-                    if(!memoized_index_.empty()) {
-                        start_index = memoized_index_.rbegin()->first;
+                if(!memoized_index_->empty() || !indexed_expr_.empty()) {
+                    if(!memoized_index_->empty()) {
+                        start_index = memoized_index_->rbegin()->first;
                     }
                     if(!indexed_expr_.empty()) {
                         start_index = std::max(start_index, indexed_expr_.rbegin()->first);
                     }
-                    if(start_index == memoized_index_.rbegin()->first) {
-                        start_evaluation = memoized_index_.rbegin()->second;
+                    if(!memoized_index_->empty() && start_index == memoized_index_->rbegin()->first) {
+                        start_evaluation = memoized_index_->rbegin()->second;
                     }
                     else {
 
@@ -200,7 +298,7 @@ private:
                         std::tie(ind_params_def, ind_expr_def) = indexed_expr_.rbegin()->second;
 
                         ind_params_def.SetCallParameters(ai_parameters, evaluator);
-                        start_evaluation = ind_expr_def->accept(evaluator);
+                        start_evaluation = evaluator.Eval(ind_expr_def);
                     }
                 }
                 gen_params_def.SetCallParameters(ai_parameters, evaluator);
@@ -210,15 +308,27 @@ private:
                 difference_type diff = numeric_interface<difference_type>::one();
                 size_t iter_count = 0;
                 typename ReferenceStack<T>::Guard guard(stack);
+                std::unique_ptr<CompensatedSum<T>> sum;
+                if(summand_ && IsLinearRecursion(gen_params_def, gen_expr_def)) {
+                    // f_n=f_(n-1)+g : sum g from the term start_index
+                    stack.Set(gen_params_def.index_name(), ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(T(start_index+1))));
+                    sum.reset(new CompensatedSum<T>(evaluator.Eval(previous_)));
+                }
                 while(diff > 1E-10 && iter_count < 30) {
                     start_index += gen_params_def.a();
                     stack.Set(gen_params_def.index_name(), ParametersDefinition<T>(), PExpression<T>(new ValExpression<T>(T(start_index))));
-                    evaluation = gen_expr_def->accept(evaluator);
+                    if(sum) {
+                        sum->Add(evaluator.Eval(summand_));
+                        evaluation = sum->Value();
+                    }
+                    else {
+                        evaluation = evaluator.Eval(gen_expr_def);
+                    }
+                    (*memoized_index_)[start_index] = evaluation;
                     diff = numeric_interface<T>::abs(evaluation-start_evaluation);
                     start_evaluation = evaluation;
                     ++iter_count;
                 }
-                memoized_index_[start_index] = evaluation;
                 succeed = true;
             }
         }
@@ -233,12 +343,259 @@ private:
         if(single_expr_def) {
 
             single_params_def.SetCallParameters(ai_parameters, evaluator);
-            evaluation = single_expr_def->accept(evaluator);
+            evaluation = evaluator.Eval(single_expr_def);
             succeed = true;
         }
         return succeed;
     }
 
+    // Memo of the terms for the values bound to the parameters of the
+    // general expression and to the free names of the definitions (see
+    // FreeNames), shared by the calls with the same values until a
+    // definition of the stack changes. Only the last max_memos are kept.
+    std::shared_ptr<Indexed_values> Memo(const ParametersDefinition<T>& params_def, const ParametersCall<T>& params_call, ReferenceStack<T>& stack) {
+        std::set<std::string> visited, free_names;
+        visited.insert(reference_name_);
+        if(!FreeNames(stack, visited, free_names)) {
+            // the terms are not a function of the values read : a memo
+            // for this call only
+            return std::make_shared<Indexed_values>();
+        }
+        Bound_values bound;
+        for(const auto& name : free_names) {
+            bound[name] = stack.Eval(name, ParametersCall<T>());
+        }
+        for(const auto& name : params_def.parameters_names()) {
+            bound[name] = stack.Eval(name, ParametersCall<T>());
+        }
+        for(const auto& definition : params_def.parameters_dict()) {
+            bound[definition.first] = stack.Eval(definition.first, ParametersCall<T>());
+        }
+        for(const auto& kwarg : params_call.parameters_dict()) {
+            bound[kwarg.first] = stack.Eval(kwarg.first, ParametersCall<T>());
+        }
+
+        if(!memos_) {
+            memos_ = std::make_shared<Sequence_memos>();
+        }
+        auto& memos = memos_->values;
+        if(memos_->definitions != stack.Definitions()) {
+            memos.clear();
+            memos_->definitions = stack.Definitions();
+        }
+        for(auto it = memos.begin(); it != memos.end(); ++it) {
+            if(SameValues(it->first, bound)) {
+                memos.splice(memos.begin(), memos, it);
+                return memos.front().second;
+            }
+        }
+        memos.emplace_front(std::move(bound), std::make_shared<Indexed_values>());
+        if(memos.size() > max_memos) {
+            memos.pop_back();
+        }
+        return memos.front().second;
+    }
+
+    // Names read by the definitions besides their own parameters and
+    // index, through the functions and sequences they call, that are
+    // values : the terms depend on them whatever scope binds them. False
+    // when a definition assigns a reference.
+    bool FreeNames(const ReferenceStack<T>& stack, std::set<std::string>& visited, std::set<std::string>& names) const {
+        const ExpressionDefinition<T>* definitions[] = {&general_expr_, &single_expr_};
+        for(const ExpressionDefinition<T>* definition : definitions) {
+            if(!FreeNames(*definition, stack, visited, names)) {
+                return false;
+            }
+        }
+        for(const auto& indexed : indexed_expr_) {
+            if(!FreeNames(indexed.second, stack, visited, names)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool FreeNames(const ExpressionDefinition<T>& definition, const ReferenceStack<T>& stack, std::set<std::string>& visited, std::set<std::string>& names) {
+        const ParametersDefinition<T>& params_def = std::get<0>(definition);
+        std::set<std::string> bound(params_def.parameters_names().begin(), params_def.parameters_names().end());
+        for(const auto& param : params_def.parameters_dict()) {
+            bound.insert(param.first);
+        }
+        if(!params_def.index_name().empty()) {
+            bound.insert(params_def.index_name());
+        }
+        return FreeNames(std::get<1>(definition).get(), bound, stack, visited, names);
+    }
+
+    static bool FreeNames(Expression<T>* expr, const std::set<std::string>& bound, const ReferenceStack<T>& stack, std::set<std::string>& visited, std::set<std::string>& names) {
+        if(!expr) {
+            return true;
+        }
+        switch(expr->Kind()) {
+        case ExpressionKind::Equal:
+            return false;
+        case ExpressionKind::Ref:
+        case ExpressionKind::Func:
+            if(!FreeName(expr->Name(), expr->Kind() == ExpressionKind::Func, bound, stack, visited, names)) {
+                return false;
+            }
+            break;
+        case ExpressionKind::RecursivePlaceholder: {
+            const ParametersCall<T>& call = static_cast<RecursivePlaceholderExpression<T>*>(expr)->params();
+            if(!call.index_name().empty() && !FreeName(call.index_name(), false, bound, stack, visited, names)) {
+                return false;
+            }
+            if(!FreeNames(call.subexpr().get(), bound, stack, visited, names)) {
+                return false;
+            }
+            for(const auto& param : call.parameters_expression()) {
+                if(!FreeNames(param.get(), bound, stack, visited, names)) {
+                    return false;
+                }
+            }
+            for(const auto& param : call.parameters_dict()) {
+                if(!FreeNames(param.second.get(), bound, stack, visited, names)) {
+                    return false;
+                }
+            }
+            break;
+        }
+        case ExpressionKind::Recursive:
+            if(!FreeNames(static_cast<RecursiveExpression<T>*>(expr)->recursive_expr().get(), bound, stack, visited, names)) {
+                return false;
+            }
+            break;
+        default:
+            break;
+        }
+        for(const auto& child : expr->children) {
+            if(!FreeNames(child.get(), bound, stack, visited, names)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // A function or a sequence is walked, a value or an undefined name is
+    // free, a built-in function is neither
+    static bool FreeName(const std::string& name, bool call, const std::set<std::string>& bound, const ReferenceStack<T>& stack, std::set<std::string>& visited, std::set<std::string>& names) {
+        if(bound.count(name) || visited.count(name) || names.count(name)) {
+            return true;
+        }
+        const Reference<T>* reference = stack.Find(name);
+        if(!reference) {
+            if(!call || !NativeFunctions<T>::Instance().Find(name)) {
+                names.insert(name);
+            }
+            return true;
+        }
+        if(reference->IsValue()) {
+            names.insert(name);
+            return true;
+        }
+        visited.insert(name);
+        return reference->FreeNames(stack, visited, names);
+    }
+
+    // Defined by a single expression without parameters nor index
+    bool IsValue() const {
+        const ParametersDefinition<T>& params_def = std::get<0>(single_expr_);
+        return !std::get<1>(general_expr_) && indexed_expr_.empty()
+                && params_def.parameters_names().empty() && params_def.parameters_dict().empty();
+    }
+
+    static bool SameValues(const Bound_values& a, const Bound_values& b) {
+        if(a.size() != b.size()) {
+            return false;
+        }
+        for(auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib) {
+            if(ia->first != ib->first || ia->second.Size() != ib->second.Size()) {
+                return false;
+            }
+            for(size_t i = 1; i <= ia->second.Size().first; ++i) {
+                for(size_t j = 1; j <= ia->second.Size().second; ++j) {
+                    if(!(ia->second(i,j) == ib->second(i,j))) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // f_n defined from f_(n-k) only, see RecursiveExprVisitor
+    static bool IsLinearRecursion(const ParametersDefinition<T>& params_def, const PExpression<T>& expr) {
+        return params_def.a() == 1 && params_def.b() == 0
+                && expr && expr->Kind() == ExpressionKind::Recursive;
+    }
+
+    // Detects f_n=f_(n-1)+g (or g+f_(n-1)) where g uses neither the terms
+    // nor a definition : the terms are then sums of g, see CompensatedSum
+    void UpdateSummation() {
+        previous_.reset();
+        summand_.reset();
+        const ParametersDefinition<T>& params_def = std::get<0>(general_expr_);
+        const PExpression<T>& expr = std::get<1>(general_expr_);
+        if(!IsLinearRecursion(params_def, expr)) {
+            return;
+        }
+        PExpression<T> body = static_cast<RecursiveExpression<T>*>(expr.get())->recursive_expr();
+        if(!body || body->Kind() != ExpressionKind::Add) {
+            return;
+        }
+        for(size_t i = 0; i < 2; ++i) {
+            if(IsPreviousTerm(params_def, body->children[i]) && !UsesSequence(body->children[1-i])) {
+                previous_ = body->children[i];
+                summand_ = body->children[1-i];
+                return;
+            }
+        }
+    }
+
+    static bool IsPreviousTerm(const ParametersDefinition<T>& params_def, const PExpression<T>& expr) {
+        if(!expr || expr->Kind() != ExpressionKind::RecursivePlaceholder) {
+            return false;
+        }
+        const ParametersCall<T>& call = static_cast<RecursivePlaceholderExpression<T>*>(expr.get())->params();
+        return call.a() == 1 && call.b() == -1 && !call.subexpr()
+                && call.index_name() == params_def.index_name()
+                && call.parameters_names() == params_def.parameters_names()
+                && call.parameters_dict().empty() && params_def.parameters_dict().empty();
+    }
+
+    bool UsesSequence(const PExpression<T>& expr) const {
+        if(!expr) {
+            return false;
+        }
+        switch(expr->Kind()) {
+        case ExpressionKind::Equal:
+        case ExpressionKind::RecursivePlaceholder:
+        case ExpressionKind::Recursive:
+            return true;
+        case ExpressionKind::Ref:
+        case ExpressionKind::Func:
+            if(expr->Name() == reference_name_) {
+                return true;
+            }
+            break;
+        default:
+            break;
+        }
+        for(const auto& child : expr->children) {
+            if(UsesSequence(child)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static const size_t max_index = std::numeric_limits<int>::max();
+    static const size_t max_memos = 16;
+
+    friend class SessionSnapshot<T>;
+    friend class JitCompiler<T>;
+    friend class CppExport<T>;
+
     friend struct GuardIndex;
     struct GuardIndex {
         GuardIndex(Reference<T>& reference, size_t index) :
@@ -267,7 +624,6 @@ private:
     }
 
     typedef std::map<size_t, ExpressionDefinition<T>> Indexed_expr;
-    typedef std::map<size_t, T> Indexed_values;
 
     std::string reference_name_;
 	
@@ -276,8 +632,19 @@ private:
 	
 	/* Associated expressions for indexed expression */
     Indexed_expr                indexed_expr_;
-    Indexed_values              memoized_index_;
+    std::shared_ptr<Indexed_values> memoized_index_;
+
+    /* Memos of the previous calls by values of the parameters, see Memo */
+    struct Sequence_memos {
+        Sequence_memos() : definitions(0) {}
+        size_t definitions;
+        std::list<std::pair<Bound_values, std::shared_ptr<Indexed_values>>> values;
+    };
+    std::shared_ptr<Sequence_memos> memos_;
     ExpressionDefinition<T> 	general_expr_;
+    // f_(n-1) and g of a general expression f_(n-1)+g, see UpdateSummation
+    PExpression<T>              previous_;
+    PExpression<T>              summand_;
 
     std::stack<size_t> index_stack_;
 	
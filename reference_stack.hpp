@@ -2,7 +2,10 @@
 #define EXPRESSION_STACK_HPP
 
 #include <string>
+#include <unordered_map>
 #include "mapstack.hpp"
+#include "eval_budget.hpp"
+#include "profiler.hpp"
 
 template <typename T>
 class Expression;
@@ -16,6 +19,15 @@ class ParametersDefinition;
 template <typename T>
 class ParametersCall;
 
+template <typename T>
+class SessionSnapshot;
+
+template <typename T>
+class JitCompiler;
+
+template <typename T>
+class CppExport;
+
 #include "reference.hpp"
 
 template <typename T>
@@ -23,10 +35,11 @@ class ReferenceStack {
 public:
 
     typedef Mapstack<std::string, Reference<T>> stack_type;
+    typedef std::shared_ptr<typename Reference<T>::Indexed_values> memo_type;
 
-    ReferenceStack() {
-        this->Set("pi", ParametersDefinition<T>(), PExpression<T>( new ValExpression<T>(T(3.1415926535898))));
-        this->Set("e",  ParametersDefinition<T>(), PExpression<T>( new ValExpression<T>(T(2.7182818284590))));
+    ReferenceStack() : definitions_(0) {
+        this->Set("pi", ParametersDefinition<T>(), PExpression<T>( new ValExpression<T>(T(Pi()))));
+        this->Set("e",  ParametersDefinition<T>(), PExpression<T>( new ValExpression<T>(T(E()))));
         stack_.Push();
     }
 
@@ -43,6 +56,17 @@ public:
         stack_.Set(ai_reference_name, reference);
     }
 
+    // Definition made by the user : the memoized terms of the sequences
+    // might depend on it and are invalidated, see Reference::Memo
+    void Define(const std::string& ai_reference_name, const ParametersDefinition<T>& ai_parameters, PExpression<T>  ai_expression) {
+        ++definitions_;
+        Set(ai_reference_name, ai_parameters, ai_expression);
+    }
+
+    size_t Definitions() const {
+        return definitions_;
+    }
+
 
     T Eval(const std::string& ai_reference_name, const ParametersCall<T>& ai_parameters)  {
         // Evaluation of an expression might mutate the internal stack_ object
@@ -51,6 +75,8 @@ public:
         // The context guard might have a huge impact on performance.
         // Consider to move it closer to the reference parameters assignation as a future optimisation.
         typename stack_type::Context guard(stack_);
+        EvaluationBudget::DepthGuard depth(budget_);
+        INKAMATH_PROFILE_REFERENCE(ai_reference_name);
 
         // Just evaluate the reference with the parameters if it's in the stack
         Reference<T> reference;
@@ -62,7 +88,29 @@ public:
         }
     }
 
+    bool Contains(const std::string& ai_reference_name) const {
+        return stack_.Contains(ai_reference_name);
+    }
+
+    // Visible reference without copy, nullptr when undefined
+    const Reference<T>* Find(const std::string& ai_reference_name) const {
+        return stack_.Find(ai_reference_name);
+    }
+
+    // Parameters and expression of a function defined by a single
+    // expression, without index nor sequence
+    bool FindSingleDefinition(const std::string& ai_reference_name, ParametersDefinition<T>& ao_parameters, PExpression<T>& ao_expression) const {
+        const Reference<T>* reference = Find(ai_reference_name);
+        if(!reference) {
+            return false;
+        }
+        std::tie(ao_parameters, ao_expression) = reference->SingleDefinition();
+        return ao_expression != nullptr;
+    }
+
     T SafeRecursiveEval(const std::string& ai_reference_name, const ParametersCall<T>& ai_parameters)  {
+        EvaluationBudget::DepthGuard depth(budget_);
+        INKAMATH_PROFILE_REFERENCE(ai_reference_name);
         // Just evaluate the reference with the parameters if it's in the stack
         Reference<T> reference;
         if(stack_.Get(ai_reference_name, reference)) {
@@ -80,7 +128,7 @@ public:
          using map_type = decltype(wrapped_exprs);
          using value_type = typename map_type::value_type;
          if(wrapped_exprs.size() != 0) {
-             dynarray<PExpression<T>> recursive_placeholders(wrapped_exprs.size());
+             expression_array<T> recursive_placeholders(wrapped_exprs.size());
              auto it = std::adjacent_find(wrapped_exprs.begin(), wrapped_exprs.end(),
                                 [](const value_type& a,
                                 const value_type& b) {
@@ -90,7 +138,7 @@ public:
                  size_t i = 0;
                  for(auto expr_tuple : wrapped_exprs) {
                      *std::get<0>(expr_tuple.second) = std::get<1>(expr_tuple.second);
-                     recursive_placeholders[i] = *std::get<0>(expr_tuple.second);
+                     recursive_placeholders[i++] = *std::get<0>(expr_tuple.second);
                  }
              }
              wrapped_recursive_expr = std::make_shared<RecursiveExpression<T>>(root_expr, std::move(recursive_placeholders));
@@ -105,16 +153,100 @@ public:
         typename stack_type::Context guard;
     };
 
+    // Memo of the terms of the sequence currently evaluated under this name
+    memo_type SequenceMemo(const std::string& ai_reference_name) const {
+        auto it = sequence_memos_.find(ai_reference_name);
+        return it != sequence_memos_.end() ? it->second : memo_type();
+    }
+
+    friend struct SequenceScope;
+    struct SequenceScope {
+    public:
+        SequenceScope(ReferenceStack<T>& stack, const std::string& name, memo_type memo)
+            : stack_(stack), name_(name), previous_(stack.SequenceMemo(name))
+        {
+            stack_.sequence_memos_[name_] = memo;
+        }
+        ~SequenceScope() {
+            if(previous_) {
+                stack_.sequence_memos_[name_] = previous_;
+            }
+            else {
+                stack_.sequence_memos_.erase(name_);
+            }
+        }
+    private:
+        ReferenceStack<T>& stack_;
+        std::string name_;
+        memo_type previous_;
+    };
+
+    EvaluationBudget& Budget() {
+        return budget_;
+    }
+
+    // Copy evaluated by another thread while this stack is left untouched :
+    // the memos of the sequences in progress are copied instead of shared,
+    // the memos of the previous calls are left behind and the budget is forked. The JIT compiler is not thread safe, the
+    // copy evaluates without it.
+    ReferenceStack<T> Fork() const {
+        ReferenceStack<T> fork(*this);
+        for(auto& memo : fork.sequence_memos_) {
+            memo.second = std::make_shared<typename Reference<T>::Indexed_values>(*memo.second);
+        }
+        fork.stack_.ForEachValue([](Reference<T>& reference) {
+            reference.ForkMemos();
+        });
+        fork.budget_ = budget_.Fork();
+#ifdef INKAMATH_JIT
+        fork.jit_.reset();
+#endif
+        return fork;
+    }
+
     void Pop() {
         stack_.Pop();
     }
 
+#ifdef INKAMATH_JIT
+    JitCompiler<T>* Jit() const {
+        return jit_.get();
+    }
+
+    void SetJit(std::shared_ptr<JitCompiler<T>> jit) {
+        jit_ = jit;
+    }
+#endif
+
     void Clear() {
+        ++definitions_;
         stack_.Clear();
     }
 
 private:
+    friend class SessionSnapshot<T>;
+    friend class CppExport<T>;
+
+    typedef typename T::value_type value_type;
+    // the double scalars keep the historical 14 digits constants, the other
+    // ones (BigFloat) compute them at their precision
+    static const bool floating = std::is_floating_point<typename numeric_interface_imp_types<value_type>::abs>::value;
+
+    static value_type Pi() {
+        return floating ? value_type(3.1415926535898) : value_type(4)*numeric_interface<value_type>::atan(value_type(1));
+    }
+
+    static value_type E() {
+        return floating ? value_type(2.7182818284590) : numeric_interface<value_type>::exp(value_type(1));
+    }
+
     mutable stack_type stack_;
+    std::unordered_map<std::string, memo_type> sequence_memos_;
+    size_t definitions_;
+    EvaluationBudget budget_;
+#ifdef INKAMATH_JIT
+    std::shared_ptr<JitCompiler<T>> jit_;
+#endif
 };
 
 #endif // EXPRESSION_STACK_HPP
@@ -0,0 +1,505 @@
+#ifndef H_SESSION
+#define H_SESSION
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "expression.hpp"
+#include "expression_visitor.hpp"
+#include "reference_stack.hpp"
+#include "matrix_io.hpp" // MappedFile
+
+/**
+ ***************************************
+ * Session snapshots.
+ *
+ * The definitions of a ReferenceStack (parsed and wrapped expressions,
+ * parameters definitions, indexed expressions) are written as a table of
+ * nodes followed by the references pointing into it. Nodes are written
+ * after the nodes they use, so a snapshot is loaded in one pass without
+ * lexing, parsing nor RecursiveExprVisitor, and nodes shared in memory
+ * (recursive placeholders) are shared again after loading.
+ *
+ * Header (native byte order, rejected on a host of another one) :
+ *   "INKASES1", uint32 version, uint32 byte order mark,
+ *   uint32 sizeof(element), uint32 reserved, uint64 nodes, uint64 references
+ *
+ * The memos of the sequences kept across calls (Reference::Memo) are not
+ * part of the session : their terms are valid for the definitions of the
+ * whole stack they were computed in, and a snapshot is added to a stack
+ * that may define other references. Load invalidates every memo, the
+ * first calls after it compute the terms again.
+ ***************************************
+ */
+
+static const uint32_t session_version = 1;
+
+template <typename T>
+class SessionSnapshot
+{
+public:
+    typedef typename T::value_type element_type;
+
+    static void Save(ReferenceStack<T>& stack, const std::string& path) {
+        SessionSnapshot<T> snapshot;
+        std::string body = snapshot.Write(stack);
+
+        std::string header;
+        Put(header, magic, sizeof(magic));
+        Put(header, session_version);
+        Put(header, byte_order_mark);
+        Put(header, uint32_t(sizeof(element_type)));
+        Put(header, uint32_t(0));
+        Put(header, uint64_t(snapshot.nodes_count_));
+        Put(header, uint64_t(snapshot.references_count_));
+
+        std::ofstream file(path.c_str(), std::ios::binary);
+        if(!file) throw std::runtime_error("Failed to open " + path + ".\n");
+        file.write(header.data(), header.size());
+        file.write(body.data(), body.size());
+        if(!file) throw std::runtime_error("Failed to write " + path + ".\n");
+    }
+
+    // Adds the definitions of the snapshot to the stack, replacing the
+    // references of the same names. Returns the number of references.
+    static size_t Load(ReferenceStack<T>& stack, const std::string& path) {
+        MappedFile file(path);
+        Reader in(file.data(), file.size(), path);
+
+        char m[sizeof(magic)];
+        in.Bytes(m, sizeof(m));
+        if(std::memcmp(m, magic, sizeof(magic)) != 0) {
+            throw std::runtime_error(path + " is not a session file.\n");
+        }
+        if(in.template Get<uint32_t>() != session_version) {
+            throw std::runtime_error(path + " : unsupported session version.\n");
+        }
+        if(in.template Get<uint32_t>() != byte_order_mark
+                || in.template Get<uint32_t>() != sizeof(element_type)) {
+            throw std::runtime_error(path + " was saved on an incompatible platform.\n");
+        }
+        in.template Get<uint32_t>();
+        const uint64_t nodes_count = in.template Get<uint64_t>();
+        const uint64_t references_count = in.template Get<uint64_t>();
+
+        SessionSnapshot<T> snapshot;
+        for(uint64_t i = 0; i < nodes_count; ++i) {
+            snapshot.nodes_.push_back(snapshot.ReadNode(in));
+        }
+        std::vector<std::pair<std::string, Reference<T>>> references;
+        for(uint64_t i = 0; i < references_count; ++i) {
+            references.push_back(snapshot.ReadReference(in));
+        }
+        // nothing is changed before the whole file is read
+        for(auto& reference : references) {
+            stack.stack_.Set(reference.first, reference.second);
+        }
+        ++stack.definitions_;
+        return references.size();
+    }
+
+private:
+    enum Node : uint8_t {
+        NodeEqual, NodeAdd, NodeNeg, NodeMult, NodeDiv, NodeLeftDiv, NodePow,
+        NodeFact, NodeVal, NodeMat, NodeRef, NodeFunc,
+        NodeRecursivePlaceholder, NodeRecursive
+    };
+
+    static const uint32_t null_node = 0xffffffff;
+    static const uint32_t byte_order_mark = 0x01020304;
+    static const char magic[8];
+
+    SessionSnapshot() : nodes_count_(0), references_count_(0) {}
+
+    template <typename V>
+    static void Put(std::string& out, V v) {
+        static_assert(std::is_trivially_copyable<V>::value, "raw copy");
+        out.append(reinterpret_cast<const char*>(&v), sizeof(V));
+    }
+
+    static void Put(std::string& out, const char* p, size_t n) {
+        out.append(p, n);
+    }
+
+    static void PutString(std::string& out, const std::string& s) {
+        Put(out, uint32_t(s.size()));
+        out.append(s);
+    }
+
+    // Bounds checked reads from the mapped file
+    class Reader {
+    public:
+        Reader(const char* p, size_t size, const std::string& path)
+            : p_(p), end_(p+size), path_(path) {}
+
+        void Bytes(void* dest, size_t n) {
+            if(size_t(end_-p_) < n) {
+                throw std::runtime_error(path_ + " is truncated.\n");
+            }
+            std::memcpy(dest, p_, n);
+            p_ += n;
+        }
+
+        template <typename V>
+        V Get() {
+            V v;
+            Bytes(&v, sizeof(V));
+            return v;
+        }
+
+        std::string String() {
+            const uint32_t n = Get<uint32_t>();
+            if(size_t(end_-p_) < n) {
+                throw std::runtime_error(path_ + " is truncated.\n");
+            }
+            std::string s(p_, n);
+            p_ += n;
+            return s;
+        }
+
+        size_t Remaining() const {
+            return size_t(end_-p_);
+        }
+
+        void Corrupted() const {
+            throw std::runtime_error(path_ + " is corrupted.\n");
+        }
+
+    private:
+        const char* p_;
+        const char* end_;
+        const std::string& path_;
+    };
+
+    // Writes the nodes below an expression before the expression itself
+    class NodeWriter : public TransformationVisitor<T> {
+    public:
+        NodeWriter(SessionSnapshot<T>& snapshot) : snapshot_(snapshot) {}
+
+        virtual PExpression<T> visit(EqualExpression<T>* expr) {return Binary(NodeEqual, expr);}
+        virtual PExpression<T> visit(AddExpression<T>* expr) {return Binary(NodeAdd, expr);}
+        virtual PExpression<T> visit(MultExpression<T>* expr) {return Binary(NodeMult, expr);}
+        virtual PExpression<T> visit(DivExpression<T>* expr) {return Binary(NodeDiv, expr);}
+        virtual PExpression<T> visit(LeftDivExpression<T>* expr) {return Binary(NodeLeftDiv, expr);}
+        virtual PExpression<T> visit(PowExpression<T>* expr) {return Binary(NodePow, expr);}
+        virtual PExpression<T> visit(NegExpression<T>* expr) {return Unary(NodeNeg, expr);}
+        virtual PExpression<T> visit(FactExpression<T>* expr) {return Unary(NodeFact, expr);}
+
+        virtual PExpression<T> visit(ValExpression<T>* expr) {
+            static_assert(std::is_trivially_copyable<element_type>::value, "raw copy of the elements");
+            std::string& out = snapshot_.nodes_out_;
+            Put(out, uint8_t(NodeVal));
+            Put(out, uint64_t(expr->value.Size().first));
+            Put(out, uint64_t(expr->value.Size().second));
+            expr->value.ForEachRow([&](size_t, const element_type* row) {
+                Put(out, reinterpret_cast<const char*>(row), expr->value.Size().second*sizeof(element_type));
+            });
+            return PExpression<T>();
+        }
+
+        virtual PExpression<T> visit(MatExpression<T>* expr) {
+            std::vector<uint32_t> ids = Ids(expr->children);
+            std::string& out = snapshot_.nodes_out_;
+            Put(out, uint8_t(NodeMat));
+            Put(out, uint64_t(expr->Size().first));
+            Put(out, uint64_t(expr->Size().second));
+            for(uint32_t id : ids) Put(out, id);
+            return PExpression<T>();
+        }
+
+        virtual PExpression<T> visit(RefExpression<T>* expr) {
+            std::string& out = snapshot_.nodes_out_;
+            Put(out, uint8_t(NodeRef));
+            PutString(out, expr->Name());
+            return PExpression<T>();
+        }
+
+        virtual PExpression<T> visit(FuncExpression<T>* expr) {
+            const uint32_t e1 = snapshot_.Id(expr->m_e1());
+            const uint32_t e2 = snapshot_.Id(expr->m_e2());
+            std::string& out = snapshot_.nodes_out_;
+            Put(out, uint8_t(NodeFunc));
+            PutString(out, expr->Name());
+            Put(out, e1);
+            Put(out, e2);
+            return PExpression<T>();
+        }
+
+        virtual PExpression<T> visit(RecursivePlaceholderExpression<T>* expr) {
+            std::string params = snapshot_.WriteCall(expr->params());
+            std::string& out = snapshot_.nodes_out_;
+            Put(out, uint8_t(NodeRecursivePlaceholder));
+            PutString(out, expr->Name());
+            out.append(params);
+            return PExpression<T>();
+        }
+
+        virtual PExpression<T> visit(RecursiveExpression<T>* expr) {
+            const uint32_t e = snapshot_.Id(expr->recursive_expr());
+            std::vector<uint32_t> ids = Ids(expr->children);
+            std::string& out = snapshot_.nodes_out_;
+            Put(out, uint8_t(NodeRecursive));
+            Put(out, e);
+            Put(out, uint32_t(ids.size()));
+            for(uint32_t id : ids) Put(out, id);
+            return PExpression<T>();
+        }
+
+    private:
+        template <typename E>
+        PExpression<T> Binary(Node kind, E* expr) {
+            const uint32_t e1 = snapshot_.Id(expr->m_e1());
+            const uint32_t e2 = snapshot_.Id(expr->m_e2());
+            std::string& out = snapshot_.nodes_out_;
+            Put(out, uint8_t(kind));
+            Put(out, e1);
+            Put(out, e2);
+            return PExpression<T>();
+        }
+
+        template <typename E>
+        PExpression<T> Unary(Node kind, E* expr) {
+            const uint32_t e = snapshot_.Id(expr->m_e());
+            std::string& out = snapshot_.nodes_out_;
+            Put(out, uint8_t(kind));
+            Put(out, e);
+            return PExpression<T>();
+        }
+
+        std::vector<uint32_t> Ids(const expression_array<T>& children) {
+            std::vector<uint32_t> ids;
+            for(const auto& child : children) ids.push_back(snapshot_.Id(child));
+            return ids;
+        }
+
+        SessionSnapshot<T>& snapshot_;
+    };
+
+    // Index of the node of expr in the table, written on first use
+    uint32_t Id(const PExpression<T>& expr) {
+        if(!expr) return null_node;
+        auto it = ids_.find(expr.get());
+        if(it != ids_.end()) return it->second;
+        NodeWriter writer(*this);
+        expr->accept(writer);
+        const uint32_t id = uint32_t(nodes_count_++);
+        ids_[expr.get()] = id;
+        return id;
+    }
+
+    std::string WriteCall(const ParametersCall<T>& params) {
+        std::string out;
+        Put(out, uint32_t(params.parameters_names_.size()));
+        for(const auto& name : params.parameters_names_) PutString(out, name);
+        Put(out, uint32_t(params.parameters_exprs_.size()));
+        for(const auto& expr : params.parameters_exprs_) Put(out, Id(expr));
+        WriteDict(out, params.parameters_dict_);
+        PutString(out, params.index_name_);
+        Put(out, Id(params.subexpr_));
+        Put(out, int32_t(params.a_));
+        Put(out, int32_t(params.b_));
+        Put(out, uint8_t(params.indexed_));
+        return out;
+    }
+
+    void WriteDict(std::string& out, const ExprDict<T>& dict) {
+        std::vector<std::string> names;
+        for(const auto& entry : dict) names.push_back(entry.first);
+        std::sort(names.begin(), names.end());
+        Put(out, uint32_t(names.size()));
+        for(const auto& name : names) {
+            PutString(out, name);
+            Put(out, Id(dict.at(name)));
+        }
+    }
+
+    void WriteDefinition(std::string& out, const ExpressionDefinition<T>& definition) {
+        const ParametersDefinition<T>& params = std::get<0>(definition);
+        Put(out, uint32_t(params.parameters_names_.size()));
+        for(const auto& name : params.parameters_names_) PutString(out, name);
+        WriteDict(out, params.parameters_dict_);
+        PutString(out, params.index_name_);
+        Put(out, int32_t(params.a_));
+        Put(out, int32_t(params.b_));
+        Put(out, uint8_t(params.indexed_));
+        Put(out, Id(std::get<1>(definition)));
+    }
+
+    std::string Write(ReferenceStack<T>& stack) {
+        std::vector<std::string> names;
+        for(auto it = stack.stack_.begin(); it != stack.stack_.end(); ++it) {
+            names.push_back(std::get<0>(*it));
+        }
+        std::sort(names.begin(), names.end()); // reproducible files
+
+        std::string references;
+        for(const auto& name : names) {
+            Reference<T> reference;
+            stack.stack_.Get(name, reference);
+            PutString(references, name);
+            WriteDefinition(references, reference.single_expr_);
+            WriteDefinition(references, reference.general_expr_);
+            Put(references, uint32_t(reference.indexed_expr_.size()));
+            for(const auto& indexed : reference.indexed_expr_) {
+                Put(references, uint64_t(indexed.first));
+                WriteDefinition(references, indexed.second);
+            }
+            ++references_count_;
+        }
+        return nodes_out_ + references;
+    }
+
+    PExpression<T> Node(Reader& in) {
+        const uint32_t id = in.template Get<uint32_t>();
+        if(id == null_node) return PExpression<T>();
+        if(id >= nodes_.size()) in.Corrupted();
+        return nodes_[id];
+    }
+
+    PExpression<T> RequiredNode(Reader& in) {
+        PExpression<T> e = Node(in);
+        if(!e) in.Corrupted();
+        return e;
+    }
+
+    PExpression<T> ReadNode(Reader& in) {
+        const uint8_t kind = in.template Get<uint8_t>();
+        switch(kind) {
+        case NodeEqual: {
+            PExpression<T> e1 = RequiredNode(in);
+            return std::make_shared<EqualExpression<T>>(e1, RequiredNode(in));
+        }
+        case NodeAdd: {
+            PExpression<T> e1 = RequiredNode(in);
+            return std::make_shared<AddExpression<T>>(e1, RequiredNode(in));
+        }
+        case NodeMult: {
+            PExpression<T> e1 = RequiredNode(in);
+            return std::make_shared<MultExpression<T>>(e1, RequiredNode(in));
+        }
+        case NodeDiv: {
+            PExpression<T> e1 = RequiredNode(in);
+            return std::make_shared<DivExpression<T>>(e1, RequiredNode(in));
+        }
+        case NodeLeftDiv: {
+            PExpression<T> e1 = RequiredNode(in);
+            return std::make_shared<LeftDivExpression<T>>(e1, RequiredNode(in));
+        }
+        case NodePow: {
+            PExpression<T> e1 = RequiredNode(in);
+            return std::make_shared<PowExpression<T>>(e1, RequiredNode(in));
+        }
+        case NodeNeg:
+            return std::make_shared<NegExpression<T>>(RequiredNode(in));
+        case NodeFact:
+            return std::make_shared<FactExpression<T>>(RequiredNode(in));
+        case NodeVal: {
+            const uint64_t rows = in.template Get<uint64_t>();
+            const uint64_t cols = in.template Get<uint64_t>();
+            if(rows == 0 || cols == 0 || cols > in.Remaining()/sizeof(element_type)/rows) in.Corrupted();
+            T value(static_cast<size_t>(rows), static_cast<size_t>(cols));
+            in.Bytes(value.data(), size_t(rows*cols*sizeof(element_type)));
+            return std::make_shared<ValExpression<T>>(value);
+        }
+        case NodeMat: {
+            const uint64_t n = in.template Get<uint64_t>();
+            const uint64_t m = in.template Get<uint64_t>();
+            if(n == 0 || m == 0 || m > in.Remaining()/sizeof(uint32_t)/n) in.Corrupted();
+            expression_array<T> children(size_t(n*m));
+            for(auto& child : children) child = RequiredNode(in);
+            return std::make_shared<MatExpression<T>>(size_t(n), size_t(m), std::move(children));
+        }
+        case NodeRef:
+            return std::make_shared<RefExpression<T>>(in.String());
+        case NodeFunc: {
+            PExpression<T> ref = std::make_shared<RefExpression<T>>(in.String());
+            PExpression<T> e1 = Node(in);
+            return std::make_shared<FuncExpression<T>>(ref, e1, Node(in));
+        }
+        case NodeRecursivePlaceholder: {
+            std::string name = in.String();
+            return std::make_shared<RecursivePlaceholderExpression<T>>(name, ReadCall(in));
+        }
+        case NodeRecursive: {
+            PExpression<T> e = RequiredNode(in);
+            const uint32_t count = in.template Get<uint32_t>();
+            if(count > in.Remaining()/sizeof(uint32_t)) in.Corrupted();
+            expression_array<T> placeholders(count);
+            for(auto& placeholder : placeholders) placeholder = RequiredNode(in);
+            return std::make_shared<RecursiveExpression<T>>(e, std::move(placeholders));
+        }
+        default:
+            in.Corrupted();
+        }
+        return PExpression<T>();
+    }
+
+    void ReadDict(Reader& in, ExprDict<T>& dict) {
+        const uint32_t count = in.template Get<uint32_t>();
+        for(uint32_t i = 0; i < count; ++i) {
+            std::string name = in.String();
+            dict[name] = RequiredNode(in);
+        }
+    }
+
+    ParametersCall<T> ReadCall(Reader& in) {
+        ParametersCall<T> params;
+        uint32_t count = in.template Get<uint32_t>();
+        for(uint32_t i = 0; i < count; ++i) params.parameters_names_.push_back(in.String());
+        count = in.template Get<uint32_t>();
+        for(uint32_t i = 0; i < count; ++i) params.parameters_exprs_.push_back(RequiredNode(in));
+        ReadDict(in, params.parameters_dict_);
+        params.index_name_ = in.String();
+        params.subexpr_ = Node(in);
+        params.a_ = in.template Get<int32_t>();
+        params.b_ = in.template Get<int32_t>();
+        params.indexed_ = in.template Get<uint8_t>() != 0;
+        return params;
+    }
+
+    ExpressionDefinition<T> ReadDefinition(Reader& in) {
+        ParametersDefinition<T> params;
+        const uint32_t count = in.template Get<uint32_t>();
+        for(uint32_t i = 0; i < count; ++i) params.parameters_names_.push_back(in.String());
+        ReadDict(in, params.parameters_dict_);
+        params.index_name_ = in.String();
+        params.a_ = in.template Get<int32_t>();
+        params.b_ = in.template Get<int32_t>();
+        params.indexed_ = in.template Get<uint8_t>() != 0;
+        return ExpressionDefinition<T>(params, Node(in));
+    }
+
+    std::pair<std::string, Reference<T>> ReadReference(Reader& in) {
+        std::pair<std::string, Reference<T>> named;
+        named.first = in.String();
+        Reference<T>& reference = named.second;
+        reference.reference_name_ = named.first;
+        reference.single_expr_ = ReadDefinition(in);
+        reference.general_expr_ = ReadDefinition(in);
+        const uint32_t count = in.template Get<uint32_t>();
+        for(uint32_t i = 0; i < count; ++i) {
+            const uint64_t index = in.template Get<uint64_t>();
+            reference.indexed_expr_[size_t(index)] = ReadDefinition(in);
+        }
+        reference.UpdateSummation();
+        return named;
+    }
+
+    std::string nodes_out_;
+    size_t nodes_count_;
+    size_t references_count_;
+    std::unordered_map<const Expression<T>*, uint32_t> ids_;
+    std::vector<PExpression<T>> nodes_;
+};
+
+template <typename T>
+const char SessionSnapshot<T>::magic[8] = {'I','N','K','A','S','E','S','1'};
+
+#endif // H_SESSION
@@ -0,0 +1,92 @@
+#ifndef H_SPARSE
+#define H_SPARSE
+
+#include <vector>
+#include <algorithm>
+
+#include "alloc_tracker.hpp"
+
+/**
+ ***************************************
+ * Compressed sparse row (CSR) storage of a Matrix.
+ *
+ * The nonzero elements of row i are values[row_begin[i]..row_begin[i+1])
+ * at the (0-based, increasing) columns of the same range of columns.
+ * A storage is built row by row with Push and EndRow, then shared,
+ * immutable, by the copies of a matrix : a mutating access converts the
+ * matrix to a dense buffer (Matrix::Densify). The const accesses read
+ * the storage itself (At, ExpandRow) : no dense copy is kept with it.
+ * A matrix of at least min_size elements is worth storing sparse when at
+ * most one element out of ratio is nonzero (IsWorth).
+ ***************************************
+ */
+
+template <typename T>
+class SparseStorage
+{
+public:
+    static const size_t min_size = 1024;
+    static const size_t ratio = 8;
+
+    static bool IsWorth(size_t rows, size_t cols, size_t nonzeros)
+    {
+        return rows*cols >= min_size && nonzeros*ratio <= rows*cols;
+    }
+
+    SparseStorage(size_t rows, size_t cols) : row_begin(rows+1, 0), cols_(cols) {}
+
+    SparseStorage(const SparseStorage&) = delete;
+    SparseStorage& operator=(const SparseStorage&) = delete;
+
+    // Appends the element at col of the row being built
+    void Push(size_t col, const T& value)
+    {
+        columns.push_back(col);
+        values.push_back(value);
+    }
+
+    // Ends the row (rows are built in order)
+    void EndRow(size_t row)
+    {
+        row_begin[row+1] = values.size();
+    }
+
+    // Called once built
+    void Record() const
+    {
+        AllocationTracker::Record(AllocMatrix, values.size()*(sizeof(T)+sizeof(size_t)) + row_begin.size()*sizeof(size_t));
+    }
+
+    size_t Nonzeros() const
+    {
+        return values.size();
+    }
+
+    // Element (i, j), 0-based
+    T At(size_t i, size_t j) const
+    {
+        auto begin = columns.begin()+row_begin[i];
+        auto end = columns.begin()+row_begin[i+1];
+        auto it = std::lower_bound(begin, end, j);
+        return (it != end && *it == j) ? values[it-columns.begin()] : T(0);
+    }
+
+    // Row i expanded in a buffer of cols elements
+    void ExpandRow(size_t i, T* row) const
+    {
+        std::fill_n(row, cols_, T(0));
+        for (size_t k = row_begin[i]; k < row_begin[i+1]; ++k)
+        {
+            row[columns[k]] = values[k];
+        }
+    }
+
+    std::vector<size_t> row_begin;
+    std::vector<size_t> columns;
+    std::vector<T> values;
+
+private:
+    size_t cols_;
+};
+
+#endif // H_SPARSE
@@ -0,0 +1,89 @@
+#ifndef H_SUMMATION
+#define H_SUMMATION
+
+#include <cmath>
+#include <complex>
+#include <type_traits>
+
+/**
+ ***************************************
+ * Compensated summation (Neumaier's variant of Kahan's algorithm).
+ *
+ * CompensatedSum accumulates matrices element by element : the rounding
+ * error of each addition is kept apart and added back by Value(), so a
+ * long sum of decreasing terms (a series) loses about one rounding instead
+ * of one per term. The additions themselves are Matrix additions, with
+ * their size checks. The complex elements are compensated per component,
+ * the other element types are summed without compensation.
+ ***************************************
+ */
+
+template <typename V, bool floating = std::is_floating_point<V>::value>
+struct summation_error
+{
+    // nothing to compensate
+    static void Add(V&, const V&, const V&, const V&) {}
+};
+
+template <typename V>
+struct summation_error<V, true>
+{
+    // error of t = s + x added to c
+    static void Add(V& c, const V& s, const V& x, const V& t) {
+        if(std::abs(s) >= std::abs(x)) {
+            c += (s - t) + x;
+        }
+        else {
+            c += (x - t) + s;
+        }
+    }
+};
+
+template <typename R>
+struct summation_error<std::complex<R>, false>
+{
+    static void Add(std::complex<R>& c, const std::complex<R>& s, const std::complex<R>& x, const std::complex<R>& t) {
+        R re = c.real(), im = c.imag();
+        summation_error<R>::Add(re, s.real(), x.real(), t.real());
+        summation_error<R>::Add(im, s.imag(), x.imag(), t.imag());
+        c = std::complex<R>(re, im);
+    }
+};
+
+template <typename T>
+class CompensatedSum
+{
+public:
+    typedef typename T::value_type value_type;
+
+    // the error of each element is tracked : the sum is dense
+    explicit CompensatedSum(const T& start = T()) : sum_(start.ToDense()), error_(start.Size().first, start.Size().second) {}
+
+    void Add(const T& term) {
+        const T x = term.ToDense();
+        T t = sum_ + x;
+        if(error_.Size() != t.Size()) {
+            error_ = T(t.Size().first, t.Size().second);
+        }
+        const value_type* s = sum_.data();
+        const value_type* px = x.data();
+        value_type* c = error_.data();
+        const value_type* pt = t.data();
+        if(sum_.Size() == t.Size() && x.Size() == t.Size()) {
+            for(size_t i = 0, n = t.Size().first*t.Size().second; i < n; ++i) {
+                summation_error<value_type>::Add(c[i], s[i], px[i], pt[i]);
+            }
+        }
+        sum_ = t;
+    }
+
+    T Value() const {
+        return sum_ + error_;
+    }
+
+private:
+    T sum_;
+    T error_;
+};
+
+#endif // H_SUMMATION
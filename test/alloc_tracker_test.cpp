@@ -0,0 +1,63 @@
+#include "alloc_tracker.hpp"
+#include "dynarraylike.hpp"
+#include "matrix.hpp"
+#include "interpreter.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+struct AllocationFixture {
+    AllocationFixture() {
+        AllocationTracker::Reset();
+    }
+    ~AllocationFixture() {
+        AllocationTracker::SetHook(nullptr);
+    }
+};
+
+BOOST_FIXTURE_TEST_SUITE(alloc_tracker_tests, AllocationFixture)
+
+BOOST_AUTO_TEST_CASE( counters )
+{
+    Matrix<double> a(2, 3);
+    dynarray<int> b(4);
+    AllocationCounters counters = AllocationTracker::Counters();
+    BOOST_CHECK_EQUAL(counters.count[AllocMatrix], 1);
+    BOOST_CHECK_EQUAL(counters.bytes[AllocMatrix], 6*sizeof(double));
+    BOOST_CHECK_EQUAL(counters.count[AllocDynarray], 1);
+    BOOST_CHECK_EQUAL(counters.bytes[AllocDynarray], 4*sizeof(int));
+
+    // copies share the matrix buffer
+    Matrix<double> c(a);
+    BOOST_CHECK_EQUAL(AllocationTracker::Counters().count[AllocMatrix], 1);
+}
+
+BOOST_AUTO_TEST_CASE( expression_bytes )
+{
+    typedef Matrix<double> M;
+    PExpression<M> a = std::make_shared<ValExpression<M>>(M(1.0));
+    PExpression<M> b = std::make_shared<RefExpression<M>>("x");
+    PExpression<M> sum = std::make_shared<AddExpression<M>>(a, b);
+    AllocationCounters counters = AllocationTracker::Counters();
+    BOOST_CHECK_EQUAL(counters.count[AllocExpression], 3);
+    BOOST_CHECK_EQUAL(counters.bytes[AllocExpression],
+                      sizeof(ValExpression<M>) + sizeof(RefExpression<M>) + sizeof(AddExpression<M>));
+}
+
+void refuse_matrices(AllocCategory category, size_t)
+{
+    if(category == AllocMatrix) {
+        throw std::bad_alloc();
+    }
+}
+
+BOOST_AUTO_TEST_CASE( hook )
+{
+    AllocationTracker::SetHook(&refuse_matrices);
+    BOOST_CHECK_THROW(Matrix<double>(2, 2), std::bad_alloc);
+    BOOST_CHECK_NO_THROW(dynarray<int>(2));
+    BOOST_CHECK_EQUAL(AllocationTracker::Counters().count[AllocMatrix], 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
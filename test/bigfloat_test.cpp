@@ -0,0 +1,130 @@
+#include "bigfloat.hpp"
+#include "interpreter.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <complex>
+#include <string>
+
+typedef BigFloat<50> B50;
+typedef BigFloat<1000> B1000;
+
+template <typename B>
+std::string last_digits(const B& a, size_t n)
+{
+    std::string s = B::toString(a);
+    return s.substr(s.size()-n);
+}
+
+template <typename B>
+B parse(const char* s)
+{
+    B a;
+    char* end;
+    BOOST_REQUIRE(B::parse(a, s, end));
+    return a;
+}
+
+BOOST_AUTO_TEST_SUITE(bigfloat_tests)
+
+BOOST_AUTO_TEST_CASE( constants )
+{
+    BOOST_CHECK_EQUAL(B50::toString(B50::Pi()), "3.1415926535897932384626433832795028841971693993751");
+    BOOST_CHECK_EQUAL(B50::toString(B50::exp(B50(1))), "2.7182818284590452353602874713526624977572470937");
+    BOOST_CHECK_EQUAL(B50::toString(B50::log(B50(2))), "0.69314718055994530941723212145817656807550013436026");
+    BOOST_CHECK_EQUAL(B50::toString(B50::sqrt(B50(2))), "1.4142135623730950488016887242096980785696718753769");
+
+    // last of the 1000 digits
+    BOOST_CHECK_EQUAL(last_digits(B1000::Pi(), 20), "76611195909216420199");
+    BOOST_CHECK_EQUAL(last_digits(B1000::exp(B1000(1)), 20), "21267154688957035035");
+    BOOST_CHECK_EQUAL(last_digits(B1000::log(B1000(2)), 20), "56872747782344535348");
+    BOOST_CHECK_EQUAL(last_digits(B1000::sqrt(B1000(2)), 20), "58215212822951848847");
+}
+
+BOOST_AUTO_TEST_CASE( arithmetic )
+{
+    const B50 third = B50(1)/B50(3);
+    BOOST_CHECK_EQUAL(B50::toString(third), "0.33333333333333333333333333333333333333333333333333");
+    BOOST_CHECK(B50::abs(third*B50(3) - B50(1)) < B50(1e-48));
+    BOOST_CHECK_EQUAL(B50::toString(third*B50(3)), "1");
+    BOOST_CHECK_EQUAL(B50::toString(B50(1)/B50(7)*B50(7)), "1");
+    BOOST_CHECK_EQUAL(B50::toString(B50::pow(B50(10), B50(300))*B50::pow(B50(10), B50(300))), "1e+600");
+    BOOST_CHECK_EQUAL(B50::toString(B50::fact(B50(30))), "265252859812191058636308480000000");
+    BOOST_CHECK_EQUAL(B50::toString(B50(1e20) + B50(1) - B50(1e20)), "1");
+    BOOST_CHECK(B50(-2) < B50(1) && B50(0.5) > B50(0.25) && -B50(3) == B50(-3));
+
+    // quotients by one limb and by several limbs
+    const B50 x = parse<B50>("123456789.123456789123456789123456789");
+    BOOST_CHECK(B50::abs(x/B50(7)*B50(7) - x) < B50(1e-40));
+    BOOST_CHECK(B50::abs(x/x - B50(1)) < B50(1e-48));
+    BOOST_CHECK(B50::abs(x*(B50(1)/x) - B50(1)) < B50(1e-48));
+
+    BOOST_CHECK((B50(1)/B50(0)).IsInf());
+    BOOST_CHECK((B50(0)/B50(0)).IsNaN());
+    BOOST_CHECK(B50::sqrt(B50(-1)).IsNaN());
+    BOOST_CHECK_EQUAL(B50::toString(-B50(1)/B50(0)), "-inf");
+}
+
+BOOST_AUTO_TEST_CASE( functions )
+{
+    const B50 x = parse<B50>("0.7");
+    const B50 tolerance(1e-48);
+    const B50 s = B50::sin(x), c = B50::cos(x);
+    BOOST_CHECK(B50::abs(s*s + c*c - B50(1)) < tolerance);
+    BOOST_CHECK(B50::abs(B50::tan(x) - s/c) < tolerance);
+    BOOST_CHECK(B50::abs(B50::asin(s) - x) < tolerance);
+    BOOST_CHECK(B50::abs(B50::acos(c) - x) < tolerance);
+    BOOST_CHECK(B50::abs(B50::atan(B50::tan(x)) - x) < tolerance);
+    BOOST_CHECK(B50::abs(B50::log(B50::exp(x)) - x) < tolerance);
+    BOOST_CHECK(B50::abs(B50::cosh(x)*B50::cosh(x) - B50::sinh(x)*B50::sinh(x) - B50(1)) < tolerance);
+    BOOST_CHECK(B50::abs(B50::pow(B50(2), x) - B50::exp(x*B50::log(B50(2)))) < tolerance);
+    BOOST_CHECK(B50::abs(B50::sin(B50(1000)) - B50(0.8268795405320025)) < B50(1e-15));
+
+    // Gamma(1/2)^2 = pi, Gamma(-1/2) = -2 sqrt(pi)
+    const B50 g = B50::gamma(B50(0.5));
+    BOOST_CHECK(B50::abs(g*g - B50::Pi()) < B50(1e-47));
+    BOOST_CHECK(B50::abs(B50::gamma(B50(-0.5)) + B50(2)*B50::sqrt(B50::Pi())) < B50(1e-47));
+    BOOST_CHECK_EQUAL(B50::toString(B50::gamma(B50(6))), "120");
+}
+
+BOOST_AUTO_TEST_CASE( parse_format )
+{
+    char* end;
+    B50 a;
+    const char* s = "2.5e-3+x";
+    BOOST_CHECK(B50::parse(a, s, end));
+    BOOST_CHECK_EQUAL(end, s+6);
+    BOOST_CHECK_EQUAL(B50::toString(a), "0.0025");
+    s = "2e";
+    BOOST_CHECK(B50::parse(a, s, end));
+    BOOST_CHECK_EQUAL(end, s+1);
+    s = "x";
+    BOOST_CHECK(!B50::parse(a, s, end));
+    BOOST_CHECK_EQUAL(end, s);
+
+    BOOST_CHECK_EQUAL(B50::toString(parse<B50>("1e-30")), "1e-30");
+    BOOST_CHECK_EQUAL(B50::toString(parse<B50>("-12345678901234567890123456789")), "-12345678901234567890123456789");
+    BOOST_CHECK_EQUAL(B50::toString(parse<B50>("1e60")), "1e+60");
+    BOOST_CHECK_EQUAL(B50::toString(parse<B50>("0.000123")), "0.000123");
+
+    char buffer[B50::buffer_size];
+    BOOST_CHECK_EQUAL(std::string(buffer, B50::format(buffer, buffer+sizeof(buffer), B50::Pi(), 5)), "3.1416");
+    BOOST_CHECK_EQUAL(std::string(buffer, B50::format(buffer, buffer+sizeof(buffer), parse<B50>("9.99996"), 5)), "10");
+    BOOST_CHECK(B50::format(buffer, buffer+3, B50::Pi(), 5) == buffer);
+}
+
+BOOST_AUTO_TEST_CASE( interpreter )
+{
+    Interpreter<std::complex<B50>> p;
+    BOOST_CHECK_EQUAL(toString(p.Eval("pi")), "3.1415926535897932384626433832795028841971693993751\n");
+    BOOST_CHECK_EQUAL(toString(p.Eval("1/3")), "0.33333333333333333333333333333333333333333333333333\n");
+    BOOST_CHECK_EQUAL(toString(p.Eval("exp(i*pi)")), "-1\n");
+    BOOST_CHECK_EQUAL(toString(p.Eval("sqrt(-4)")), "i*2\n");
+    BOOST_CHECK_EQUAL(toString(p.Eval("2^100")), "1267650600228229401496703205376\n");
+    BOOST_CHECK_EQUAL(toString(p.Eval("inv([1 2;3 4])")), "-2 1\n1.5 -0.5\n");
+    p.Eval("s_0=1");
+    p.Eval("s_n=s_(n-1)+1/!n");
+    BOOST_CHECK_EQUAL(toString(p.Eval("s_45")), toString(p.Eval("e")));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,121 @@
+#include "interpreter.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <complex>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+typedef std::complex<double> complex;
+
+static const char* export_definitions[] = {
+    "exp(x)_n=exp(x)_(n-1)+x^n/!n",
+    "fib_0=0",
+    "fib_1=1",
+    "fib_n=fib_(n-1)+fib_(n-2)",
+    "f(x,y=2)=x*y+1",
+    "s_0=0",
+    "s_n=s_(n-1)+1/2^n",
+    "am(x,y)_0=(x+y)/2",
+    "gm(x,y)_0=(x*y)^0.5",
+    "am(x,y)_n=(am(x,y)_(n-1)+gm(x,y)_(n-1))/2",
+    "gm(x,y)_n=(am(x,y)_(n-1)*gm(x,y)_(n-1))^0.5",
+    "h(x)=f(x)+sin(x)/fib_10-pi",
+    "g(x)=x*[1 2;3 4]",
+    "k(x)=g(x)+1",
+    "do=3"
+};
+
+static std::string exported(const std::string& space)
+{
+    Interpreter<complex> p;
+    for(const char* definition : export_definitions) {
+        p.Eval(definition);
+    }
+    const char* path = "cpp_export_test.hpp";
+    BOOST_REQUIRE(p.ExportCpp(path, space));
+    std::ifstream file(path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+BOOST_AUTO_TEST_SUITE(cpp_export_tests)
+
+BOOST_AUTO_TEST_CASE( header )
+{
+    std::string text = exported("inka");
+    BOOST_CHECK(text.find("namespace inka {") != std::string::npos);
+    BOOST_CHECK(text.find("template <typename S> S fib_at(int n_);") != std::string::npos);
+    BOOST_CHECK(text.find("template <typename S> S exp(S x);") != std::string::npos);
+    BOOST_CHECK(text.find("template <typename S> S f(S x, S y);") != std::string::npos);
+    BOOST_CHECK(text.find("template <typename S> S f(S x);") != std::string::npos);
+    BOOST_CHECK(text.find("template <typename S> S do_();") != std::string::npos);
+    // divisions as the interpreter computes them
+    BOOST_CHECK(text.find("if(k_ == 0) return ((x + y) / S(2));") != std::string::npos);
+    BOOST_CHECK(text.find("(numeric_interface<S>::sin(x) / fib_at<S>(numeric_interface<S>::toInt(S(10))))") != std::string::npos);
+    BOOST_CHECK(text.find("S x_ = (S(1) / numeric_interface<S>::pow(S(2), S(k_)));") != std::string::npos);
+    // the matrices and what uses them are skipped
+    BOOST_CHECK(text.find("//   g : matrix\n") != std::string::npos);
+    BOOST_CHECK(text.find("//   k : call of g\n") != std::string::npos);
+    BOOST_CHECK(text.find(" g(") == std::string::npos);
+    std::remove("cpp_export_test.hpp");
+}
+
+#if defined(INKAMATH_JIT) && defined(INKAMATH_JIT_INCLUDE_DIR)
+// compiled with the system compiler, as the native functions of jit.hpp
+BOOST_AUTO_TEST_CASE( same_results )
+{
+    exported("inka");
+    const char* calls[][2] = {
+        {"exp(1)", "inka::exp<S>(S(1))"},
+        {"exp(i*pi)", "inka::exp<S>(S(0,1)*inka::pi<S>())"},
+        {"exp(2)_5", "inka::exp_at<S>(5, S(2))"},
+        {"fib_30", "inka::fib_at<S>(30)"},
+        {"fib_(-1)", "inka::fib_at<S>(-1)"},
+        {"f(3)", "inka::f<S>(S(3))"},
+        {"f(3,5)", "inka::f<S>(S(3), S(5))"},
+        {"s_50", "inka::s_at<S>(50)"},
+        {"s", "inka::s<S>()"},
+        {"gm(1,2)_10", "inka::gm_at<S>(10, S(1), S(2))"},
+        {"am(1,2)", "inka::am<S>(S(1), S(2))"},
+        {"h(0.5)", "inka::h<S>(S(0.5))"}
+    };
+
+    std::string program = "#include \"cpp_export_test.hpp\"\n#include <cstdio>\n"
+                          "typedef std::complex<double> S;\n"
+                          "int main()\n{\n";
+    for(const auto& call : calls) {
+        program += "    {S a = " + std::string(call[1]) + "; std::printf(\"%.17g %.17g\\n\", a.real(), a.imag());}\n";
+    }
+    program += "    return 0;\n}\n";
+    {
+        std::ofstream file("cpp_export_test.cpp");
+        file << program;
+    }
+    // -O0 : an optimizer may fold pow(x, 2) into x*x, one bit away
+    const std::string command = std::string("c++ -std=c++11 -O0 -I\"") + INKAMATH_JIT_INCLUDE_DIR + "\" -I. "
+            "-o cpp_export_test cpp_export_test.cpp && ./cpp_export_test > cpp_export_test.txt";
+    BOOST_REQUIRE_EQUAL(std::system(command.c_str()), 0);
+
+    Interpreter<complex> p;
+    for(const char* definition : export_definitions) {
+        p.Eval(definition);
+    }
+    std::ifstream results("cpp_export_test.txt");
+    for(const auto& call : calls) {
+        double re = 0, im = 0;
+        results >> re >> im;
+        BOOST_CHECK_EQUAL(Matrix<complex>::toString(Matrix<complex>(complex(re, im)), 17),
+                          Matrix<complex>::toString(p.Eval(call[0]), 17));
+    }
+    const char* files[] = {"cpp_export_test.hpp", "cpp_export_test.cpp", "cpp_export_test", "cpp_export_test.txt"};
+    for(const char* file : files) {
+        std::remove(file);
+    }
+}
+#endif // INKAMATH_JIT
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,4 +1,6 @@
 #include "dynarraylike.hpp"
+#include "pool_allocator.hpp"
+#include "alloc_tracker.hpp"
 #include <iostream>
 #include <limits>
 #include <set>
@@ -119,4 +121,50 @@ BOOST_AUTO_TEST_CASE( dynarray_3 )
     BOOST_CHECK_EQUAL(TestType::desctructor_count, 10);
 }
 
+typedef dynarray<int, PoolAllocator<int>, 2> small_dynarray;
+
+BOOST_AUTO_TEST_CASE( dynarray_inline )
+{
+    size_t count = AllocationTracker::Counters().count[AllocDynarray];
+    small_dynarray s{1, 2};
+    small_dynarray t(1);
+    BOOST_CHECK(s.is_inline());
+    BOOST_CHECK(t.is_inline());
+    BOOST_CHECK_EQUAL(AllocationTracker::Counters().count[AllocDynarray], count);
+
+    small_dynarray l{1, 2, 3, 4};
+    BOOST_CHECK(!l.is_inline());
+    BOOST_CHECK_EQUAL(AllocationTracker::Counters().count[AllocDynarray], count+1);
+
+    // inline and pooled arrays exchange their elements
+    s.swap(l);
+    BOOST_CHECK_EQUAL(s.size(), 4);
+    BOOST_CHECK_EQUAL(l.size(), 2);
+    BOOST_CHECK(l.is_inline());
+    BOOST_CHECK_EQUAL(s[3], 4);
+    BOOST_CHECK_EQUAL(l[1], 2);
+
+    small_dynarray m(std::move(l));
+    BOOST_CHECK(l.empty());
+    BOOST_CHECK(m.is_inline());
+    BOOST_CHECK_EQUAL(m[0], 1);
+    m = s;
+    BOOST_CHECK(m == s);
+    m = small_dynarray(2, 7);
+    BOOST_CHECK_EQUAL(m[0], 7);
+    BOOST_CHECK_EQUAL(m[1], 7);
+}
+
+BOOST_AUTO_TEST_CASE( dynarray_inline_destruction )
+{
+    TestType::desctructor_count = 0;
+    {
+        dynarray<TestType, std::allocator<TestType>, 2> x(2);
+        dynarray<TestType, std::allocator<TestType>, 2> y(std::move(x));
+        // the moved from elements are destroyed by the move
+        BOOST_CHECK_EQUAL(TestType::desctructor_count, 2);
+    }
+    BOOST_CHECK_EQUAL(TestType::desctructor_count, 4);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
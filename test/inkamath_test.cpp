@@ -31,5 +31,174 @@ BOOST_AUTO_TEST_CASE( inkamath_2 ) {
                   record);
 }
 
+BOOST_AUTO_TEST_CASE( inkamath_3 ) {
+    // Pass "record" (false) instead of "match" (true)
+    // as 3rd paramter to generate output file instead of matching
+    inkamath_test("../inkamath/test/data/input3.txt",
+                  "../inkamath/test/data/output3.txt",
+                  match);
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_4 ) {
+    // Pass "record" (false) instead of "match" (true)
+    // as 3rd paramter to generate output file instead of matching
+    inkamath_test("../inkamath/test/data/input4.txt",
+                  "../inkamath/test/data/output4.txt",
+                  match);
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_5 ) {
+    // Pass "record" (false) instead of "match" (true)
+    // as 3rd paramter to generate output file instead of matching
+    // s_100000 needs more than the default second in unoptimized builds
+    inkamath_test("../inkamath/test/data/input5.txt",
+                  "../inkamath/test/data/output5.txt",
+                  match, std::chrono::seconds(30));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_budget ) {
+    EvaluationLimits limits;
+    limits.max_depth = 1000;
+    interpreter.SetLimits(limits);
+    interpreter.Eval("g(x)=h(x)");
+    interpreter.Eval("h(x)=g(x)");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("g(1)")), toString(Matrix<std::complex<double>>()));
+    // the interpreter is still usable
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("1+1")), toString(Matrix<std::complex<double>>(2.0)));
+
+    limits.max_depth = 0;
+    limits.max_nodes = 1000;
+    interpreter.SetLimits(limits);
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("u_0=1")), toString(Matrix<std::complex<double>>(1.0)));
+    interpreter.Eval("v_0=1");
+    interpreter.Eval("u_n=v_(n-1)+v_(n-1)");
+    interpreter.Eval("v_n=u_(n-1)+u_(n-1)");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("u_4")), toString(Matrix<std::complex<double>>(16.0)));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("u_400")), toString(Matrix<std::complex<double>>()));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_mutual_sequences ) {
+    // the terms of both sequences are memoized : the evaluation is linear
+    // in the index instead of exponential
+    interpreter.Eval("am(x,y)_0=(x+y)/2");
+    interpreter.Eval("gm(x,y)_0=(x*y)^0.5");
+    interpreter.Eval("am(x,y)_n=(am(x,y)_(n-1)+gm(x,y)_(n-1))/2");
+    interpreter.Eval("gm(x,y)_n=(am(x,y)_(n-1)*gm(x,y)_(n-1))^0.5");
+    EvaluationLimits limits;
+    limits.max_nodes = 2000;
+    interpreter.SetLimits(limits);
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("gm(1,2)_30")), toString(Matrix<std::complex<double>>(1.4567910310469068)));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("am(1,2)_30")), toString(Matrix<std::complex<double>>(1.4567910310469068)));
+    // the memos of the previous calls are kept by values of the parameters
+    limits.max_nodes = 10;
+    interpreter.SetLimits(limits);
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("gm(1,2)_30")), toString(Matrix<std::complex<double>>(1.4567910310469068)));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("gm(1,3)_30")), toString(Matrix<std::complex<double>>()));
+    // and forgotten when a definition changes
+    limits.max_nodes = 2000;
+    interpreter.SetLimits(limits);
+    interpreter.Eval("gm(x,y)_0=x");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("gm(1,2)_1")), toString(interpreter.Eval("(1.5*1)^0.5")));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_sequence_free_name ) {
+    // a reads the parameter of the caller : the memo of the terms is kept
+    // by its value as well
+    interpreter.Eval("s_0=0");
+    interpreter.Eval("s_n=s_(n-1)+a");
+    interpreter.Eval("g(a)=s_3");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("g(1)")), toString(Matrix<std::complex<double>>(3.0)));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("g(2)")), toString(Matrix<std::complex<double>>(6.0)));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_sequence_free_name_first_term ) {
+    interpreter.Eval("w_0=a");
+    interpreter.Eval("w_n=w_(n-1)+1");
+    interpreter.Eval("h(a)=w_3");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("h(1)")), toString(Matrix<std::complex<double>>(4.0)));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("h(5)")), toString(Matrix<std::complex<double>>(8.0)));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_cancel ) {
+    interpreter.Eval("u_0=1");
+    interpreter.Eval("v_0=1");
+    interpreter.Eval("u_n=v_(n-1)+v_(n-1)");
+    interpreter.Eval("v_n=u_(n-1)+u_(n-1)");
+    auto asynceval = std::async(std::launch::async, [&]() {
+        return interpreter.Eval("u_1000000");
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    interpreter.Cancel();
+    BOOST_REQUIRE(asynceval.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+    BOOST_CHECK_EQUAL(toString(asynceval.get()), toString(Matrix<std::complex<double>>()));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("u_4")), toString(Matrix<std::complex<double>>(16.0)));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_summation ) {
+    // the serial sum gives 1000.0000000001588
+    interpreter.Eval("t_n=t_(n-1)+0.1");
+    BOOST_CHECK_EQUAL(Matrix<std::complex<double>>::toString(interpreter.Eval("t_9999"), 17),
+                      Matrix<std::complex<double>>::toString(Matrix<std::complex<double>>(1000.0), 17));
+    interpreter.Eval("t_0=5");
+    BOOST_CHECK_EQUAL(Matrix<std::complex<double>>::toString(interpreter.Eval("t_3"), 17),
+                      Matrix<std::complex<double>>::toString(Matrix<std::complex<double>>(5.3), 17));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_parallel_cells ) {
+    // the cells are expensive enough to be evaluated on the thread pool
+    interpreter.Eval("w_0=0");
+    interpreter.Eval("w_n=w_(n-1)+1/n^2");
+    interpreter.Eval("f(x)=w_x*x");
+    Matrix<std::complex<double>> m = interpreter.Eval("[f(2000) f(4000);f(6000) w_8000]");
+    BOOST_REQUIRE(m.Size() == std::make_pair(size_t(2), size_t(2)));
+    BOOST_CHECK_EQUAL(toString(Matrix<std::complex<double>>(m(1,2))), toString(interpreter.Eval("f(4000)")));
+    BOOST_CHECK_EQUAL(toString(Matrix<std::complex<double>>(m(2,1))), toString(interpreter.Eval("f(6000)")));
+    BOOST_CHECK_EQUAL(toString(Matrix<std::complex<double>>(m(2,2))), toString(interpreter.Eval("w_8000")));
+
+    // the nodes of every cell count in the budget, the cells do not share
+    // their terms since the parameters differ
+    interpreter.Eval("z(a)_0=0");
+    interpreter.Eval("z(a)_n=z(a)_(n-1)+a/n^2");
+    EvaluationLimits limits;
+    limits.max_nodes = 80000;
+    interpreter.SetLimits(limits);
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("w_8000")), toString(interpreter.Eval("[z(1)_8000]")));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("[z(2)_8000 z(3)_8000 z(4)_8000]")), toString(Matrix<std::complex<double>>()));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_map ) {
+    interpreter.Eval("f(x)=x^2+!x");
+    interpreter.Eval("A=[1 2;3 4]");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("map(f,A)")), toString(interpreter.Eval("[f(1) f(2);f(3) f(4)]")));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("map(cos,[0 pi])")), toString(interpreter.Eval("[cos(0) cos(pi)]")));
+    interpreter.Eval("g(x,y=10)=x+y");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("map(g,A)")), toString(interpreter.Eval("[11 12;13 14]")));
+    interpreter.Eval("h(x)=[x x]");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("map(h,A)")), toString(Matrix<std::complex<double>>()));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("map(1,A)")), toString(Matrix<std::complex<double>>()));
+
+    // expensive enough to be mapped on the thread pool
+    interpreter.Eval("w_0=0");
+    interpreter.Eval("w_n=w_(n-1)+1/n^2");
+    interpreter.Eval("s(x)=w_x");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("map(s,[1000 1001 1002;1003 1004 1005])")),
+                      toString(interpreter.Eval("[s(1000) s(1001) s(1002);s(1003) s(1004) s(1005)]")));
+}
+
+BOOST_AUTO_TEST_CASE( inkamath_sparse ) {
+    // block matrices of 32x32 with 32 nonzeros are stored sparse
+    interpreter.Eval("I_0=1");
+    interpreter.Eval("I_n=[I_(n-1) 0;0 I_(n-1)]");
+    interpreter.Eval("A=I_5");
+    BOOST_CHECK(interpreter.Eval("A").IsSparse());
+    BOOST_CHECK(!interpreter.Eval("I_4").IsSparse());
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("nnz(A)")), "32\n");
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("A")), toString(interpreter.Eval("full(A)")));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("A*(A+A)")), toString(interpreter.Eval("2*full(A)")));
+    BOOST_CHECK_EQUAL(toString(interpreter.Eval("[A 0;0 A]")), toString(interpreter.Eval("I_6")));
+    BOOST_CHECK(interpreter.Eval("sin(A)").IsSparse());
+    BOOST_CHECK(!interpreter.Eval("cos(A)").IsSparse());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
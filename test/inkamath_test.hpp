@@ -39,7 +39,8 @@ struct InkamathFixture {
 
     void inkamath_test(const std::string& infilepath,
                        const std::string& outfilepath,
-                       bool matching) {
+                       bool matching,
+                       std::chrono::seconds timeout = std::chrono::seconds(1)) {
         std::ifstream input{infilepath};
         std::ifstream output{outfilepath};
         BOOST_CHECK_MESSAGE(input, "Failed to open test data.");
@@ -52,16 +53,20 @@ struct InkamathFixture {
                 auto asynceval = std::async(std::launch::async, [&]() {
                     test_stream << interpreter.Eval(line);
                 });
-                if(asynceval.wait_for(std::chrono::seconds(1))
+                if(asynceval.wait_for(timeout)
                     != std::future_status::ready) {
                     BOOST_CHECK_MESSAGE(false,
                     "in file : " << infilepath << "(" << std::to_string(line_number) << ")\n" <<
                     "The interpreter timed out for :\n" << line);
-                    // We can't terminate this non-cooperative thread
-                    // and pass to the next test.
-                    // Terminate the process instead of waiting death (stack overflow or whatever..)
-                    std::terminate();
-                    // Todo : find a way to stop a cooperative interpreter thread.
+                    // Stop the evaluation and pass to the next line
+                    interpreter.Cancel();
+                    if(asynceval.wait_for(std::chrono::seconds(1))
+                        != std::future_status::ready) {
+                        // Stuck outside of the evaluator loop (in a huge matrix product or whatever..)
+                        std::terminate();
+                    }
+                    ++line_number;
+                    continue;
                 }
                 std::string out;
                 auto eval_size = test_stream.tellp()-before;
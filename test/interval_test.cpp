@@ -0,0 +1,117 @@
+#include "interval.hpp"
+#include "interpreter.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <complex>
+#include <string>
+
+typedef std::complex<Interval> complex_interval;
+
+BOOST_AUTO_TEST_SUITE(interval_tests)
+
+BOOST_AUTO_TEST_CASE( outward_rounding )
+{
+    // exact operations give point intervals
+    BOOST_CHECK((Interval(3) + Interval(4)) == Interval(7));
+    BOOST_CHECK((Interval(6) * Interval(7)) == Interval(42));
+    BOOST_CHECK((Interval(1) / Interval(4)) == Interval(0.25));
+    BOOST_CHECK(Interval::sqrt(Interval(9)) == Interval(3));
+
+    // inexact ones enclose the exact result between adjacent doubles
+    const Interval third = Interval(1) / Interval(3);
+    BOOST_CHECK(third.Lower() < third.Upper());
+    BOOST_CHECK_EQUAL(std::nextafter(third.Lower(), 1.0), third.Upper());
+    BOOST_CHECK((third * Interval(3)).Contains(1));
+    const Interval sum = Interval(0.1) + Interval(0.2);
+    BOOST_CHECK_EQUAL(std::nextafter(sum.Lower(), 1.0), sum.Upper());
+    BOOST_CHECK(Interval::sqrt(Interval(2)).Upper()*Interval::sqrt(Interval(2)).Upper() >= 2);
+    BOOST_CHECK(Interval::sqrt(Interval(2)).Lower()*Interval::sqrt(Interval(2)).Lower() <= 2);
+
+    // 1e308*10 overflows : the lower bound stays finite
+    const Interval large = Interval(1e308) * Interval(10);
+    BOOST_CHECK_EQUAL(large.Lower(), DBL_MAX);
+    BOOST_CHECK(std::isinf(large.Upper()));
+
+    const Interval a(-1, 2), b(3, 5);
+    BOOST_CHECK((a * b) == Interval(-5, 10));
+    BOOST_CHECK((a - b) == Interval(-6, -1));
+    BOOST_CHECK((Interval(1) / a).Contains(1e300));
+    BOOST_CHECK(Interval::abs(a) == Interval(0, 2));
+    BOOST_CHECK(Interval::pow(a, Interval(2)) == Interval(0, 4));
+    BOOST_CHECK((Interval(1) / Interval(0)).Lower() == HUGE_VAL);
+    BOOST_CHECK((Interval(0) / Interval(0)).IsNaN());
+}
+
+BOOST_AUTO_TEST_CASE( functions )
+{
+    const double pi = 3.14159265358979323846;
+    BOOST_CHECK(Interval::Pi().Contains(pi));
+    BOOST_CHECK((Interval(4) * Interval::atan(Interval(1))).Contains(pi));
+    BOOST_CHECK(Interval::exp(Interval(0)) == Interval(1));
+    BOOST_CHECK(Interval::exp(Interval(1)).Contains(2.718281828459045));
+
+    // extrema inside the interval
+    BOOST_CHECK_EQUAL(Interval::sin(Interval(1, 2)).Upper(), 1);
+    BOOST_CHECK_EQUAL(Interval::cos(Interval(3, 4)).Lower(), -1);
+    BOOST_CHECK_EQUAL(Interval::cosh(Interval(-1, 2)).Lower(), 1);
+    BOOST_CHECK(Interval::sin(Interval(0.1, 0.2)).Upper() < 0.2);
+    BOOST_CHECK(std::isinf(Interval::tan(Interval(1, 2)).Upper()));
+    BOOST_CHECK(Interval::tan(Interval(0.1, 0.2)).Upper() < 0.21);
+    BOOST_CHECK(Interval::sin(Interval(-10, 10)) == Interval(-1, 1));
+
+    // gamma(1.5) = sqrt(pi)/2, minimum near 1.4616
+    BOOST_CHECK(Interval::gamma(Interval(1.5)).Contains(0.886226925452758));
+    BOOST_CHECK(Interval::gamma(Interval(1, 2)).Contains(0.8856031944108887));
+    BOOST_CHECK(Interval::gamma(Interval(1, 2)).Contains(1));
+    BOOST_CHECK(Interval::fact(Interval(20)) == Interval(2432902008176640000.0));
+    BOOST_CHECK(Interval::fact(Interval(30)).Contains(2.6525285981219107e32));
+}
+
+BOOST_AUTO_TEST_CASE( parse_format )
+{
+    char* end;
+    Interval a;
+    const char* s = "12+x";
+    BOOST_CHECK(Interval::parse(a, s, end));
+    BOOST_CHECK_EQUAL(end, s+2);
+    BOOST_CHECK(a == Interval(12));
+    s = "0.1";
+    BOOST_CHECK(Interval::parse(a, s, end));
+    BOOST_CHECK(a.Lower() < 0.1 && 0.1 < a.Upper());
+    s = "0.0";
+    BOOST_CHECK(Interval::parse(a, s, end));
+    BOOST_CHECK(a == Interval(0));
+    s = "x";
+    BOOST_CHECK(!Interval::parse(a, s, end));
+    BOOST_CHECK_EQUAL(end, s);
+
+    BOOST_CHECK_EQUAL(Interval::toString(Interval(1) / Interval(3)), "0.333333333");
+    BOOST_CHECK_EQUAL(Interval::toString(Interval(1, 2)), "[1,2]");
+    BOOST_CHECK_EQUAL(Interval::toString(Interval(-HUGE_VAL, HUGE_VAL)), "[-inf,inf]");
+    BOOST_CHECK_EQUAL(numeric_interface<complex_interval>::toString(complex_interval(1, Interval(-1e-16, 2e-16))),
+                      "1+i*[-1e-16,2e-16]");
+}
+
+BOOST_AUTO_TEST_CASE( interpreter )
+{
+    Interpreter<complex_interval> p;
+    BOOST_CHECK_EQUAL(toString(p.Eval("pi")), "3.14159265\n");
+    BOOST_CHECK_EQUAL(toString(p.Eval("inv([1 2;3 4])")), "-2 1\n1.5 -0.5\n");
+    BOOST_CHECK_EQUAL(toString(p.Eval("1/(2+i)")), "0.4-i*0.2\n");
+
+    // the terms of a series enclose the exact partial sums
+    p.Eval("s_0=1");
+    p.Eval("s_n=s_(n-1)+1/!n");
+    const Interval e = p.Eval("s_30")(1,1).real();
+    BOOST_CHECK(e.Contains(2.718281828459045));
+    BOOST_CHECK(e.Width() < 1e-13);
+    p.Eval("w_0=0");
+    p.Eval("w_n=w_(n-1)+1/2^n");
+    const Interval w = p.Eval("w_2000")(1,1).real();
+    BOOST_CHECK(w.Lower() < 1 && w.Upper() > 0.9999999999999);
+    BOOST_CHECK(w.Width() < 1e-12);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
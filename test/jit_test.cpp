@@ -0,0 +1,87 @@
+#ifdef INKAMATH_JIT
+
+#include "interpreter.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <complex>
+#include <sstream>
+#include <string>
+
+typedef std::complex<double> complex;
+
+std::string jit_eval(Interpreter<complex>& p, const std::string& s)
+{
+    return Matrix<complex>::toString(p.Eval(s), 17);
+}
+
+BOOST_AUTO_TEST_SUITE(jit_tests)
+
+// compiled functions compute the same bits as the interpreter
+BOOST_AUTO_TEST_CASE( same_results )
+{
+    const char* definitions[] = {
+        "c(x)=(exp(i*x)+exp(-i*x))/2",
+        "h(x,y)=(x+2*y)^2/(1+x*y)-x\\y+!4*sqrt(abs(x))",
+        "k(x)=-x*[x]^3/7.25e-1+ln(x)*gamma(x)"
+    };
+    const char* calls[] = {"c(0.3)", "c(i+2)", "h(1.5,-2)", "h(i,3)", "k(2.5)", "k(1-i)"};
+
+    Interpreter<complex> interpreted;
+    interpreted.SetJitThreshold(0);
+    Interpreter<complex> compiled;
+    compiled.SetJitThreshold(1);
+    for(const char* definition : definitions) {
+        interpreted.Eval(definition);
+        compiled.Eval(definition);
+    }
+    for(const char* call : calls) {
+        BOOST_CHECK_EQUAL(jit_eval(compiled, call), jit_eval(interpreted, call));
+    }
+    BOOST_CHECK_EQUAL(compiled.JitCompiledCount(), 3u);
+    BOOST_CHECK_EQUAL(interpreted.JitCompiledCount(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE( threshold_and_fallbacks )
+{
+    Interpreter<complex> p;
+    p.SetJitThreshold(3);
+    p.Eval("f(x,y)=x*y"); // the definition evaluates f(x,y) once
+    p.Eval("f(1,2)");
+    BOOST_CHECK_EQUAL(p.JitCompiledCount(), 0u);
+    BOOST_CHECK_EQUAL(jit_eval(p, "f(2,3)"), jit_eval(p, "6"));
+    BOOST_CHECK_EQUAL(p.JitCompiledCount(), 1u);
+
+    // matrix arguments are interpreted
+    BOOST_CHECK_EQUAL(jit_eval(p, "f([1 2],2)"), jit_eval(p, "[2 4]"));
+    // the second argument sees the first parameter
+    p.Eval("x=10");
+    BOOST_CHECK_EQUAL(jit_eval(p, "f(2,x)"), jit_eval(p, "4"));
+
+    // redefinition
+    p.Eval("f(x,y)=x-y");
+    BOOST_CHECK_EQUAL(jit_eval(p, "f(2,3)"), jit_eval(p, "-1"));
+
+    // references to other definitions are not compiled
+    p.Eval("a=2");
+    p.Eval("g(x)=a*x");
+    for(int k = 0; k < 5; ++k) p.Eval("g(1)");
+    BOOST_CHECK_EQUAL(p.JitCompiledCount(), 1u);
+    p.Eval("a=3");
+    BOOST_CHECK_EQUAL(jit_eval(p, "g(1)"), jit_eval(p, "3"));
+}
+
+BOOST_AUTO_TEST_CASE( shadowed_native )
+{
+    Interpreter<complex> p;
+    p.SetJitThreshold(1);
+    p.Eval("s(x)=sin(x)+1");
+    BOOST_CHECK_EQUAL(jit_eval(p, "s(0)"), jit_eval(p, "1"));
+    BOOST_CHECK_EQUAL(p.JitCompiledCount(), 1u);
+    p.Eval("sin(x)=x*100");
+    BOOST_CHECK_EQUAL(jit_eval(p, "s(2)"), jit_eval(p, "201"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif // INKAMATH_JIT
@@ -0,0 +1,140 @@
+#include "matrix_io.hpp"
+#include "interpreter.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <complex>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+typedef std::complex<double> complex;
+
+BOOST_AUTO_TEST_SUITE(matrix_io_tests)
+
+BOOST_AUTO_TEST_CASE( binary_round_trip )
+{
+    const char* path = "matrix_io_test.bin";
+    Matrix<double> a(3, 4);
+    for(size_t i = 1; i <= 3; ++i) {
+        for(size_t j = 1; j <= 4; ++j) {
+            a(i, j) = i*10.0 + j/8.0;
+        }
+    }
+    save_matrix_binary(path, a);
+
+    Matrix<double> b = load_matrix_binary<double>(path);
+    BOOST_CHECK_EQUAL(b.Size().first, 3u);
+    BOOST_CHECK_EQUAL(b.Size().second, 4u);
+    BOOST_CHECK_EQUAL(Matrix<double>::toString(b), Matrix<double>::toString(a));
+
+    // the mapping is private : the file is unchanged
+    b(1, 1) = -1;
+    Matrix<double> c = load_matrix_binary<double>(path);
+    BOOST_CHECK_EQUAL(c(1, 1), 10.125);
+
+    // real data in a complex matrix
+    Matrix<complex> z = load_matrix_binary<complex>(path);
+    BOOST_CHECK_EQUAL(z(3, 4), complex(30.5, 0));
+
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE( binary_complex )
+{
+    const char* path = "matrix_io_test.bin";
+    Matrix<complex> a(2, 2);
+    a(1, 1) = complex(1, -1);
+    a(2, 2) = complex(0.5, 2);
+    save_matrix_binary(path, a);
+
+    Matrix<complex> b = load_matrix_binary<complex>(path);
+    BOOST_CHECK_EQUAL(Matrix<complex>::toString(b), Matrix<complex>::toString(a));
+    BOOST_CHECK_THROW(load_matrix_binary<double>(path), std::runtime_error);
+
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE( binary_invalid )
+{
+    const char* path = "matrix_io_test.bin";
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "not a matrix file at all, not at all";
+    }
+    BOOST_CHECK_THROW(load_matrix_binary<double>(path), std::runtime_error);
+
+    // truncated data
+    save_matrix_binary(path, Matrix<double>(4, 4, 1.0));
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        std::ofstream out(path, std::ios::binary);
+        out.write(bytes.data(), bytes.size()-8);
+    }
+    BOOST_CHECK_THROW(load_matrix_binary<double>(path), std::runtime_error);
+
+    std::remove(path);
+    BOOST_CHECK_THROW(load_matrix_binary<double>(path), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( csv )
+{
+    const char* path = "matrix_io_test.csv";
+    {
+        std::ofstream file(path);
+        file << "1,2.5,-3\r\n\n4; 5e-1\t6\n";
+    }
+    Matrix<double> a = load_matrix<double>(path);
+    BOOST_CHECK_EQUAL(a.Size().first, 2u);
+    BOOST_CHECK_EQUAL(a.Size().second, 3u);
+    BOOST_CHECK_EQUAL(a(1, 2), 2.5);
+    BOOST_CHECK_EQUAL(a(1, 3), -3);
+    BOOST_CHECK_EQUAL(a(2, 2), 0.5);
+
+    {
+        std::ofstream file(path);
+        file << "1,2\n3\n";
+    }
+    BOOST_CHECK_THROW(load_matrix<double>(path), std::runtime_error);
+    {
+        std::ofstream file(path);
+        file << "1,two\n";
+    }
+    BOOST_CHECK_THROW(load_matrix<double>(path), std::runtime_error);
+
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE( interpreter_load )
+{
+    const char* path = "matrix_io_test.csv";
+    {
+        std::ofstream file(path);
+        file << "1 2\n3 4\n";
+    }
+    Interpreter<complex> p;
+    std::ostringstream errors;
+    p.SetErrorStream(errors);
+    BOOST_CHECK(p.Load("A", path));
+    Matrix<complex> expected(2, 2);
+    expected(1, 1) = 7; expected(1, 2) = 10;
+    expected(2, 1) = 15; expected(2, 2) = 22;
+    BOOST_CHECK_EQUAL(Matrix<complex>::toString(p.Eval("A*A")), Matrix<complex>::toString(expected));
+    BOOST_CHECK(!p.Load("B", "missing.csv"));
+    BOOST_CHECK(!errors.str().empty());
+
+    // names that the lexer cannot read are refused before the file is read
+    BOOST_CHECK(Interpreter<complex>::IsReferenceName("A2"));
+    BOOST_CHECK(!Interpreter<complex>::IsReferenceName("2A"));
+    BOOST_CHECK(!Interpreter<complex>::IsReferenceName("A_1"));
+    BOOST_CHECK(!Interpreter<complex>::IsReferenceName(""));
+    BOOST_CHECK(!p.Load("x+y", path));
+    BOOST_CHECK_EQUAL(Matrix<complex>::toString(p.Eval("x")), Matrix<complex>::toString(Matrix<complex>()));
+
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
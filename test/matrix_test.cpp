@@ -0,0 +1,129 @@
+#include "matrix.hpp"
+#include <iostream>
+#include <complex>
+#include <numeric>
+
+#include <boost/test/unit_test.hpp>
+
+struct MatrixFixture {
+    Matrix<double> a{2, 2, 1.0};
+};
+
+BOOST_FIXTURE_TEST_SUITE(matrix_tests, MatrixFixture)
+
+BOOST_AUTO_TEST_CASE( copy_on_write_1 )
+{
+    Matrix<double> b(a);
+    const Matrix<double>& ca = a;
+    const Matrix<double>& cb = b;
+    BOOST_CHECK(a.IsShared());
+    BOOST_CHECK(b.IsShared());
+    BOOST_CHECK_EQUAL(ca.data(), cb.data());
+
+    b(1,1) = 2.0;
+    BOOST_CHECK(!a.IsShared());
+    BOOST_CHECK(!b.IsShared());
+    BOOST_CHECK(ca.data() != cb.data());
+    BOOST_CHECK_EQUAL(a(1,1), 1.0);
+    BOOST_CHECK_EQUAL(b(1,1), 2.0);
+    BOOST_CHECK_EQUAL(b(2,2), 1.0);
+}
+
+BOOST_AUTO_TEST_CASE( copy_on_write_2 )
+{
+    Matrix<double> b;
+    b = a;
+    const Matrix<double>& cb = b;
+    BOOST_CHECK_EQUAL(cb(1,2), 1.0);
+    BOOST_CHECK(b.IsShared());
+
+    Matrix<double> c = a + b;
+    BOOST_CHECK(!c.IsShared());
+    BOOST_CHECK_EQUAL(c(2,1), 2.0);
+
+    Matrix<double> d = 3.0 * a;
+    BOOST_CHECK_EQUAL(d(1,1), 3.0);
+    BOOST_CHECK_EQUAL(a(1,1), 1.0);
+    BOOST_CHECK_EQUAL(b(1,1), 1.0);
+}
+
+BOOST_AUTO_TEST_CASE( elementwise_blocks )
+{
+    // blocks of the thread pool give the results of a single loop
+    typedef std::complex<double> C;
+    Matrix<C> x(300, 300), y(300, 300);
+    for (size_t i = 1; i <= 300; ++i)
+    {
+        for (size_t j = 1; j <= 300; ++j)
+        {
+            x(i,j) = C(i*0.1, j*0.3);
+            y(i,j) = C(1.0/j, i-3.0*j);
+        }
+    }
+    Elementwise::SetThreshold(size_t(-1));
+    Matrix<C> sum = x + y, difference = x - y, opposite = -x, scaled = x*C(0.5, 2.0), scaled_left = C(0.5, 2.0)*y;
+    Elementwise::SetThreshold(0);
+    Elementwise::SetThreads(2);
+    BOOST_CHECK(std::equal(sum.data(), sum.data()+300*300, (x + y).data()));
+    BOOST_CHECK(std::equal(difference.data(), difference.data()+300*300, (x - y).data()));
+    BOOST_CHECK(std::equal(opposite.data(), opposite.data()+300*300, (-x).data()));
+    Elementwise::SetThreads(0);
+    BOOST_CHECK(std::equal(scaled.data(), scaled.data()+300*300, (x*C(0.5, 2.0)).data()));
+    BOOST_CHECK(std::equal(scaled_left.data(), scaled_left.data()+300*300, (C(0.5, 2.0)*y).data()));
+    Elementwise::SetThreshold(Elementwise::default_threshold);
+}
+
+BOOST_AUTO_TEST_CASE( sparse_storage )
+{
+    // block matrix [x 0; 0 y] and its dense copy give the same results
+    Matrix<double> dense(64, 64, 0.0), other(64, 64, 0.0);
+    for (size_t i = 1; i <= 32; ++i)
+    {
+        dense(i, i) = i;
+        dense(i+32, 33) = -0.5*i;
+        other(i, 65-i) = 2.0;
+    }
+    other(5, 7) = 1.0;
+    const Matrix<double> sparse = dense.Packed(), sparse_other = other.Packed();
+    BOOST_CHECK(sparse.IsSparse());
+    BOOST_CHECK(sparse_other.IsSparse());
+    BOOST_CHECK_EQUAL(sparse.Nonzeros(), 64u);
+    BOOST_CHECK_EQUAL(sparse(40, 33), -4.0);
+    BOOST_CHECK_EQUAL(sparse(40, 34), 0.0);
+    BOOST_CHECK_EQUAL(toString(sparse), toString(dense));
+
+    // the const accesses read the CSR storage without any dense copy
+    const size_t matrix_bytes = AllocationTracker::Counters().bytes[AllocMatrix];
+    BOOST_CHECK_EQUAL(sparse.get(39*64+32), -4.0);
+    BOOST_CHECK_EQUAL(sparse.get(39*64+33), 0.0);
+    double total = 0.0;
+    sparse.ForEachRow([&](size_t, const double* row) {
+        total = std::accumulate(row, row+64, total);
+    });
+    BOOST_CHECK_EQUAL(total, 528.0 - 264.0);
+    BOOST_CHECK_EQUAL(AllocationTracker::Counters().bytes[AllocMatrix], matrix_bytes);
+
+    Matrix<double> sum = sparse + sparse_other, product = sparse*sparse_other;
+    BOOST_CHECK(sum.IsSparse());
+    BOOST_CHECK(product.IsSparse());
+    BOOST_CHECK_EQUAL(toString(sum), toString(dense + other));
+    BOOST_CHECK_EQUAL(toString(product), toString(dense*other));
+    BOOST_CHECK_EQUAL(toString(sparse*other), toString(dense*other));
+    BOOST_CHECK_EQUAL(toString(dense*sparse_other), toString(dense*other));
+    BOOST_CHECK_EQUAL(toString(sparse - other), toString(dense - other));
+    BOOST_CHECK_EQUAL(toString(sparse.transpose()), toString(dense.transpose()));
+    BOOST_CHECK_EQUAL(toString(2.0*sparse), toString(2.0*dense));
+    BOOST_CHECK((2.0*sparse).IsSparse());
+    BOOST_CHECK_EQUAL((sparse - sparse).Nonzeros(), 0u);
+    BOOST_CHECK(!(sparse - dense).IsSparse());
+
+    // a mutating access converts to a dense buffer, the copies stay sparse
+    Matrix<double> copy = sparse;
+    copy(1, 2) = 3.0;
+    BOOST_CHECK(!copy.IsSparse());
+    BOOST_CHECK(sparse.IsSparse());
+    BOOST_CHECK_EQUAL(copy(1, 2), 3.0);
+    BOOST_CHECK_EQUAL(sparse(1, 2), 0.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
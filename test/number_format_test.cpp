@@ -0,0 +1,98 @@
+#include "number_format.hpp"
+#include "numeric_interface.hpp"
+#include "matrix.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <complex>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+
+// reference : the stream formatting used before format_number
+template <typename T>
+std::string stream_format(T a, int precision)
+{
+    std::ostringstream oss;
+    oss << std::setprecision(precision) << a;
+    return oss.str();
+}
+
+template <typename T>
+std::string fast_format(T a, int precision)
+{
+    char buffer[number_buffer_size];
+    return std::string(buffer, format_number(buffer, buffer+sizeof(buffer), a, precision));
+}
+
+BOOST_AUTO_TEST_SUITE(number_format_tests)
+
+BOOST_AUTO_TEST_CASE( special_values )
+{
+    const double values[] = {0.0, -0.0, 1.0, -1.0, 0.1, 1e-300, 1e300, 123456789.0, 1234567890.0,
+                             5e-324, std::numeric_limits<double>::max(),
+                             std::numeric_limits<double>::infinity(),
+                             -std::numeric_limits<double>::infinity(),
+                             std::numeric_limits<double>::quiet_NaN()};
+    for(double v : values) {
+        for(int precision = 0; precision <= 17; ++precision) {
+            BOOST_CHECK_EQUAL(fast_format(v, precision), stream_format(v, precision));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( random_doubles )
+{
+    std::mt19937_64 gen(7);
+    std::uniform_int_distribution<int> precision(1, 17);
+    for(size_t i = 0; i < 200000; ++i) {
+        // random bit patterns cover every exponent
+        unsigned long long bits = gen();
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        if(v != v) continue; // the sign of a NaN is not portable
+        int p = (i % 2) ? 9 : precision(gen);
+        BOOST_REQUIRE_EQUAL(fast_format(v, p), stream_format(v, p));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( integers )
+{
+    const long values[] = {0, 1, -1, 42, -1234567, std::numeric_limits<long>::max(), std::numeric_limits<long>::min()};
+    for(long v : values) {
+        BOOST_CHECK_EQUAL(fast_format(v, 9), stream_format(v, 9));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( integer_factorial )
+{
+    BOOST_CHECK_EQUAL(numeric_interface<long>::fact(0), 1);
+    BOOST_CHECK_EQUAL(numeric_interface<long>::fact(-3), 1);
+    BOOST_CHECK_EQUAL(numeric_interface<long>::fact(5), 120);
+    BOOST_CHECK_EQUAL(numeric_interface<long long>::fact(20), 2432902008176640000LL);
+    BOOST_CHECK_THROW(numeric_interface<long long>::fact(21), std::overflow_error);
+    BOOST_CHECK_EQUAL(numeric_interface<int>::fact(12), 479001600);
+    BOOST_CHECK_THROW(numeric_interface<int>::fact(13), std::overflow_error);
+}
+
+BOOST_AUTO_TEST_CASE( complex_and_matrix )
+{
+    typedef std::complex<double> C;
+    BOOST_CHECK_EQUAL(numeric_interface<C>::toString(C(0, 0)), "0");
+    BOOST_CHECK_EQUAL(numeric_interface<C>::toString(C(1.5, -1)), "1.5-i");
+    BOOST_CHECK_EQUAL(numeric_interface<C>::toString(C(0, 2)), "i*2");
+    BOOST_CHECK_EQUAL(numeric_interface<C>::toString(C(1.0/3, -2)), "0.333333333-i*2");
+
+    Matrix<C> m(2, 2, C(1, 1));
+    m(2,2) = C(0.25, 0);
+    BOOST_CHECK_EQUAL(Matrix<C>::toString(m), "1+i 1+i\n1+i 0.25\n");
+    BOOST_CHECK_EQUAL(Matrix<C>::toString(m, 1), "1+i 1+i\n1+i 0.2\n");
+    std::ostringstream oss;
+    oss << m;
+    BOOST_CHECK_EQUAL(oss.str(), Matrix<C>::toString(m));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
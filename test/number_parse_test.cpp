@@ -0,0 +1,70 @@
+#include "number_parse.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+// parse_number must agree with strtod on the value bits and the end
+void check_like_strtod(const std::string& s)
+{
+    char* strtod_end;
+    double expected = std::strtod(s.c_str(), &strtod_end);
+    const char* end;
+    double value = 0;
+    bool ok = parse_number(value, s.c_str(), end);
+    BOOST_REQUIRE_MESSAGE(end == strtod_end, "end of " << s);
+    BOOST_REQUIRE_EQUAL(ok, strtod_end != s.c_str());
+    if(ok && expected == expected) {
+        BOOST_REQUIRE_MESSAGE(std::memcmp(&value, &expected, sizeof(double)) == 0,
+                              s << " : " << value << " != " << expected);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(number_parse_tests)
+
+BOOST_AUTO_TEST_CASE( syntax )
+{
+    const char* inputs[] = {"0", "-0", "1", "12", "1.5", ".5", "5.", ".", "1e5", "1e", "1e+", "2E-3i",
+                            "1.5i", "i", "inf", "nan", "0x1p3", "007", "1.25e-308", "4.9e-324",
+                            "1.7976931348623157e308", "1e309", "123456789012345678901234567890",
+                            "0.000000000000000000000000000001", "9007199254740993", "123e30",
+                            "1.5 2.25", "3*4", "1,5", "2^3"};
+    for(const char* s : inputs) {
+        check_like_strtod(s);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( random_round_trip )
+{
+    std::mt19937_64 gen(11);
+    std::uniform_int_distribution<int> precision(1, 17);
+    char buffer[64];
+    for(size_t i = 0; i < 200000; ++i) {
+        unsigned long long bits = gen();
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        if(v != v) continue;
+        std::snprintf(buffer, sizeof(buffer), (i % 3) ? "%.*g" : "%.*e", precision(gen), v);
+        check_like_strtod(buffer);
+    }
+}
+
+BOOST_AUTO_TEST_CASE( random_data_literals )
+{
+    // short decimals as written in data files take the fast path
+    std::mt19937_64 gen(13);
+    std::uniform_int_distribution<long> mantissa(0, 99999999);
+    std::uniform_int_distribution<int> decimals(0, 8);
+    for(size_t i = 0; i < 200000; ++i) {
+        std::string s = std::to_string(mantissa(gen));
+        int d = decimals(gen);
+        if(d < int(s.size())) s.insert(s.size()-d, ".");
+        check_like_strtod(s);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,120 @@
+#include "interpreter.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <complex>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+typedef std::complex<double> complex;
+
+static const char* definitions[] = {
+    "exp(x)_n=exp(x)_(n-1)+x^n/!n",
+    "fib_0=0",
+    "fib_1=1",
+    "fib_n=fib_(n-1)+fib_(n-2)",
+    "f(x,y=2)=x*y+1",
+    "g(x)=x*[1 2;3 4]",
+    "a=[1 2;3 4]",
+    "b=[a a;a -a]",
+    "s_0=0",
+    "s_n=s_(n-1)+1/2^n",
+    "am(x,y)_0=(x+y)/2",
+    "gm(x,y)_0=(x*y)^0.5",
+    "am(x,y)_n=(am(x,y)_(n-1)+gm(x,y)_(n-1))/2",
+    "gm(x,y)_n=(am(x,y)_(n-1)*gm(x,y)_(n-1))^0.5"
+};
+
+static const char* queries[] = {
+    "exp(1)", "exp(i*pi)", "fib_30", "f(3)", "f(3,y=5)", "g(2)", "b*b", "s_50", "s", "gm(1,2)_10", "pi*e"
+};
+
+BOOST_AUTO_TEST_SUITE(session_tests)
+
+BOOST_AUTO_TEST_CASE( save_restore )
+{
+    const char* path = "session_test.bin";
+    Interpreter<complex> p;
+    for(const char* definition : definitions) {
+        p.Eval(definition);
+    }
+    BOOST_REQUIRE(p.SaveSession(path));
+
+    Interpreter<complex> q;
+    BOOST_REQUIRE(q.RestoreSession(path));
+    for(const char* query : queries) {
+        BOOST_CHECK_EQUAL(Matrix<complex>::toString(q.Eval(query)), Matrix<complex>::toString(p.Eval(query)));
+    }
+
+    // the restored definitions can be saved again, to the same bytes
+    const char* copy = "session_test_copy.bin";
+    BOOST_REQUIRE(q.SaveSession(copy));
+    std::ifstream a(path, std::ios::binary), b(copy, std::ios::binary);
+    std::stringstream sa, sb;
+    sa << a.rdbuf();
+    sb << b.rdbuf();
+    BOOST_CHECK(sa.str() == sb.str());
+
+    std::remove(path);
+    std::remove(copy);
+}
+
+BOOST_AUTO_TEST_CASE( restore_keeps_other_definitions )
+{
+    const char* path = "session_test.bin";
+    Interpreter<complex> p;
+    p.Eval("x=1");
+    p.Eval("y=2");
+    BOOST_REQUIRE(p.SaveSession(path));
+
+    Interpreter<complex> q;
+    q.Eval("y=20");
+    q.Eval("z=30");
+    BOOST_REQUIRE(q.RestoreSession(path));
+    BOOST_CHECK_EQUAL(Matrix<complex>::toString(q.Eval("x+y+z")), Matrix<complex>::toString(Matrix<complex>(33.0)));
+
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE( invalid_files )
+{
+    const char* path = "session_test.bin";
+    Interpreter<complex> p;
+    std::ostringstream errors;
+    p.SetErrorStream(errors);
+    p.Eval("x=1");
+
+    BOOST_CHECK(!p.RestoreSession("missing_session.bin"));
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "definitely not a session";
+    }
+    BOOST_CHECK(!p.RestoreSession(path));
+
+    // every truncation is detected and leaves the definitions unchanged
+    Interpreter<complex> q;
+    q.Eval("x=2");
+    q.Eval("u_n=u_(n-1)+[1 2]");
+    BOOST_REQUIRE(q.SaveSession(path));
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream ss;
+        ss << in.rdbuf();
+        bytes = ss.str();
+    }
+    for(size_t size = 0; size < bytes.size(); size += 7) {
+        {
+            std::ofstream out(path, std::ios::binary);
+            out.write(bytes.data(), size);
+        }
+        BOOST_CHECK(!p.RestoreSession(path));
+    }
+    BOOST_CHECK_EQUAL(Matrix<complex>::toString(p.Eval("x")), Matrix<complex>::toString(Matrix<complex>(1.0)));
+
+    std::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
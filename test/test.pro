@@ -2,6 +2,7 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
+CONFIG += thread
 
 QMAKE_CXXFLAGS += -std=c++11
 LIBS += -L"D:\boost\boost_1_55_0\stage\lib"
@@ -9,17 +10,38 @@ LIBS += -lboost_unit_test_framework-mgw48-mt-d-1_55
 INCLUDEPATH += D:\boost\boost_1_55_0
 INCLUDEPATH += ..\
 
+# jit_test.cpp and the compilation of the exported header in
+# cpp_export_test.cpp run with the native compilation only
+#DEFINES += INKAMATH_JIT INKAMATH_JIT_INCLUDE_DIR=\\\"$$PWD/..\\\"
+#LIBS += -ldl
+
 
 SOURCES += \
     mapstack_test.cpp \
     dynarray_test.cpp \
+    matrix_test.cpp \
+    alloc_tracker_test.cpp \
+    number_format_test.cpp \
+    number_parse_test.cpp \
+    matrix_io_test.cpp \
+    session_test.cpp \
+    jit_test.cpp \
+    cpp_export_test.cpp \
+    bigfloat_test.cpp \
+    interval_test.cpp \
     inkamath_test.cpp
 
 OTHER_FILES += \
     data/input1.txt \
     data/output1.txt \
     data/input2.txt \
-    data/output2.txt
+    data/output2.txt \
+    data/input3.txt \
+    data/output3.txt \
+    data/input4.txt \
+    data/output4.txt \
+    data/input5.txt \
+    data/output5.txt
 
 HEADERS += \
     inkamath_test.hpp
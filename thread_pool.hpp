@@ -0,0 +1,237 @@
+#ifndef H_THREAD_POOL
+#define H_THREAD_POOL
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ ***************************************
+ * Work-stealing thread pool.
+ *
+ * Each worker owns a queue : it takes its own tasks from the back and,
+ * once its queue is empty, steals the tasks of the other workers from the
+ * front. ParallelFor spreads its indices over the queues and the calling
+ * thread steals tasks too until they are all done, so a pool without
+ * worker (one core) runs everything on the caller.
+ * The first exception thrown by a task is rethrown by ParallelFor, the
+ * tasks of the same call not started yet are skipped.
+ * InTask() is true on a thread running a task : the callers use it to
+ * avoid nested parallel loops.
+ ***************************************
+ */
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t workers) : queues_(workers), pending_(0), stop_(false), next_(0)
+    {
+        for(size_t i = 0; i < workers; ++i) {
+            queues_[i].reset(new Queue());
+        }
+        for(size_t i = 0; i < workers; ++i) {
+            threads_.emplace_back([this, i]() { Work(i); });
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for(std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool shared by the evaluations, one worker less than the cores or
+    // than the INKAMATH_THREADS environment variable
+    static ThreadPool& Shared()
+    {
+        static ThreadPool pool(SharedWorkers());
+        return pool;
+    }
+
+    // Number of threads running the tasks of a ParallelFor, caller included
+    size_t Concurrency() const
+    {
+        return threads_.size()+1;
+    }
+
+    static bool InTask()
+    {
+        return in_task();
+    }
+
+    // Calls f(i) for each i in [0, n) and returns once they are all done
+    template <typename F>
+    void ParallelFor(size_t n, F f)
+    {
+        if(n == 0) {
+            return;
+        }
+        Batch batch(n);
+        for(size_t i = 0; i < n; ++i) {
+            Push(Task{&batch, [&f, i]() { f(i); }});
+        }
+        Task task;
+        while(batch.remaining.load() != 0 && Steal(next_.fetch_add(1), task)) {
+            Run(task);
+        }
+        // the tasks left are running on the workers
+        std::unique_lock<std::mutex> lock(batch.mutex);
+        batch.done.wait(lock, [&batch]() { return batch.remaining.load() == 0; });
+        if(batch.error) {
+            std::rethrow_exception(batch.error);
+        }
+    }
+
+private:
+    struct Batch {
+        explicit Batch(size_t n) : remaining(n), failed(false) {}
+
+        std::atomic<size_t> remaining;
+        std::atomic<bool> failed;
+        std::mutex mutex;
+        std::condition_variable done;
+        std::exception_ptr error;
+    };
+
+    struct Task {
+        Batch* batch;
+        std::function<void()> function;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    static size_t SharedWorkers()
+    {
+        size_t threads = std::thread::hardware_concurrency();
+        if(const char* variable = std::getenv("INKAMATH_THREADS")) {
+            threads = std::strtoul(variable, nullptr, 10);
+        }
+        return threads > 1 ? threads-1 : 0;
+    }
+
+    static bool& in_task()
+    {
+        static thread_local bool flag = false;
+        return flag;
+    }
+
+    void Push(Task task)
+    {
+        if(queues_.empty()) {
+            Run(task);
+            return;
+        }
+        Queue& queue = *queues_[next_.fetch_add(1) % queues_.size()];
+        {
+            // counted first : pending_ never goes below the queued tasks
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++pending_;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        wake_.notify_one();
+    }
+
+    // Own tasks from the back
+    bool Pop(size_t i, Task& task)
+    {
+        Queue& queue = *queues_[i];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()) {
+            return false;
+        }
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        --pending_;
+        return true;
+    }
+
+    // Tasks of the other queues from the front, starting after queue i
+    bool Steal(size_t i, Task& task)
+    {
+        for(size_t k = 1; k <= queues_.size(); ++k) {
+            Queue& queue = *queues_[(i+k) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                --pending_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Run(Task& task)
+    {
+        Batch& batch = *task.batch;
+        if(!batch.failed.load()) {
+            bool nested = in_task();
+            in_task() = true;
+            try {
+                task.function();
+            }
+            catch(...) {
+                std::lock_guard<std::mutex> lock(batch.mutex);
+                if(!batch.error) {
+                    batch.error = std::current_exception();
+                }
+                batch.failed.store(true);
+            }
+            in_task() = nested;
+        }
+        task.function = nullptr;
+        // notified under the lock : the batch lives until its caller wakes up
+        std::lock_guard<std::mutex> lock(batch.mutex);
+        if(--batch.remaining == 0) {
+            batch.done.notify_all();
+        }
+    }
+
+    void Work(size_t i)
+    {
+        Task task;
+        for(;;) {
+            if(Pop(i, task) || Steal(i, task)) {
+                Run(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this]() { return stop_ || pending_.load() != 0; });
+            if(stop_ && pending_.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> pending_;
+    bool stop_;
+    std::atomic<size_t> next_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+};
+
+#endif // H_THREAD_POOL
@@ -7,7 +7,7 @@
 
 enum Type
 {
-    Add,Mult,Min,Div,Pow,Fact,Equal, Sub,
+    Add,Mult,Min,Div,LDiv,Pow,Fact,Equal, Sub,
     Val,Func, Ref,
     LPar,RPar,LBra,RBra,
     Space, Comma, Semico
@@ -16,7 +16,7 @@ enum Type
 template <typename T>
 struct Token
 {
-    Token(Type t, T val = 0, std::string n = ""): type(t), value(val), name(n) {}
+    Token(Type t, T val = T(), std::string n = ""): type(t), value(val), name(n) {}
     Type type;
     T value;
     std::string name;
@@ -60,6 +60,9 @@ struct Token
         case Div  :
             s = "/";
             break;
+        case LDiv :
+            s = "\\";
+            break;
         case Pow  :
             s = "^";
             break;